@@ -23,6 +23,77 @@
 #include <time.h>
 #include "diff_match_patch.h"
 
+// Typical cost model coefficients, used in estimates until diff_calibrate
+// has measured this machine.
+static const double DEFAULT_TOKEN_COST = 2e-8;
+static const double DEFAULT_BISECT_COST = 2e-9;
+static const double DEFAULT_SCAN_COST = 1e-9;
+
+// Content-defined chunking: characters in the rolling hash window, and the
+// typical number of children of a chunk tree node.
+static const int CHUNK_WINDOW = 16;
+static const int CHUNK_FANOUT = 16;
+
+// Smallest window segment worth handing to another thread in match_bitap.
+static const int MATCH_SEGMENT_MIN = 8192;
+
+// Smallest chunk of text worth tokenizing on another thread in
+// diff_linesToChars.
+static const int TOKENIZE_CHUNK_MIN = 65536;
+
+// Lines that have to match in a row, the first unique in text1, before a
+// StreamingDiff commits the region in front of them.
+static const int STREAM_ANCHOR_LINES = 2;
+
+// Bytes read at a time, and batches of lines held between the reader and
+// the tokenizer, in diff_pipeline.
+static const int PIPELINE_READ_SIZE = 65536;
+static const int PIPELINE_QUEUE_SIZE = 16;
+
+// Compressed deltas: header, probabilities of 12 bits which move 1/16 of
+// the way on each bit, range renormalized below 2^24, modelled bits of a
+// length below its leading one, size of the order-2 character table,
+// characters a match is found on and size of its table, and bytes buffered
+// before each write.
+static const char DELTA_MAGIC[] = "DMPZ";
+static const int DELTA_VERSION = 1;
+static const int DELTA_PROB_BITS = 12;
+static const quint16 DELTA_PROB_HALF = 1 << (DELTA_PROB_BITS - 1);
+static const int DELTA_MOVE_BITS = 4;
+static const quint32 DELTA_TOP = 1 << 24;
+static const int DELTA_MANTISSA_BITS = 4;
+static const int DELTA_ORDER2_BITS = 18;
+static const int DELTA_MATCH_MIN = 5;
+static const int DELTA_MATCH_BITS = 14;
+static const int DELTA_FLUSH_SIZE = 4096;
+
+// Count work on a hot path, in builds for the performance fuzzer.
+#ifdef DMP_WORK_COUNTERS
+#define DMP_WORK(counter, amount) \
+    (diff_match_patch::workCounters[counter] += (amount))
+#else
+#define DMP_WORK(counter, amount)
+#endif
+
+
+// The characters of a text, as DiffCore takes them.  Unlike utf16(),
+// constData() never touches the string.
+static inline const CoreChar *coreChars(const QString &text) {
+  return reinterpret_cast<const CoreChar *>(text.constData());
+}
+
+
+// View diffs as DiffCore takes them, over the texts of the diffs.
+static void coreDiffs(const QList<Diff> &diffs, CoreArray<CoreDiff> &view) {
+  view.reserve(diffs.size());
+  for (QList<Diff>::const_iterator aDiff = diffs.constBegin();
+       aDiff != diffs.constEnd(); ++aDiff) {
+    const CoreDiff coreDiff = {aDiff->operation, coreChars(aDiff->text),
+                               aDiff->text.length()};
+    view.append(coreDiff);
+  }
+}
+
 
 //////////////////////////
 //
@@ -113,7 +184,7 @@ bool Patch::isNull() const {
  * Indices are printed as 1-based, not 0-based.
  * @return The GNU diff string
  */
-QString Patch::toString() {
+QString Patch::toString() const {
   QString coords1, coords2;
   if (length1 == 0) {
     coords1 = QString::number(start1) + QString(",0");
@@ -135,7 +206,7 @@ QString Patch::toString() {
   text = QString("@@ -") + coords1 + QString(" +") + coords2
       + QString(" @@\n");
   // Escape the body of the patch with %xx notation.
-  foreach (Diff aDiff, diffs) {
+  foreach (const Diff &aDiff, diffs) {
     switch (aDiff.operation) {
       case INSERT:
         text += QString('+');
@@ -157,362 +228,3082 @@ QString Patch::toString() {
 
 /////////////////////////////////////////////
 //
-// diff_match_patch Class
+// DiffFeatures Class
 //
 /////////////////////////////////////////////
 
-diff_match_patch::diff_match_patch() :
-  Diff_Timeout(1.0f),
-  Diff_EditCost(4),
-  Match_Threshold(0.5f),
-  Match_Distance(1000),
-  Patch_DeleteThreshold(0.5f),
-  Patch_Margin(4),
-  Match_MaxBits(32) {
+
+/**
+ * Constructor.  Initializes all features to zero.
+ */
+DiffFeatures::DiffFeatures() :
+  length1(0), length2(0),
+  lines1(0), lines2(0),
+  avgLineLength(0.0), uniqueLineRatio(0.0) {
 }
 
 
-QList<Diff> diff_match_patch::diff_main(const QString &text1,
-                                        const QString &text2) {
-  return diff_main(text1, text2, true);
+/**
+ * Display a human-readable version of these features.
+ * @return text version
+ */
+QString DiffFeatures::toString() const {
+  return QString("DiffFeatures(length=%1/%2,lines=%3/%4,avgLine=%5,unique=%6)")
+      .arg(length1).arg(length2).arg(lines1).arg(lines2)
+      .arg(avgLineLength).arg(uniqueLineRatio);
 }
 
-QList<Diff> diff_match_patch::diff_main(const QString &text1,
-    const QString &text2, bool checklines) {
-  // Set a deadline by which time the diff must be complete.
-  clock_t deadline;
-  if (Diff_Timeout <= 0) {
-    deadline = std::numeric_limits<clock_t>::max();
-  } else {
-    deadline = clock() + (clock_t)(Diff_Timeout * CLOCKS_PER_SEC);
-  }
-  return diff_main(text1, text2, checklines, deadline);
-}
 
-QList<Diff> diff_match_patch::diff_main(const QString &text1,
-    const QString &text2, bool checklines, clock_t deadline) {
-  // Check for null inputs.
-  if (text1.isNull() || text2.isNull()) {
-    throw "Null inputs. (diff_main)";
-  }
+/////////////////////////////////////////////
+//
+// CostEstimate Class
+//
+/////////////////////////////////////////////
 
-  // Check for equality (speedup).
-  QList<Diff> diffs;
-  if (text1 == text2) {
-    if (!text1.isEmpty()) {
-      diffs.append(Diff(EQUAL, text1));
-    }
-    return diffs;
-  }
 
-  // Trim off common prefix (speedup).
-  int commonlength = diff_commonPrefix(text1, text2);
-  const QString &commonprefix = text1.left(commonlength);
-  QString textChopped1 = text1.mid(commonlength);
-  QString textChopped2 = text2.mid(commonlength);
+/**
+ * Constructor.  Initializes an estimate for a no-op job.
+ */
+CostEstimate::CostEstimate() :
+  strategy(STRATEGY_NONE),
+  commonPrefix(0), commonSuffix(0),
+  similarity(1.0), edits(0),
+  seconds(0.0), bytes(0) {
+}
 
-  // Trim off common suffix (speedup).
-  commonlength = diff_commonSuffix(textChopped1, textChopped2);
-  const QString &commonsuffix = textChopped1.right(commonlength);
-  textChopped1 = textChopped1.left(textChopped1.length() - commonlength);
-  textChopped2 = textChopped2.left(textChopped2.length() - commonlength);
 
-  // Compute the diff on the middle block.
-  diffs = diff_compute(textChopped1, textChopped2, checklines, deadline);
+/**
+ * Display a human-readable version of this estimate.
+ * @return text version
+ */
+QString CostEstimate::toString() const {
+  return QString("CostEstimate(%1,prefix=%2,suffix=%3,similarity=%4,"
+      "edits=%5,seconds=%6,bytes=%7)")
+      .arg(strStrategy(strategy)).arg(commonPrefix).arg(commonSuffix)
+      .arg(similarity).arg(edits).arg(seconds).arg(bytes);
+}
 
-  // Restore the prefix and suffix.
-  if (!commonprefix.isEmpty()) {
-    diffs.prepend(Diff(EQUAL, commonprefix));
-  }
-  if (!commonsuffix.isEmpty()) {
-    diffs.append(Diff(EQUAL, commonsuffix));
+
+/**
+ * Get a string representation of a Strategy.
+ * @param strategy Strategy to convert.
+ * @return e.g. "BISECT"
+ */
+QString CostEstimate::strStrategy(Strategy strategy) {
+  switch (strategy) {
+    case STRATEGY_NONE:
+      return "NONE";
+    case STRATEGY_TRIVIAL:
+      return "TRIVIAL";
+    case STRATEGY_LINEMODE:
+      return "LINEMODE";
+    case STRATEGY_BISECT:
+      return "BISECT";
+    case STRATEGY_EXACT:
+      return "EXACT";
+    case STRATEGY_FUZZY:
+      return "FUZZY";
   }
+  throw "Invalid strategy.";
+}
 
-  diff_cleanupMerge(diffs);
 
-  return diffs;
-}
+/////////////////////////////////////////////
+//
+// SketchIndex Class
+//
+/////////////////////////////////////////////
 
 
-QList<Diff> diff_match_patch::diff_compute(QString text1, QString text2,
-    bool checklines, clock_t deadline) {
-  QList<Diff> diffs;
+SketchIndex::SketchIndex() : bandSize(4) {
+}
 
-  if (text1.isEmpty()) {
-    // Just add some text (speedup).
-    diffs.append(Diff(INSERT, text2));
-    return diffs;
-  }
 
-  if (text2.isEmpty()) {
-    // Just delete some text (speedup).
-    diffs.append(Diff(DELETE, text1));
-    return diffs;
+SketchIndex::SketchIndex(int bandSize) : bandSize(bandSize) {
+  if (bandSize <= 0) {
+    throw "Invalid band size.";
   }
+}
 
-  {
-    const QString longtext = text1.length() > text2.length() ? text1 : text2;
-    const QString shorttext = text1.length() > text2.length() ? text2 : text1;
-    const int i = longtext.indexOf(shorttext);
-    if (i != -1) {
-      // Shorter text is inside the longer text (speedup).
-      const Operation op = (text1.length() > text2.length()) ? DELETE : INSERT;
-      diffs.append(Diff(op, longtext.left(i)));
-      diffs.append(Diff(EQUAL, shorttext));
-      diffs.append(Diff(op, safeMid(longtext, i + shorttext.length())));
-      return diffs;
-    }
 
-    if (shorttext.length() == 1) {
-      // Single character string.
-      // After the previous speedup, the character can't be an equality.
-      diffs.append(Diff(DELETE, text1));
-      diffs.append(Diff(INSERT, text2));
-      return diffs;
-    }
-    // Garbage collect longtext and shorttext by scoping out.
+void SketchIndex::insert(const QString &key, const QVector<uint> &sketch) {
+  if (!sketches.isEmpty()
+      && sketches.begin().value().size() != sketch.size()) {
+    throw "Sketch size mismatch.";
   }
-
-  // Check to see if the problem can be split in two.
-  const QStringList hm = diff_halfMatch(text1, text2);
-  if (hm.count() > 0) {
-    // A half-match was found, sort out the return data.
-    const QString text1_a = hm[0];
-    const QString text1_b = hm[1];
-    const QString text2_a = hm[2];
-    const QString text2_b = hm[3];
-    const QString mid_common = hm[4];
-    // Send both pairs off for separate processing.
-    const QList<Diff> diffs_a = diff_main(text1_a, text2_a,
-                                          checklines, deadline);
-    const QList<Diff> diffs_b = diff_main(text1_b, text2_b,
-                                          checklines, deadline);
-    // Merge the results.
-    diffs = diffs_a;
-    diffs.append(Diff(EQUAL, mid_common));
-    diffs += diffs_b;
-    return diffs;
+  if (sketch.size() < bandSize) {
+    throw "Sketch smaller than a band.";
   }
-
-  // Perform a real diff.
-  if (checklines && text1.length() > 100 && text2.length() > 100) {
-    return diff_lineMode(text1, text2, deadline);
+  remove(key);
+  sketches.insert(key, sketch);
+  if (isBlank(sketch)) {
+    // Similar to nothing, so in no bucket.
+    return;
   }
+  for (int band = 0; band < sketch.size() / bandSize; band++) {
+    buckets[qMakePair(band, bandHash(sketch, band))].append(key);
+  }
+}
 
-  return diff_bisect(text1, text2, deadline);
+
+bool SketchIndex::remove(const QString &key) {
+  if (!sketches.contains(key)) {
+    return false;
+  }
+  const QVector<uint> sketch = sketches.take(key);
+  for (int band = 0; band < sketch.size() / bandSize; band++) {
+    const QPair<int, uint> bucket = qMakePair(band, bandHash(sketch, band));
+    buckets[bucket].removeAll(key);
+    if (buckets[bucket].isEmpty()) {
+      buckets.remove(bucket);
+    }
+  }
+  return true;
 }
 
 
-QList<Diff> diff_match_patch::diff_lineMode(QString text1, QString text2,
-    clock_t deadline) {
-  // Scan the text on a line-by-line basis first.
-  const QList<QVariant> b = diff_linesToChars(text1, text2);
-  text1 = b[0].toString();
-  text2 = b[1].toString();
-  QStringList linearray = b[2].toStringList();
+bool SketchIndex::contains(const QString &key) const {
+  return sketches.contains(key);
+}
 
-  QList<Diff> diffs = diff_main(text1, text2, false, deadline);
 
-  // Convert the diff back to original text.
-  diff_charsToLines(diffs, linearray);
-  // Eliminate freak matches (e.g. blank lines)
-  diff_cleanupSemantic(diffs);
+int SketchIndex::size() const {
+  return sketches.size();
+}
 
-  // Rediff any replacement blocks, this time character-by-character.
-  // Add a dummy entry at the end.
-  diffs.append(Diff(EQUAL, ""));
-  int count_delete = 0;
-  int count_insert = 0;
-  QString text_delete = "";
-  QString text_insert = "";
 
-  QMutableListIterator<Diff> pointer(diffs);
-  Diff *thisDiff = pointer.hasNext() ? &pointer.next() : NULL;
-  while (thisDiff != NULL) {
-    switch (thisDiff->operation) {
-      case INSERT:
-        count_insert++;
-        text_insert += thisDiff->text;
-        break;
-      case DELETE:
-        count_delete++;
-        text_delete += thisDiff->text;
-        break;
-      case EQUAL:
-        // Upon reaching an equality, check for prior redundancies.
-        if (count_delete >= 1 && count_insert >= 1) {
-          // Delete the offending records and add the merged ones.
-          pointer.previous();
-          for (int j = 0; j < count_delete + count_insert; j++) {
-            pointer.previous();
-            pointer.remove();
-          }
-          foreach(Diff newDiff,
-              diff_main(text_delete, text_insert, false, deadline)) {
-            pointer.insert(newDiff);
-          }
-        }
-        count_insert = 0;
-        count_delete = 0;
-        text_delete = "";
-        text_insert = "";
-        break;
+QList<QPair<QString, double> > SketchIndex::nearest(
+    const QVector<uint> &sketch, int count) const {
+  if (sketch.size() < bandSize) {
+    throw "Sketch smaller than a band.";
+  }
+  QSet<QString> candidates;
+  for (int band = 0; band < sketch.size() / bandSize; band++) {
+    foreach(const QString &key, buckets.value(qMakePair(band,
+                                                 bandHash(sketch, band)))) {
+      candidates.insert(key);
     }
-    thisDiff = pointer.hasNext() ? &pointer.next() : NULL;
   }
-  diffs.removeLast();  // Remove the dummy entry at the end.
-
-  return diffs;
+  // Sort on (-similarity, key) so that ties come out in a stable order.
+  QList<QPair<double, QString> > scored;
+  foreach(const QString &key, candidates) {
+    scored.append(qMakePair(-similarity(sketch, sketches.value(key)), key));
+  }
+  qSort(scored);
+  QList<QPair<QString, double> > result;
+  for (int x = 0; x < scored.size() && x < count; x++) {
+    result.append(qMakePair(scored[x].second, -scored[x].first));
+  }
+  return result;
 }
 
 
-QList<Diff> diff_match_patch::diff_bisect(const QString &text1,
-    const QString &text2, clock_t deadline) {
-  // Cache the text lengths to prevent multiple calls.
-  const int text1_length = text1.length();
-  const int text2_length = text2.length();
-  const int max_d = (text1_length + text2_length + 1) / 2;
-  const int v_offset = max_d;
-  const int v_length = 2 * max_d;
-  int *v1 = new int[v_length];
-  int *v2 = new int[v_length];
-  for (int x = 0; x < v_length; x++) {
-    v1[x] = -1;
-    v2[x] = -1;
-  }
-  v1[v_offset + 1] = 0;
-  v2[v_offset + 1] = 0;
-  const int delta = text1_length - text2_length;
-  // If the total number of characters is odd, then the front path will
-  // collide with the reverse path.
-  const bool front = (delta % 2 != 0);
-  // Offsets for start and end of k loop.
-  // Prevents mapping of space beyond the grid.
-  int k1start = 0;
-  int k1end = 0;
-  int k2start = 0;
-  int k2end = 0;
-  for (int d = 0; d < max_d; d++) {
-    // Bail out if deadline is reached.
-    if (clock() > deadline) {
-      break;
+double SketchIndex::similarity(const QVector<uint> &sketch1,
+                               const QVector<uint> &sketch2) {
+  if (sketch1.size() != sketch2.size()) {
+    throw "Sketch size mismatch.";
+  }
+  if (sketch1.isEmpty() || isBlank(sketch1) || isBlank(sketch2)) {
+    return 0.0;
+  }
+  int same = 0;
+  for (int x = 0; x < sketch1.size(); x++) {
+    if (sketch1[x] == sketch2[x]) {
+      same++;
     }
+  }
+  return same / static_cast<double>(sketch1.size());
+}
 
-    // Walk the front path one step.
-    for (int k1 = -d + k1start; k1 <= d - k1end; k1 += 2) {
-      const int k1_offset = v_offset + k1;
-      int x1;
-      if (k1 == -d || (k1 != d && v1[k1_offset - 1] < v1[k1_offset + 1])) {
-        x1 = v1[k1_offset + 1];
-      } else {
-        x1 = v1[k1_offset - 1] + 1;
-      }
-      int y1 = x1 - k1;
-      while (x1 < text1_length && y1 < text2_length
-          && text1[x1] == text2[y1]) {
-        x1++;
-        y1++;
-      }
-      v1[k1_offset] = x1;
-      if (x1 > text1_length) {
-        // Ran off the right of the graph.
-        k1end += 2;
-      } else if (y1 > text2_length) {
-        // Ran off the bottom of the graph.
-        k1start += 2;
-      } else if (front) {
-        int k2_offset = v_offset + delta - k1;
-        if (k2_offset >= 0 && k2_offset < v_length && v2[k2_offset] != -1) {
-          // Mirror x2 onto top-left coordinate system.
-          int x2 = text1_length - v2[k2_offset];
-          if (x1 >= x2) {
-            // Overlap detected.
-            delete [] v1;
-            delete [] v2;
-            return diff_bisectSplit(text1, text2, x1, y1, deadline);
-          }
-        }
-      }
-    }
 
-    // Walk the reverse path one step.
-    for (int k2 = -d + k2start; k2 <= d - k2end; k2 += 2) {
-      const int k2_offset = v_offset + k2;
-      int x2;
-      if (k2 == -d || (k2 != d && v2[k2_offset - 1] < v2[k2_offset + 1])) {
-        x2 = v2[k2_offset + 1];
-      } else {
-        x2 = v2[k2_offset - 1] + 1;
-      }
-      int y2 = x2 - k2;
-      while (x2 < text1_length && y2 < text2_length
-          && text1[text1_length - x2 - 1] == text2[text2_length - y2 - 1]) {
-        x2++;
-        y2++;
-      }
-      v2[k2_offset] = x2;
-      if (x2 > text1_length) {
-        // Ran off the left of the graph.
-        k2end += 2;
-      } else if (y2 > text2_length) {
-        // Ran off the top of the graph.
-        k2start += 2;
-      } else if (!front) {
-        int k1_offset = v_offset + delta - k2;
-        if (k1_offset >= 0 && k1_offset < v_length && v1[k1_offset] != -1) {
-          int x1 = v1[k1_offset];
-          int y1 = v_offset + x1 - k1_offset;
-          // Mirror x2 onto top-left coordinate system.
-          x2 = text1_length - x2;
-          if (x1 >= x2) {
-            // Overlap detected.
-            delete [] v1;
-            delete [] v2;
-            return diff_bisectSplit(text1, text2, x1, y1, deadline);
-          }
-        }
-      }
+bool SketchIndex::isBlank(const QVector<uint> &sketch) {
+  foreach(uint slot, sketch) {
+    if (slot != std::numeric_limits<uint>::max()) {
+      return false;
     }
   }
-  delete [] v1;
-  delete [] v2;
-  // Diff took too long and hit the deadline or
-  // number of diffs equals number of characters, no commonality at all.
-  QList<Diff> diffs;
-  diffs.append(Diff(DELETE, text1));
-  diffs.append(Diff(INSERT, text2));
-  return diffs;
+  return true;
 }
 
-QList<Diff> diff_match_patch::diff_bisectSplit(const QString &text1,
-    const QString &text2, int x, int y, clock_t deadline) {
-  QString text1a = text1.left(x);
-  QString text2a = text2.left(y);
-  QString text1b = safeMid(text1, x);
-  QString text2b = safeMid(text2, y);
-
-  // Compute both diffs serially.
-  QList<Diff> diffs = diff_main(text1a, text2a, false, deadline);
-  QList<Diff> diffsb = diff_main(text1b, text2b, false, deadline);
 
-  return diffs + diffsb;
+uint SketchIndex::bandHash(const QVector<uint> &sketch, int band) const {
+  uint hash = 0;
+  for (int x = band * bandSize; x < (band + 1) * bandSize; x++) {
+    hash = hash * 31 + sketch[x];
+  }
+  return hash;
 }
 
-QList<QVariant> diff_match_patch::diff_linesToChars(const QString &text1,
-                                                    const QString &text2) {
-  QStringList lineArray;
-  QMap<QString, int> lineHash;
-  // e.g. linearray[4] == "Hello\n"
-  // e.g. linehash.get("Hello\n") == 4
 
-  // "\x00" is a valid character, but various debuggers don't like it.
-  // So we'll insert a junk entry to avoid generating a null character.
-  lineArray.append("");
+/////////////////////////////////////////////
+//
+// CorpusMatch Class
+//
+/////////////////////////////////////////////
 
-  const QString chars1 = diff_linesToCharsMunge(text1, lineArray, lineHash);
-  const QString chars2 = diff_linesToCharsMunge(text2, lineArray, lineHash);
 
-  QList<QVariant> listRet;
+CorpusMatch::CorpusMatch(const QString &document, int location,
+                         double score) :
+  document(document), location(location), score(score) {
+}
+
+
+CorpusMatch::CorpusMatch() : location(-1), score(1.0) {
+}
+
+
+/**
+ * Display a human-readable version of this hit.
+ * @return text version
+ */
+QString CorpusMatch::toString() const {
+  return QString("CorpusMatch(%1,%2,%3)").arg(document).arg(location)
+      .arg(score);
+}
+
+
+/////////////////////////////////////////////
+//
+// CorpusIndex Class
+//
+/////////////////////////////////////////////
+
+
+CorpusIndex::CorpusIndex() : q(3), nextId(0) {
+}
+
+
+CorpusIndex::CorpusIndex(int q) : q(q), nextId(0) {
+  if (q <= 0) {
+    throw "Invalid q-gram length.";
+  }
+}
+
+
+void CorpusIndex::insert(const QString &key, const QString &text) {
+  remove(key);
+  const int id = nextId++;
+  ids.insert(key, id);
+  keys.insert(id, key);
+  texts.insert(id, text);
+  for (int pos = 0; pos + q <= text.length(); pos++) {
+    postings[qgramHash(text, pos)][id].append(pos);
+  }
+}
+
+
+bool CorpusIndex::remove(const QString &key) {
+  if (!ids.contains(key)) {
+    return false;
+  }
+  const int id = ids.take(key);
+  keys.remove(id);
+  const QString text = texts.take(id);
+  for (int pos = 0; pos + q <= text.length(); pos++) {
+    const uint hash = qgramHash(text, pos);
+    QHash<uint, QHash<int, QVector<int> > >::iterator posting =
+        postings.find(hash);
+    if (posting != postings.end()) {
+      posting.value().remove(id);
+      if (posting.value().isEmpty()) {
+        postings.erase(posting);
+      }
+    }
+  }
+  return true;
+}
+
+
+bool CorpusIndex::contains(const QString &key) const {
+  return ids.contains(key);
+}
+
+
+int CorpusIndex::size() const {
+  return ids.size();
+}
+
+
+QString CorpusIndex::text(const QString &key) const {
+  return texts.value(ids.value(key, -1));
+}
+
+
+QList<QPair<QString, int> > CorpusIndex::candidates(const QString &pattern,
+                                                    int errors) const {
+  QSet<QPair<int, int> > found;
+  const int length = pattern.length();
+  if (length / q < errors + 1) {
+    // Too short, or too many errors for k + 1 segments of a q-gram each;
+    // the index cannot rule out any location.  Every location is proposed; those
+    // within errors of each other fall in one run below anyway.
+    QHashIterator<int, QString> i(texts);
+    while (i.hasNext()) {
+      i.next();
+      const int last = std::max(0, i.value().length() - length);
+      for (int pos = 0; pos <= last; pos += errors + 1) {
+        found.insert(qMakePair(i.key(), pos));
+      }
+    }
+  } else {
+    // As many segments as there are errors, plus one.
+    const int pieces = errors + 1;
+    for (int piece = 0; piece < pieces; piece++) {
+      const int segmentStart = piece * length / pieces;
+      const int segmentLength = (piece + 1) * length / pieces
+          - segmentStart;
+      const QString segment = pattern.mid(segmentStart, segmentLength);
+      // Read the q-gram of the segment found in the fewest documents.
+      int bestOffset = 0;
+      int bestCount = std::numeric_limits<int>::max();
+      for (int offset = 0; offset + q <= segmentLength; offset++) {
+        const int count = postings.value(qgramHash(segment, offset)).size();
+        if (count < bestCount) {
+          bestCount = count;
+          bestOffset = offset;
+        }
+      }
+      QHashIterator<int, QVector<int> > i(
+          postings.value(qgramHash(segment, bestOffset)));
+      while (i.hasNext()) {
+        i.next();
+        const QString &text = texts[i.key()];
+        foreach(int pos, i.value()) {
+          const int start = pos - bestOffset;
+          if (start >= 0 && text.mid(start, segmentLength) == segment) {
+            found.insert(qMakePair(i.key(), start - segmentStart));
+          }
+        }
+      }
+    }
+  }
+
+  // One location for each run of locations no more than errors apart; a
+  // window around it covers them all.
+  QMap<int, QList<int> > starts;
+  typedef QPair<int, int> Location;
+  foreach(Location location, found) {
+    starts[location.first].append(std::max(0, location.second));
+  }
+  QList<QPair<QString, int> > result;
+  QMapIterator<int, QList<int> > i(starts);
+  while (i.hasNext()) {
+    i.next();
+    QList<int> locations = i.value();
+    qSort(locations);
+    int runStart = -1;
+    foreach(int location, locations) {
+      if (runStart == -1 || location > runStart + errors) {
+        runStart = location;
+        result.append(qMakePair(keys.value(i.key()), runStart));
+      }
+    }
+  }
+  return result;
+}
+
+
+uint CorpusIndex::qgramHash(const QString &text, int pos) const {
+  uint hash = 0;
+  for (int x = pos; x < pos + q; x++) {
+    hash = hash * 31 + text[x].unicode();
+  }
+  return hash;
+}
+
+
+/////////////////////////////////////////////
+//
+// DiffHunk Class
+//
+/////////////////////////////////////////////
+
+
+DiffHunk::DiffHunk() :
+  firstDiff(0), diffCount(0), start1(0), length1(0), start2(0), length2(0) {
+}
+
+
+/**
+ * Display a human-readable version of this hunk, in the coordinates of a
+ * patch header.
+ * @return text version
+ */
+QString DiffHunk::toString() const {
+  return QString("DiffHunk(%1+%2,-%3,%4,+%5,%6)").arg(firstDiff)
+      .arg(diffCount).arg(start1).arg(length1).arg(start2).arg(length2);
+}
+
+
+/////////////////////////////////////////////
+//
+// DiffIndex Class
+//
+/////////////////////////////////////////////
+
+
+DiffIndex::DiffIndex() : starts1(1, 0), starts2(1, 0) {
+}
+
+
+DiffIndex::DiffIndex(const QList<Diff> &diffs) : diffList(diffs) {
+  starts1.reserve(diffs.size() + 1);
+  starts2.reserve(diffs.size() + 1);
+  int chars1 = 0;
+  int chars2 = 0;
+  for (int x = 0; x < diffs.size(); x++) {
+    starts1.append(chars1);
+    starts2.append(chars2);
+    const Diff &aDiff = diffs[x];
+    if (aDiff.operation != EQUAL) {
+      if (hunkList.isEmpty() || hunkList.last().firstDiff
+          + hunkList.last().diffCount != x) {
+        DiffHunk hunk;
+        hunk.firstDiff = x;
+        hunk.start1 = chars1;
+        hunk.start2 = chars2;
+        hunkList.append(hunk);
+      }
+      DiffHunk &hunk = hunkList.last();
+      hunk.diffCount++;
+      if (aDiff.operation == DELETE) {
+        hunk.length1 += aDiff.text.length();
+      } else {
+        hunk.length2 += aDiff.text.length();
+      }
+    }
+    if (aDiff.operation != INSERT) {
+      chars1 += aDiff.text.length();
+    }
+    if (aDiff.operation != DELETE) {
+      chars2 += aDiff.text.length();
+    }
+  }
+  starts1.append(chars1);
+  starts2.append(chars2);
+}
+
+
+const QList<Diff> &DiffIndex::diffs() const {
+  return diffList;
+}
+
+
+const QList<DiffHunk> &DiffIndex::hunks() const {
+  return hunkList;
+}
+
+
+int DiffIndex::length1() const {
+  return starts1.last();
+}
+
+
+int DiffIndex::length2() const {
+  return starts2.last();
+}
+
+
+int DiffIndex::start1(int diff) const {
+  return starts1[diff];
+}
+
+
+int DiffIndex::start2(int diff) const {
+  return starts2[diff];
+}
+
+
+int DiffIndex::diffAt(int loc) const {
+  // Binary search for the first diff which ends after loc, or is a deletion
+  // at or after loc.  Both conditions only become true further on.
+  int min = 0;
+  int max = diffList.size();
+  while (min < max) {
+    const int mid = min + (max - min) / 2;
+    const bool touches = starts2[mid + 1] > loc
+        || (starts2[mid + 1] == starts2[mid] && starts2[mid] >= loc);
+    if (touches) {
+      max = mid;
+    } else {
+      min = mid + 1;
+    }
+  }
+  return min;
+}
+
+
+int DiffIndex::hunkAt(int loc) const {
+  int min = 0;
+  int max = hunkList.size();
+  while (min < max) {
+    const int mid = min + (max - min) / 2;
+    if (hunkList[mid].start2 + hunkList[mid].length2 >= loc) {
+      max = mid;
+    } else {
+      min = mid + 1;
+    }
+  }
+  return min;
+}
+
+
+/////////////////////////////////////////////
+//
+// AlignedRow Class
+//
+/////////////////////////////////////////////
+
+
+AlignedRow::AlignedRow() : start(0) {
+}
+
+
+bool AlignedRow::isChanged() const {
+  return changed.contains(true);
+}
+
+
+/**
+ * Display a human-readable version of this row.
+ * @return text version
+ */
+QString AlignedRow::toString() const {
+  QStringList cells;
+  for (int x = 0; x < variants.size(); x++) {
+    cells.append((changed[x] ? "*\"" : "\"") + variants[x] + "\"");
+  }
+  return QString("AlignedRow(%1,\"%2\",[%3])").arg(start).arg(base)
+      .arg(cells.join(","));
+}
+
+
+/////////////////////////////////////////////
+//
+// ChunkTree Class
+//
+/////////////////////////////////////////////
+
+
+ChunkTree::ChunkTree() : content(""), size(1024), levels(1) {
+}
+
+
+ChunkTree::ChunkTree(const QString &text) :
+  content(text), size(1024), levels(1) {
+  for (int start = 0; start < content.length(); ) {
+    const int end = chunkEnd(start);
+    addChunk(start, end - start, chunkHash(start, end - start));
+    start = end;
+  }
+  buildLevels();
+}
+
+
+ChunkTree::ChunkTree(const QString &text, int chunkSize) :
+  content(text), size(chunkSize), levels(1) {
+  if (chunkSize <= 0) {
+    throw "Invalid chunk size.";
+  }
+  for (int start = 0; start < content.length(); ) {
+    const int end = chunkEnd(start);
+    addChunk(start, end - start, chunkHash(start, end - start));
+    start = end;
+  }
+  buildLevels();
+}
+
+
+const QString &ChunkTree::text() const {
+  return content;
+}
+
+
+int ChunkTree::chunkSize() const {
+  return size;
+}
+
+
+int ChunkTree::chunkCount() const {
+  return levels[0].size();
+}
+
+
+quint64 ChunkTree::hash() const {
+  return levels.last().isEmpty() ? 0 : levels.last()[0].hash;
+}
+
+
+void ChunkTree::update(const QList<Diff> &diffs) {
+  // Rebuild the new text and note which stretches of it are unchanged.
+  // Each run is (start in old text, start in new text, length).
+  QString text;
+  QList<QVector<int> > runs;
+  int length1 = 0;
+  foreach(const Diff &aDiff, diffs) {
+    if (aDiff.operation == EQUAL) {
+      QVector<int> run(3);
+      run[0] = length1;
+      run[1] = text.length();
+      run[2] = aDiff.text.length();
+      runs.append(run);
+    }
+    if (aDiff.operation != INSERT) {
+      length1 += aDiff.text.length();
+    }
+    if (aDiff.operation != DELETE) {
+      text += aDiff.text;
+    }
+  }
+  if (length1 != content.length()) {
+    throw "Diffs do not fit the chunk tree.";
+  }
+
+  const QVector<Node> chunks = levels[0];
+  const int length2 = text.length();
+  content = text;
+  levels.clear();
+  levels.resize(1);
+  int run = 0;
+  int chunk = 0;
+  for (int start = 0; start < length2; ) {
+    while (run < runs.size() && runs[run][1] + runs[run][2] <= start) {
+      run++;
+    }
+    if (run < runs.size() && runs[run][1] <= start) {
+      // A chunk which started at the same place in an unchanged stretch
+      // ends at the same place, so it can be reused without a scan.
+      const int oldStart = runs[run][0] + start - runs[run][1];
+      while (chunk < chunks.size() && chunks[chunk].start < oldStart) {
+        chunk++;
+      }
+      if (chunk < chunks.size() && chunks[chunk].start == oldStart) {
+        const Node &oldChunk = chunks[chunk];
+        const bool unchanged =
+            oldStart + oldChunk.length <= runs[run][0] + runs[run][2];
+        // The last chunk was cut short by the end of the text.
+        const bool last = (chunk == chunks.size() - 1)
+            && start + oldChunk.length != length2;
+        if (unchanged && !last) {
+          addChunk(start, oldChunk.length, oldChunk.hash);
+          start += oldChunk.length;
+          continue;
+        }
+      }
+    }
+    const int end = chunkEnd(start);
+    addChunk(start, end - start, chunkHash(start, end - start));
+    start = end;
+  }
+  buildLevels();
+}
+
+
+QList<DiffHunk> ChunkTree::changes(const ChunkTree &other) const {
+  if (size != other.size) {
+    throw "Chunk size mismatch.";
+  }
+  QList<DiffHunk> regions;
+  localize(other, levels.last(), other.levels.last(), 0, 0, regions);
+  return regions;
+}
+
+
+QString ChunkTree::toText() const {
+  QString text = QString::number(size) + "\n";
+  foreach(Node chunk, levels[0]) {
+    text += QString("%1 %2\n").arg(chunk.length).arg(chunk.hash, 16, 16,
+                                                      QChar('0'));
+  }
+  return text;
+}
+
+
+ChunkTree ChunkTree::fromText(const QString &data, const QString &text) {
+  QStringList lines = data.split("\n", QString::SkipEmptyParts);
+  bool ok = false;
+  const int chunkSize = lines.isEmpty() ? 0 : lines.takeFirst().toInt(&ok);
+  if (!ok || chunkSize <= 0) {
+    throw QString("Invalid chunk tree: %1").arg(data.left(20));
+  }
+  ChunkTree tree;
+  tree.content = text;
+  tree.size = chunkSize;
+  int start = 0;
+  foreach(const QString &line, lines) {
+    const QStringList fields = line.split(" ");
+    bool lengthOk = false;
+    bool hashOk = false;
+    const int length = fields.size() == 2 ? fields[0].toInt(&lengthOk) : 0;
+    const quint64 hash = fields.size() == 2
+        ? fields[1].toULongLong(&hashOk, 16) : 0;
+    if (!lengthOk || !hashOk || length <= 0) {
+      throw QString("Invalid chunk tree: %1").arg(line);
+    }
+    tree.addChunk(start, length, hash);
+    start += length;
+  }
+  if (start != text.length()) {
+    throw QString("Chunk tree length (%1) does not match text length (%2)")
+        .arg(start).arg(text.length());
+  }
+  tree.buildLevels();
+  return tree;
+}
+
+
+int ChunkTree::chunkEnd(int start) const {
+  const int minSize = std::max(CHUNK_WINDOW, size / 4);
+  const int end = std::min(content.length(), start + 4 * size);
+  if (start + minSize >= end) {
+    return end;
+  }
+  // Polynomial rolling hash over the last CHUNK_WINDOW characters of the
+  // chunk.  It restarts with each chunk, so a boundary depends only on the
+  // text since the previous boundary.
+  const uint base = 257;
+  uint basePower = 1;
+  for (int x = 0; x < CHUNK_WINDOW; x++) {
+    basePower *= base;
+  }
+  uint rolling = 0;
+  for (int x = start; x < end; x++) {
+    rolling = rolling * base + content[x].unicode();
+    if (x - start >= CHUNK_WINDOW) {
+      rolling -= content[x - CHUNK_WINDOW].unicode() * basePower;
+    }
+    if (x + 1 - start >= minSize
+        && ((rolling * 2654435761U) >> 8) % size == 0) {
+      return x + 1;
+    }
+  }
+  return end;
+}
+
+
+quint64 ChunkTree::chunkHash(int start, int length) const {
+  // 64-bit FNV-1a.
+  quint64 hash = Q_UINT64_C(14695981039346656037);
+  for (int x = start; x < start + length; x++) {
+    hash ^= content[x].unicode();
+    hash *= Q_UINT64_C(1099511628211);
+  }
+  return hash;
+}
+
+
+void ChunkTree::addChunk(int start, int length, quint64 hash) {
+  Node chunk;
+  chunk.hash = hash;
+  chunk.level = 0;
+  chunk.start = start;
+  chunk.length = length;
+  chunk.firstChild = 0;
+  chunk.childCount = 0;
+  levels[0].append(chunk);
+}
+
+
+void ChunkTree::buildLevels() {
+  levels.resize(1);
+  while (levels.last().size() > 1) {
+    const QVector<Node> &children = levels.last();
+    QVector<Node> parents;
+    bool open = false;
+    for (int x = 0; x < children.size(); x++) {
+      if (!open) {
+        Node parent;
+        parent.hash = Q_UINT64_C(14695981039346656037) ^ levels.size();
+        parent.level = levels.size();
+        parent.start = children[x].start;
+        parent.length = 0;
+        parent.firstChild = x;
+        parent.childCount = 0;
+        parents.append(parent);
+        open = true;
+      }
+      Node &parent = parents.last();
+      parent.hash = (parent.hash ^ children[x].hash)
+          * Q_UINT64_C(1099511628211);
+      parent.length += children[x].length;
+      parent.childCount++;
+      // Like the chunks, nodes end where their content says so.  Two
+      // children at least, so that each level is smaller than the last.
+      if ((parent.childCount >= 2
+           && (children[x].hash >> 32) % CHUNK_FANOUT == 0)
+          || parent.childCount == 4 * CHUNK_FANOUT) {
+        open = false;
+      }
+    }
+    levels.append(parents);
+  }
+}
+
+
+void ChunkTree::expand(QVector<Node> &nodes, int level) const {
+  QVector<Node> expanded;
+  foreach(Node node, nodes) {
+    if (node.level == level && level > 0) {
+      for (int x = 0; x < node.childCount; x++) {
+        expanded.append(levels[level - 1][node.firstChild + x]);
+      }
+    } else {
+      expanded.append(node);
+    }
+  }
+  nodes = expanded;
+}
+
+
+void ChunkTree::localize(const ChunkTree &other, const QVector<Node> &nodes1,
+                         const QVector<Node> &nodes2, int start1, int start2,
+                         QList<DiffHunk> &regions) const {
+  // Trim off identical nodes at both ends.
+  int first1 = 0;
+  int first2 = 0;
+  int last1 = nodes1.size();
+  int last2 = nodes2.size();
+  while (first1 < last1 && first2 < last2
+      && nodes1[first1].level == nodes2[first2].level
+      && nodes1[first1].hash == nodes2[first2].hash) {
+    start1 += nodes1[first1++].length;
+    start2 += nodes2[first2++].length;
+  }
+  while (first1 < last1 && first2 < last2
+      && nodes1[last1 - 1].level == nodes2[last2 - 1].level
+      && nodes1[last1 - 1].hash == nodes2[last2 - 1].hash) {
+    last1--;
+    last2--;
+  }
+
+  QVector<Node> middle1;
+  QVector<Node> middle2;
+  int length1 = 0;
+  int length2 = 0;
+  int level = 0;
+  for (int x = first1; x < last1; x++) {
+    middle1.append(nodes1[x]);
+    length1 += nodes1[x].length;
+    level = std::max(level, nodes1[x].level);
+  }
+  for (int x = first2; x < last2; x++) {
+    middle2.append(nodes2[x]);
+    length2 += nodes2[x].length;
+    level = std::max(level, nodes2[x].level);
+  }
+
+  if (!middle1.isEmpty() && !middle2.isEmpty()) {
+    // Open up the tallest nodes and anchor on children which occur once
+    // on each side, in the same order.
+    expand(middle1, level);
+    other.expand(middle2, level);
+    QHash<quint64, int> index1;
+    QHash<quint64, int> index2;
+    for (int x = 0; x < middle1.size(); x++) {
+      index1.insert(middle1[x].hash, index1.contains(middle1[x].hash) ? -1 : x);
+    }
+    for (int x = 0; x < middle2.size(); x++) {
+      index2.insert(middle2[x].hash, index2.contains(middle2[x].hash) ? -1 : x);
+    }
+    QList<QPair<int, int> > anchors;
+    for (int x = 0; x < middle1.size(); x++) {
+      const int y = index2.value(middle1[x].hash, -1);
+      if (index1.value(middle1[x].hash) == x && y != -1
+          && (anchors.isEmpty() || y > anchors.last().second)
+          && middle1[x].level == middle2[y].level) {
+        anchors.append(qMakePair(x, y));
+      }
+    }
+    if (anchors.isEmpty() && level == 0) {
+      // Nothing left in common.
+    } else if (anchors.isEmpty()) {
+      localize(other, middle1, middle2, start1, start2, regions);
+      return;
+    } else {
+      anchors.append(qMakePair(middle1.size(), middle2.size()));
+      int x = 0;
+      int y = 0;
+      typedef QPair<int, int> Anchor;
+      foreach(Anchor anchor, anchors) {
+        QVector<Node> gap1;
+        QVector<Node> gap2;
+        const int gapStart1 = start1;
+        const int gapStart2 = start2;
+        for (; x < anchor.first; x++) {
+          gap1.append(middle1[x]);
+          start1 += middle1[x].length;
+        }
+        for (; y < anchor.second; y++) {
+          gap2.append(middle2[y]);
+          start2 += middle2[y].length;
+        }
+        localize(other, gap1, gap2, gapStart1, gapStart2, regions);
+        if (x < middle1.size()) {
+          // Step over the anchor.
+          start1 += middle1[x++].length;
+          start2 += middle2[y++].length;
+        }
+      }
+      return;
+    }
+  }
+
+  if (length1 + length2 == 0) {
+    return;
+  }
+  if (!regions.isEmpty()
+      && regions.last().start1 + regions.last().length1 == start1
+      && regions.last().start2 + regions.last().length2 == start2) {
+    // Touches the previous region.
+    regions.last().length1 += length1;
+    regions.last().length2 += length2;
+    return;
+  }
+  DiffHunk region;
+  region.start1 = start1;
+  region.length1 = length1;
+  region.start2 = start2;
+  region.length2 = length2;
+  regions.append(region);
+}
+
+
+/////////////////////////////////////////////
+//
+// UnifiedDiffReader Class
+//
+/////////////////////////////////////////////
+
+
+UnifiedDiffReader::UnifiedDiffReader(QTextStream &input) :
+  input(input), hasPending(false) {
+}
+
+
+// A line of a diff without its "\n" or "\r\n".
+static QString unifiedDiffChop(const QString &line) {
+  int length = line.length();
+  if (length > 0 && line[length - 1] == '\n') {
+    length--;
+    if (length > 0 && line[length - 1] == '\r') {
+      length--;
+    }
+  }
+  return line.left(length);
+}
+
+
+bool UnifiedDiffReader::next() {
+  path1 = QString();
+  path2 = QString();
+  hunks.clear();
+  bool started = false;
+  QString line;
+  while (readLine(line)) {
+    if (line.startsWith("diff ")) {
+      if (started) {
+        unreadLine(line);
+        return true;
+      }
+      started = true;
+      const QString command = unifiedDiffChop(line);
+      const int split = command.indexOf(" b/");
+      if (command.startsWith("diff --git a/") && split != -1) {
+        // diff --git a/path b/path, where the paths may hold spaces.  Both
+        // are the same unless the file was renamed, which the ---/+++ lines
+        // then spell out.
+        const QString paths = command.mid(11);
+        const int half = paths.length() / 2;
+        if (paths.length() % 2 == 1 && paths[half] == ' '
+            && paths.mid(2, half - 2) == paths.mid(half + 3)) {
+          path1 = paths.left(half);
+          path2 = paths.mid(half + 1);
+        } else {
+          path1 = command.mid(11, split - 11);
+          path2 = command.mid(split + 1);
+        }
+      } else {
+        // diff [options] path1 path2
+        const QStringList words = command.split(" ", QString::SkipEmptyParts);
+        if (words.size() >= 4) {
+          path1 = words[words.size() - 2];
+          path2 = words[words.size() - 1];
+        }
+      }
+    } else if (line.startsWith("--- ")) {
+      if (!hunks.isEmpty()) {
+        // diff -u of several files has no diff lines between them.
+        unreadLine(line);
+        return true;
+      }
+      started = true;
+      // Drop any timestamp after the tab.
+      path1 = unifiedDiffChop(line).mid(4).section('\t', 0, 0);
+    } else if (line.startsWith("+++ ")) {
+      path2 = unifiedDiffChop(line).mid(4).section('\t', 0, 0);
+    } else if (line.startsWith("@@ ")) {
+      started = true;
+      readHunk(line);
+    }
+    // Anything else (index, mode and rename lines, binary notices) is
+    // metadata which the patches don't need.
+  }
+  return started;
+}
+
+
+QString UnifiedDiffReader::oldPath() const {
+  return path1;
+}
+
+
+QString UnifiedDiffReader::newPath() const {
+  return path2;
+}
+
+
+int UnifiedDiffReader::hunkCount() const {
+  return hunks.size();
+}
+
+
+QList<Patch> UnifiedDiffReader::patches(const QString &text1) const {
+  QList<Patch> patches;
+  // Walk the old text forward, one hunk at a time.
+  int line = 0;
+  int offset = 0;
+  int delta = 0;
+  foreach(const Patch &hunk, hunks) {
+    while (line < hunk.start1 && offset < text1.length()) {
+      const int newline = text1.indexOf('\n', offset);
+      offset = (newline == -1) ? text1.length() : newline + 1;
+      line++;
+    }
+    Patch patch = hunk;
+    patch.start1 = offset;
+    patch.start2 = offset + delta;
+    patch.length1 = 0;
+    patch.length2 = 0;
+    foreach(const Diff &aDiff, hunk.diffs) {
+      if (aDiff.operation != INSERT) {
+        patch.length1 += aDiff.text.length();
+      }
+      if (aDiff.operation != DELETE) {
+        patch.length2 += aDiff.text.length();
+      }
+    }
+    delta += patch.length2 - patch.length1;
+    patches.append(patch);
+  }
+  return patches;
+}
+
+
+bool UnifiedDiffReader::readLine(QString &line) {
+  if (hasPending) {
+    line = pending;
+    hasPending = false;
+    return true;
+  }
+  // QTextStream::readLine would drop the "\r" of a "\r\n", which belongs
+  // to the lines of the file being patched, so split the stream here.
+  int newline = buffer.indexOf('\n');
+  while (newline == -1 && !input.atEnd()) {
+    const int searched = buffer.length();
+    buffer += input.read(4096);
+    newline = buffer.indexOf('\n', searched);
+  }
+  if (buffer.isEmpty()) {
+    return false;
+  }
+  const int length = (newline == -1) ? buffer.length() : newline + 1;
+  line = buffer.left(length);
+  buffer.remove(0, length);
+  return true;
+}
+
+
+void UnifiedDiffReader::unreadLine(const QString &line) {
+  pending = line;
+  hasPending = true;
+}
+
+
+void UnifiedDiffReader::readHunk(const QString &header) {
+  // A section heading may follow the closing @@.
+  QRegExp hunkHeader("^@@ -(\\d+),?(\\d*) \\+(\\d+),?(\\d*) @@.*$");
+  if (!hunkHeader.exactMatch(unifiedDiffChop(header))) {
+    throw QString("Invalid unified diff hunk: %1").arg(header);
+  }
+  Patch hunk;
+  // An omitted count is 1; an empty range starts after the given line.
+  int remaining1 = hunkHeader.cap(2).isEmpty() ? 1 : hunkHeader.cap(2).toInt();
+  int remaining2 = hunkHeader.cap(4).isEmpty() ? 1 : hunkHeader.cap(4).toInt();
+  hunk.start1 = hunkHeader.cap(1).toInt() - (remaining1 == 0 ? 0 : 1);
+  hunk.start2 = hunkHeader.cap(3).toInt() - (remaining2 == 0 ? 0 : 1);
+
+  QString line;
+  while ((remaining1 > 0 || remaining2 > 0) && readLine(line)) {
+    Operation op;
+    // The text of the line, with its line ending as read.
+    QString text = line.mid(1);
+    if (line[0] == '\n' || line[0] == '\r') {
+      // Some tools strip the space off empty context lines.
+      op = EQUAL;
+      text = line;
+      remaining1--;
+      remaining2--;
+    } else if (line[0] == ' ') {
+      op = EQUAL;
+      remaining1--;
+      remaining2--;
+    } else if (line[0] == '-') {
+      op = DELETE;
+      remaining1--;
+    } else if (line[0] == '+') {
+      op = INSERT;
+      remaining2--;
+    } else if (line[0] == '\\') {
+      // No newline at end of file.
+      if (!hunk.diffs.isEmpty()) {
+        hunk.diffs.last().text.chop(1);
+      }
+      continue;
+    } else {
+      throw QString("Invalid unified diff line: %1")
+          .arg(unifiedDiffChop(line));
+    }
+    if (!text.endsWith('\n')) {
+      // The diff itself ended without a newline.
+      text += '\n';
+    }
+    if (!hunk.diffs.isEmpty() && hunk.diffs.last().operation == op) {
+      hunk.diffs.last().text += text;
+    } else {
+      hunk.diffs.append(Diff(op, text));
+    }
+  }
+  if (remaining1 > 0 || remaining2 > 0) {
+    throw QString("Truncated unified diff hunk: %1").arg(header);
+  }
+  if (readLine(line)) {
+    if (line.startsWith("\\") && !hunk.diffs.isEmpty()) {
+      hunk.diffs.last().text.chop(1);
+    } else {
+      unreadLine(line);
+    }
+  }
+  hunks.append(hunk);
+}
+
+
+/////////////////////////////////////////////
+//
+// CapturedCall Class
+//
+/////////////////////////////////////////////
+
+
+// Percent-encode a field of a capture line, like the insertions of
+// diff_toDelta, so that it holds no tabs or newlines.
+static QString captureEncode(const QString &text) {
+  return QString(QUrl::toPercentEncoding(text, " !~*'();/?:@&=+$,#"));
+}
+
+
+static QString captureDecode(const QString &text) {
+  return QUrl::fromPercentEncoding(qPrintable(text));
+}
+
+
+// The text and the success flags of a patch_apply, to hash.
+static QString captureResult(const QPair<QString, QVector<bool> > &result) {
+  QString flags;
+  foreach(bool applied, result.second) {
+    flags += applied ? "1" : "0";
+  }
+  return result.first + "\t" + flags;
+}
+
+
+CapturedCall::CapturedCall() : seconds(0.0), resultHash(0) {
+}
+
+
+QString CapturedCall::toString() const {
+  QStringList fields;
+  fields << function << QString::number(seconds)
+      << QString::number(resultHash, 16) << captureEncode(settings);
+  foreach(const QString &input, inputs) {
+    fields << captureEncode(input);
+  }
+  return fields.join("\t");
+}
+
+
+CapturedCall CapturedCall::fromString(const QString &line) {
+  const QStringList fields = line.split("\t");
+  CapturedCall call;
+  bool secondsOk = false;
+  bool hashOk = false;
+  if (fields.size() >= 4) {
+    call.function = fields[0];
+    call.seconds = fields[1].toDouble(&secondsOk);
+    call.resultHash = fields[2].toUInt(&hashOk, 16);
+    call.settings = captureDecode(fields[3]);
+    for (int x = 4; x < fields.size(); x++) {
+      call.inputs.append(captureDecode(fields[x]));
+    }
+  }
+  if (!secondsOk || !hashOk) {
+    throw QString("Invalid captured call: %1").arg(line.left(40));
+  }
+  return call;
+}
+
+
+/////////////////////////////////////////////
+//
+// StreamingDiff Class
+//
+/////////////////////////////////////////////
+
+
+// A substring that is never null, even when it is empty.
+static QString streamMid(const QString &text, int pos, int len = -1) {
+  if (pos >= text.length() || len == 0) {
+    return QString("");
+  }
+  return text.mid(pos, len);
+}
+
+
+StreamingDiff::StreamingDiff(diff_match_patch &dmp) :
+  dmp(dmp), text1(""), text2(""), finished1(false), finished2(false),
+  done1(0), done2(0), indexed1(0), scanned2(0) {
+}
+
+
+StreamingDiff::StreamingDiff(diff_match_patch &dmp, const QString &text1) :
+  dmp(dmp), text1(""), text2(""), finished1(false), finished2(false),
+  done1(0), done2(0), indexed1(0), scanned2(0) {
+  append1(text1);
+  finish1();
+}
+
+
+void StreamingDiff::append1(const QString &chunk) {
+  if (finished1) {
+    throw "Text1 has already ended. (StreamingDiff)";
+  }
+  text1 += chunk;
+  advance();
+}
+
+
+void StreamingDiff::append2(const QString &chunk) {
+  if (finished2) {
+    throw "Text2 has already ended. (StreamingDiff)";
+  }
+  text2 += chunk;
+  advance();
+}
+
+
+void StreamingDiff::finish1() {
+  finished1 = true;
+  advance();
+}
+
+
+void StreamingDiff::finish2() {
+  finished2 = true;
+  advance();
+}
+
+
+QList<Diff> StreamingDiff::takeDiffs() {
+  QList<Diff> diffs = pending;
+  pending.clear();
+  return diffs;
+}
+
+
+bool StreamingDiff::isFinished() const {
+  return finished1 && finished2 && done1 == text1.length()
+      && done2 == text2.length();
+}
+
+
+int StreamingDiff::committed1() const {
+  return done1;
+}
+
+
+int StreamingDiff::committed2() const {
+  return done2;
+}
+
+
+void StreamingDiff::indexLines() {
+  const int oldIndexed1 = indexed1;
+  while (indexed1 < text1.length()) {
+    int lineEnd = text1.indexOf('\n', indexed1);
+    if (lineEnd == -1) {
+      if (!finished1) {
+        // Wait for the rest of the line.
+        return;
+      }
+      lineEnd = text1.length() - 1;
+    }
+    const QString line = text1.mid(indexed1, lineEnd + 1 - indexed1);
+    if (!lineStarts1.contains(line)) {
+      lineStarts1.insert(line, indexed1);
+    }
+    lineCounts1[line]++;
+    indexed1 = lineEnd + 1;
+  }
+  if (indexed1 != oldIndexed1) {
+    // Lines of text2 passed over may now be found in text1, and lines
+    // which were unique there may no longer be; try them all again.
+    scanned2 = done2;
+  }
+}
+
+
+void StreamingDiff::advance() {
+  indexLines();
+  if (finished1 && finished2) {
+    // Nothing more will arrive: diff whatever is left.
+    if (done1 < text1.length() || done2 < text2.length()) {
+      commit(dmp.diff_main(streamMid(text1, done1), streamMid(text2, done2),
+                           true));
+    }
+    lineStarts1.clear();
+    lineCounts1.clear();
+    return;
+  }
+
+  while (true) {
+    // Commit the common prefix a whole line at a time, since the rest of a
+    // line may still differ.
+    int common = 0;
+    while (done1 + common < text1.length() && done2 + common < text2.length()
+        && text1[done1 + common] == text2[done2 + common]) {
+      common++;
+    }
+    const int lineEnd = common == 0 ? -1
+        : text1.lastIndexOf('\n', done1 + common - 1);
+    if (lineEnd >= done1) {
+      commit(QList<Diff>() << Diff(EQUAL,
+                                   text1.mid(done1, lineEnd + 1 - done1)));
+    }
+
+    // Close the region in front of the next anchor.
+    int start1, start2, length;
+    if (!findAnchor(start1, start2, length)) {
+      return;
+    }
+    QList<Diff> diffs = dmp.diff_main(streamMid(text1, done1, start1 - done1),
+        streamMid(text2, done2, start2 - done2), true);
+    diffs.append(Diff(EQUAL, text1.mid(start1, length)));
+    commit(diffs);
+  }
+}
+
+
+bool StreamingDiff::findAnchor(int &start1, int &start2, int &length) {
+  scanned2 = std::max(scanned2, done2);
+  while (scanned2 < text2.length()) {
+    // Take STREAM_ANCHOR_LINES lines of text2.
+    int end2 = scanned2 - 1;
+    int lines = 0;
+    while (lines < STREAM_ANCHOR_LINES && end2 < text2.length() - 1) {
+      int lineEnd = text2.indexOf('\n', end2 + 1);
+      if (lineEnd == -1) {
+        if (!finished2) {
+          // Wait for the rest of the line.
+          return false;
+        }
+        lineEnd = text2.length() - 1;
+      }
+      end2 = lineEnd;
+      lines++;
+    }
+    if (lines < STREAM_ANCHOR_LINES && !finished2) {
+      // Wait for more lines.
+      return false;
+    }
+    const int firstEnd = text2.indexOf('\n', scanned2);
+    const QString first = text2.mid(scanned2, (firstEnd == -1
+        ? text2.length() : firstEnd + 1) - scanned2);
+    const int candidate = lineStarts1.value(first, -1);
+    if (lineCounts1.value(first) == 1 && !first.trimmed().isEmpty()
+        && candidate >= done1) {
+      // The same lines have to follow in text1 too.
+      length = end2 + 1 - scanned2;
+      if (candidate + length > indexed1) {
+        if (!finished1) {
+          // Wait for more of text1.
+          return false;
+        }
+      } else if (text1.mid(candidate, length)
+                 == text2.mid(scanned2, length)) {
+        start1 = candidate;
+        start2 = scanned2;
+        scanned2 += length;
+        return true;
+      }
+    }
+    scanned2 = (firstEnd == -1) ? text2.length() : firstEnd + 1;
+  }
+  return false;
+}
+
+
+void StreamingDiff::commit(const QList<Diff> &diffs) {
+  foreach(const Diff &diff, diffs) {
+    if (diff.text.isEmpty()) {
+      continue;
+    }
+    if (diff.operation != INSERT) {
+      done1 += diff.text.length();
+    }
+    if (diff.operation != DELETE) {
+      done2 += diff.text.length();
+    }
+    if (!pending.isEmpty() && pending.last().operation == diff.operation) {
+      pending.last().text += diff.text;
+    } else {
+      pending.append(diff);
+    }
+  }
+}
+
+
+/////////////////////////////////////////////
+//
+// DiffSession Class
+//
+/////////////////////////////////////////////
+
+
+DiffSession::DiffSession(diff_match_patch &dmp, const QString &text) :
+  dmp(dmp), latest(text) {
+  reset();
+}
+
+
+QList<Diff> DiffSession::next(const QString &text) {
+  QList<Diff> diffs;
+  if (text == latest) {
+    // Speedup.
+    if (!text.isEmpty()) {
+      diffs.append(Diff(EQUAL, text));
+    }
+    return diffs;
+  }
+
+  QString chars = dmp.diff_linesToCharsMunge(text, lineArray, lineHash);
+  if (lineArray.size() > 0xFFFF) {
+    // Lines of old versions have filled up the tokens; start again from
+    // the two versions at hand.
+    reset();
+    chars = dmp.diff_linesToCharsMunge(text, lineArray, lineHash);
+    if (lineArray.size() > 0xFFFF) {
+      // Even these two have too many distinct lines for the tokens.
+      diffs = dmp.diff_main(latest, text, false);
+      latest = text;
+      reset();
+      return diffs;
+    }
+  }
+  if (chars.isNull()) {
+    chars = "";
+  }
+
+  clock_t deadline;
+  if (dmp.Diff_Timeout <= 0) {
+    deadline = std::numeric_limits<clock_t>::max();
+  } else {
+    deadline = clock() + (clock_t)(dmp.Diff_Timeout * CLOCKS_PER_SEC);
+  }
+  diffs = dmp.diff_lineModeTokens(latestChars, chars, lineArray, deadline);
+  dmp.diff_cleanupMerge(diffs);
+
+  latest = text;
+  latestChars = chars;
+  return diffs;
+}
+
+
+QString DiffSession::text() const {
+  return latest;
+}
+
+
+int DiffSession::lineCount() const {
+  // Leave out the junk entry at index 0.
+  return lineArray.size() - 1;
+}
+
+
+void DiffSession::reset() {
+  lineArray.clear();
+  lineHash.clear();
+  // "\x00" is a valid character, but various debuggers don't like it.
+  // So we'll insert a junk entry to avoid generating a null character.
+  lineArray.append("");
+  latestChars = dmp.diff_linesToCharsMunge(latest, lineArray, lineHash);
+  if (latestChars.isNull()) {
+    latestChars = "";
+  }
+}
+
+
+/////////////////////////////////////////////
+//
+// DeltaModel Class
+//
+/////////////////////////////////////////////
+
+
+// Logistic mixing works on probabilities stretched to ln(p/(1-p)), scaled
+// by 256 and clamped to +-2047, and squashed back to 12 bits.  Both are
+// integer tables (stretch being built from squash), so the encoder and the
+// decoder agree bit for bit on any platform.
+static int deltaSquash(int x) {
+  static const int table[33] = {
+      1, 2, 3, 6, 10, 16, 27, 45, 73, 120, 194, 310, 488, 747, 1101, 1546,
+      2047, 2549, 2994, 3348, 3607, 3785, 3901, 3975, 4022, 4050, 4068, 4079,
+      4085, 4089, 4092, 4093, 4094};
+  if (x > 2047) {
+    return 4095;
+  }
+  if (x < -2047) {
+    return 1;
+  }
+  const int w = x & 127;
+  const int i = (x >> 7) + 16;
+  return (table[i] * (128 - w) + table[i + 1] * w + 64) >> 7;
+}
+
+
+struct DeltaStretch {
+  short table[4096];
+  DeltaStretch() {
+    int pi = 0;
+    for (int x = -2047; x <= 2047; x++) {
+      const int v = deltaSquash(x);
+      for (int i = pi; i <= v; i++) {
+        table[i] = x;
+      }
+      pi = v + 1;
+    }
+    for (int i = pi; i < 4096; i++) {
+      table[i] = 2047;
+    }
+  }
+};
+
+static const DeltaStretch deltaStretch;
+
+
+DeltaModel::DeltaModel() : lastOp(3), lastChar(0), lastChar2(0),
+    matchPointer(-1), matchLength(0), expectedBit(-1), weightSet(NULL),
+    mixed(DELTA_PROB_HALF) {
+  std::fill(&ops[0][0], &ops[0][0] + 4 * 4, DELTA_PROB_HALF);
+  std::fill(&lengthBits[0][0], &lengthBits[0][0] + 3 * 32, DELTA_PROB_HALF);
+  std::fill(&lengthMantissa[0][0][0], &lengthMantissa[0][0][0] + 3 * 32 * 16,
+            DELTA_PROB_HALF);
+  std::fill(charSame, charSame + 2, DELTA_PROB_HALF);
+  std::fill(charHigh, charHigh + 256, DELTA_PROB_HALF);
+  std::fill(matchRight, matchRight + 16, DELTA_PROB_HALF);
+  std::fill(slots, slots + 4, static_cast<quint16 *>(NULL));
+  std::fill(stretched, stretched + 4, 0);
+}
+
+
+int DeltaModel::predictLow(int node) {
+  if (weights.isEmpty()) {
+    // Deltas without insertions never need the character tables.
+    lowOrder0.fill(DELTA_PROB_HALF, 256);
+    lowOrder1.fill(DELTA_PROB_HALF, 256 * 256);
+    lowOrder2.fill(DELTA_PROB_HALF, 1 << DELTA_ORDER2_BITS);
+    matchTable.fill(-1, 1 << DELTA_MATCH_BITS);
+    weights.fill(16384, 2 * 256 * 4);
+  }
+  const quint32 hash = ((static_cast<quint32>(lastChar2) << 16) | lastChar)
+      * 2654435761u;
+  slots[0] = lowOrder0.data() + node;
+  slots[1] = lowOrder1.data() + 256 * (lastChar & 0xFF) + node;
+  slots[2] = lowOrder2.data()
+      + ((hash >> (32 - DELTA_ORDER2_BITS + 8)) << 8) + node;
+  for (int i = 0; i < 3; i++) {
+    stretched[i] = deltaStretch.table[*slots[i]];
+  }
+  // The match only has a say while the bits so far agree with it.
+  expectedBit = -1;
+  stretched[3] = 0;
+  if (matchLength > 0) {
+    int depth = 0;
+    while ((node >> (depth + 1)) != 0) {
+      depth++;
+    }
+    const int expected = (history.at(matchPointer) & 0xFF) | 0x100;
+    if ((expected >> (8 - depth)) == node) {
+      expectedBit = (expected >> (7 - depth)) & 1;
+      const int right = matchRight[std::min(matchLength, 15)];
+      stretched[3] = deltaStretch.table[expectedBit == 0 ? right : 4096 - right];
+    }
+  }
+  weightSet = weights.data() + 4 * (node + (expectedBit == -1 ? 0 : 256));
+  qint64 dot = 0;
+  for (int i = 0; i < 4; i++) {
+    dot += static_cast<qint64>(stretched[i]) * weightSet[i];
+  }
+  mixed = std::max(1, std::min(4095, deltaSquash(static_cast<int>(dot >> 16))));
+  return mixed;
+}
+
+
+void DeltaModel::updateLow(int bit) {
+  // Move each weight along its input, by how far the mix was off.
+  const int error = (bit == 0 ? 4095 : 0) - mixed;
+  for (int i = 0; i < 4; i++) {
+    weightSet[i] += (stretched[i] * error) >> 10;
+  }
+  for (int i = 0; i < 3; i++) {
+    quint16 &prob = *slots[i];
+    if (bit == 0) {
+      prob += ((1 << DELTA_PROB_BITS) - prob) >> DELTA_MOVE_BITS;
+    } else {
+      prob -= prob >> DELTA_MOVE_BITS;
+    }
+  }
+  if (expectedBit != -1) {
+    quint16 &prob = matchRight[std::min(matchLength, 15)];
+    if (bit == expectedBit) {
+      prob += ((1 << DELTA_PROB_BITS) - prob) >> DELTA_MOVE_BITS;
+    } else {
+      prob -= prob >> DELTA_MOVE_BITS;
+    }
+  }
+}
+
+
+void DeltaModel::pushChar(ushort c) {
+  lastChar2 = lastChar;
+  lastChar = c;
+  if (matchLength > 0 && history.at(matchPointer) == c) {
+    matchLength++;
+    matchPointer++;
+  } else {
+    matchLength = 0;
+  }
+  history.append(c);
+  const int size = history.size();
+  if (size < DELTA_MATCH_MIN) {
+    return;
+  }
+  const ushort *chars = history.constData() + size - DELTA_MATCH_MIN;
+  quint32 hash = 0;
+  for (int i = 0; i < DELTA_MATCH_MIN; i++) {
+    hash = (hash + chars[i] + 1) * 2654435761u;
+  }
+  int &last = matchTable[hash >> (32 - DELTA_MATCH_BITS)];
+  if (matchLength == 0 && last != -1) {
+    matchPointer = last;
+    matchLength = 1;
+  }
+  last = size;
+}
+
+
+/////////////////////////////////////////////
+//
+// DeltaEncoder Class
+//
+/////////////////////////////////////////////
+
+
+DeltaEncoder::DeltaEncoder(QIODevice &output) :
+  output(output), low(0), range(0xFFFFFFFF), cache(0), cacheSize(1),
+  finished(false) {
+  pending.append(DELTA_MAGIC);
+  pending.append(static_cast<char>(DELTA_VERSION));
+}
+
+
+void DeltaEncoder::write(const Diff &aDiff) {
+  if (finished) {
+    throw "Delta has already been finished. (DeltaEncoder)";
+  }
+  const int op = aDiff.operation;
+  encodeTree(model.ops[model.lastOp], 2, op);
+  model.lastOp = op;
+  encodeLength(op, aDiff.text.length());
+  if (aDiff.operation == INSERT) {
+    const ushort *chars = aDiff.text.utf16();
+    for (int i = 0; i < aDiff.text.length(); i++) {
+      const int high = chars[i] >> 8;
+      const int lastHigh = model.lastChar >> 8;
+      // Runs of one script share the high byte, and ASCII text has it 0.
+      quint16 &same = model.charSame[lastHigh == 0 ? 0 : 1];
+      encodeBit(same, high == lastHigh ? 0 : 1);
+      if (high != lastHigh) {
+        encodeTree(model.charHigh, 8, high);
+      }
+      int node = 1;
+      for (int bit = 7; bit >= 0; bit--) {
+        const int value = (chars[i] >> bit) & 1;
+        encode(model.predictLow(node), value);
+        model.updateLow(value);
+        node = (node << 1) | value;
+      }
+      model.pushChar(chars[i]);
+    }
+  }
+  if (pending.size() >= DELTA_FLUSH_SIZE) {
+    output.write(pending);
+    pending.clear();
+  }
+}
+
+
+void DeltaEncoder::finish() {
+  if (finished) {
+    return;
+  }
+  encodeTree(model.ops[model.lastOp], 2, 3);
+  for (int i = 0; i < 5; i++) {
+    shiftLow();
+  }
+  output.write(pending);
+  pending.clear();
+  finished = true;
+}
+
+
+void DeltaEncoder::encode(int prob, int bit) {
+  const quint32 bound = (range >> DELTA_PROB_BITS) * prob;
+  if (bit == 0) {
+    range = bound;
+  } else {
+    low += bound;
+    range -= bound;
+  }
+  while (range < DELTA_TOP) {
+    range <<= 8;
+    shiftLow();
+  }
+}
+
+
+void DeltaEncoder::encodeBit(quint16 &prob, int bit) {
+  encode(prob, bit);
+  if (bit == 0) {
+    prob += ((1 << DELTA_PROB_BITS) - prob) >> DELTA_MOVE_BITS;
+  } else {
+    prob -= prob >> DELTA_MOVE_BITS;
+  }
+}
+
+
+void DeltaEncoder::encodeDirect(int bit) {
+  range >>= 1;
+  if (bit != 0) {
+    low += range;
+  }
+  while (range < DELTA_TOP) {
+    range <<= 8;
+    shiftLow();
+  }
+}
+
+
+void DeltaEncoder::encodeTree(quint16 *probs, int bits, int value) {
+  // Most significant bit first, each under the probability of the bits
+  // above it.
+  int node = 1;
+  for (int i = bits - 1; i >= 0; i--) {
+    const int bit = (value >> i) & 1;
+    encodeBit(probs[node], bit);
+    node = (node << 1) | bit;
+  }
+}
+
+
+void DeltaEncoder::encodeLength(int op, int length) {
+  // Elias gamma style: the bit count of length + 1, then the bits below its
+  // leading one, the top few of them modelled and the rest sent as is.
+  const quint32 value = static_cast<quint32>(length) + 1;
+  int bits = 0;
+  while ((value >> (bits + 1)) != 0) {
+    bits++;
+  }
+  encodeTree(model.lengthBits[op], 5, bits);
+  int node = 1;
+  for (int i = bits - 1; i >= 0; i--) {
+    const int bit = (value >> i) & 1;
+    if (bits - 1 - i < DELTA_MANTISSA_BITS) {
+      encodeBit(model.lengthMantissa[op][bits][node], bit);
+      node = (node << 1) | bit;
+    } else {
+      encodeDirect(bit);
+    }
+  }
+}
+
+
+void DeltaEncoder::shiftLow() {
+  // A carry out of low has to ripple into the bytes held back in cache.
+  if (static_cast<quint32>(low) < 0xFF000000u || (low >> 32) != 0) {
+    const uchar carry = static_cast<uchar>(low >> 32);
+    uchar temp = cache;
+    do {
+      pending.append(static_cast<char>(temp + carry));
+      temp = 0xFF;
+    } while (--cacheSize != 0);
+    cache = static_cast<uchar>(low >> 24);
+  }
+  cacheSize++;
+  low = (low & 0x00FFFFFF) << 8;
+}
+
+
+/////////////////////////////////////////////
+//
+// DeltaDecoder Class
+//
+/////////////////////////////////////////////
+
+
+DeltaDecoder::DeltaDecoder(QIODevice &input) :
+  input(input), range(0xFFFFFFFF), code(0), finished(false) {
+  const QByteArray header = input.read(qstrlen(DELTA_MAGIC) + 1);
+  if (header != QByteArray(DELTA_MAGIC)
+      + static_cast<char>(DELTA_VERSION)) {
+    throw QString("Not a compressed delta (DeltaDecoder)");
+  }
+  for (int i = 0; i < 5; i++) {
+    code = (code << 8) | nextByte();
+  }
+}
+
+
+bool DeltaDecoder::read(Operation &op, int &length, QString &text) {
+  text.clear();
+  if (finished) {
+    return false;
+  }
+  const int symbol = decodeTree(model.ops[model.lastOp], 2);
+  if (symbol == 3) {
+    finished = true;
+    return false;
+  }
+  model.lastOp = symbol;
+  op = static_cast<Operation>(symbol);
+  length = decodeLength(symbol);
+  if (op == INSERT) {
+    text.reserve(std::min(length, DELTA_FLUSH_SIZE));
+    for (int i = 0; i < length; i++) {
+      int high = model.lastChar >> 8;
+      quint16 &same = model.charSame[high == 0 ? 0 : 1];
+      if (decodeBit(same) != 0) {
+        high = decodeTree(model.charHigh, 8);
+      }
+      int node = 1;
+      while (node < 256) {
+        const int value = decode(model.predictLow(node));
+        model.updateLow(value);
+        node = (node << 1) | value;
+      }
+      const ushort c = static_cast<ushort>((high << 8) | (node & 0xFF));
+      model.pushChar(c);
+      text += QChar(c);
+    }
+  }
+  return true;
+}
+
+
+int DeltaDecoder::decode(int prob) {
+  const quint32 bound = (range >> DELTA_PROB_BITS) * prob;
+  int bit;
+  if (code < bound) {
+    range = bound;
+    bit = 0;
+  } else {
+    code -= bound;
+    range -= bound;
+    bit = 1;
+  }
+  while (range < DELTA_TOP) {
+    range <<= 8;
+    code = (code << 8) | nextByte();
+  }
+  return bit;
+}
+
+
+int DeltaDecoder::decodeBit(quint16 &prob) {
+  const int bit = decode(prob);
+  if (bit == 0) {
+    prob += ((1 << DELTA_PROB_BITS) - prob) >> DELTA_MOVE_BITS;
+  } else {
+    prob -= prob >> DELTA_MOVE_BITS;
+  }
+  return bit;
+}
+
+
+int DeltaDecoder::decodeDirect() {
+  range >>= 1;
+  int bit = 0;
+  if (code >= range) {
+    code -= range;
+    bit = 1;
+  }
+  while (range < DELTA_TOP) {
+    range <<= 8;
+    code = (code << 8) | nextByte();
+  }
+  return bit;
+}
+
+
+int DeltaDecoder::decodeTree(quint16 *probs, int bits) {
+  int node = 1;
+  for (int i = 0; i < bits; i++) {
+    node = (node << 1) | decodeBit(probs[node]);
+  }
+  return node - (1 << bits);
+}
+
+
+int DeltaDecoder::decodeLength(int op) {
+  const int bits = decodeTree(model.lengthBits[op], 5);
+  quint32 value = 1;
+  int node = 1;
+  for (int i = bits - 1; i >= 0; i--) {
+    int bit;
+    if (bits - 1 - i < DELTA_MANTISSA_BITS) {
+      bit = decodeBit(model.lengthMantissa[op][bits][node]);
+      node = (node << 1) | bit;
+    } else {
+      bit = decodeDirect();
+    }
+    value = (value << 1) | bit;
+  }
+  if (value - 1 > static_cast<quint32>(std::numeric_limits<int>::max())) {
+    throw QString("Invalid length in compressed delta: %1").arg(value - 1);
+  }
+  return static_cast<int>(value - 1);
+}
+
+
+uchar DeltaDecoder::nextByte() {
+  char c;
+  if (!input.getChar(&c)) {
+    throw QString("Truncated compressed delta (DeltaDecoder)");
+  }
+  return static_cast<uchar>(c);
+}
+
+
+/////////////////////////////////////////////
+//
+// diff_match_patch Class
+//
+/////////////////////////////////////////////
+
+diff_match_patch::diff_match_patch() :
+  Diff_Timeout(1.0f),
+  Diff_EditCost(4),
+  Match_Threshold(0.5f),
+  Match_Distance(1000),
+  Patch_DeleteThreshold(0.5f),
+  Patch_Margin(4),
+  Match_MaxBits(32),
+  Diff_LineModeThreshold(100),
+  Diff_HalfMatchSeeds(2),
+  Diff_TokenCost(0.0),
+  Diff_BisectCost(0.0),
+  Diff_ScanCost(0.0),
+  Sketch_Size(64),
+  Match_Threads(1),
+  Diff_Threads(1),
+  Capture_Threshold(0.1f),
+  captureDepth(0) {
+}
+
+
+QList<Diff> diff_match_patch::diff_main(const QString &text1,
+                                        const QString &text2) {
+  return diff_main(text1, text2, true);
+}
+
+QList<Diff> diff_match_patch::diff_main(const QString &text1,
+    const QString &text2, bool checklines) {
+  if (!Capture_File.isEmpty() && captureDepth == 0) {
+    // Time the call and keep it if it was slow.
+    const clock_t start = clock();
+    QList<Diff> diffs;
+    captureDepth++;
+    try {
+      diffs = diff_main(text1, text2, checklines);
+    } catch (...) {
+      captureDepth--;
+      throw;
+    }
+    captureDepth--;
+    const double seconds =
+        (clock() - start) / static_cast<double>(CLOCKS_PER_SEC);
+    if (seconds >= Capture_Threshold) {
+      CapturedCall call;
+      call.function = "diff_main";
+      call.seconds = seconds;
+      call.settings = capture_settings();
+      call.inputs << (checklines ? "1" : "0") << text1 << diff_toDelta(diffs);
+      call.resultHash = qHash(call.inputs.last());
+      capture_write(call);
+    }
+    return diffs;
+  }
+
+  // Set a deadline by which time the diff must be complete.
+  clock_t deadline;
+  if (Diff_Timeout <= 0) {
+    deadline = std::numeric_limits<clock_t>::max();
+  } else {
+    deadline = clock() + (clock_t)(Diff_Timeout * CLOCKS_PER_SEC);
+  }
+  return diff_main(text1, text2, checklines, deadline);
+}
+
+QList<Diff> diff_match_patch::diff_main(const QString &text1,
+    const QString &text2, bool checklines, clock_t deadline) {
+  // Check for null inputs.
+  if (text1.isNull() || text2.isNull()) {
+    throw "Null inputs. (diff_main)";
+  }
+
+  // Check for equality (speedup).
+  QList<Diff> diffs;
+  if (text1 == text2) {
+    if (!text1.isEmpty()) {
+      diffs.append(Diff(EQUAL, text1));
+    }
+    return diffs;
+  }
+
+  // Trim off common prefix (speedup).
+  int commonlength = diff_commonPrefix(text1, text2);
+  const QString &commonprefix = text1.left(commonlength);
+  QString textChopped1 = text1.mid(commonlength);
+  QString textChopped2 = text2.mid(commonlength);
+
+  // Trim off common suffix (speedup).
+  commonlength = diff_commonSuffix(textChopped1, textChopped2);
+  const QString &commonsuffix = textChopped1.right(commonlength);
+  textChopped1 = textChopped1.left(textChopped1.length() - commonlength);
+  textChopped2 = textChopped2.left(textChopped2.length() - commonlength);
+
+  // Compute the diff on the middle block.
+  diffs = diff_compute(textChopped1, textChopped2, checklines, deadline);
+
+  // Restore the prefix and suffix.
+  if (!commonprefix.isEmpty()) {
+    diffs.prepend(Diff(EQUAL, commonprefix));
+  }
+  if (!commonsuffix.isEmpty()) {
+    diffs.append(Diff(EQUAL, commonsuffix));
+  }
+
+  diff_cleanupMerge(diffs);
+
+  return diffs;
+}
+
+
+bool diff_match_patch::diff_bounded(const QString &text1,
+    const QString &text2, int maxEdits, QList<Diff> &diffs) {
+  // Check for null inputs.
+  if (text1.isNull() || text2.isNull()) {
+    throw "Null inputs. (diff_bounded)";
+  }
+
+  diffs.clear();
+  // The difference in length alone needs that many edits.
+  if (maxEdits < 0 || qAbs(text1.length() - text2.length()) > maxEdits) {
+    return false;
+  }
+  QList<Diff> result;
+  if (!diff_boundedMain(text1, text2, maxEdits,
+                        std::numeric_limits<clock_t>::max(), result)) {
+    return false;
+  }
+  diff_cleanupMerge(result);
+  diffs = result;
+  return true;
+}
+
+
+QList<Diff> diff_match_patch::diff_chunked(const ChunkTree &tree1,
+                                           const ChunkTree &tree2) {
+  // Set a deadline by which time the diff must be complete.
+  clock_t deadline;
+  if (Diff_Timeout <= 0) {
+    deadline = std::numeric_limits<clock_t>::max();
+  } else {
+    deadline = clock() + (clock_t)(Diff_Timeout * CLOCKS_PER_SEC);
+  }
+
+  const QString &text1 = tree1.text();
+  const QString &text2 = tree2.text();
+  QList<Diff> diffs;
+  int pointer = 0;
+  foreach(const DiffHunk &region, tree1.changes(tree2)) {
+    if (region.start1 > pointer) {
+      diffs.append(Diff(EQUAL, text1.mid(pointer, region.start1 - pointer)));
+    }
+    diffs += diff_main(safeMid(text1, region.start1, region.length1),
+                       safeMid(text2, region.start2, region.length2),
+                       true, deadline);
+    pointer = region.start1 + region.length1;
+  }
+  if (pointer < text1.length()) {
+    diffs.append(Diff(EQUAL, text1.mid(pointer)));
+  }
+  diff_cleanupMerge(diffs);
+  return diffs;
+}
+
+// Bounded lock-free queue between two stages of diff_pipeline, for one
+// producer and one consumer.  Each index is written by one side only and
+// published with release ordering; a stage which finds the queue full or
+// empty yields and looks again.
+template <class T>
+class PipelineQueue {
+ public:
+  explicit PipelineQueue(int capacity) :
+    size(capacity + 1), slots(new T[capacity + 1]), head(0), tail(0),
+    producerTail(0), consumerHead(0) {
+  }
+
+  ~PipelineQueue() {
+    delete [] slots;
+  }
+
+  void push(const T &item) {
+    const int next = (producerTail + 1) % size;
+    while (next == head.fetchAndAddAcquire(0)) {
+      QThread::yieldCurrentThread();
+    }
+    slots[producerTail] = item;
+    producerTail = next;
+    tail.fetchAndStoreRelease(next);
+  }
+
+  T pop() {
+    while (consumerHead == tail.fetchAndAddAcquire(0)) {
+      QThread::yieldCurrentThread();
+    }
+    T item = slots[consumerHead];
+    slots[consumerHead] = T();
+    consumerHead = (consumerHead + 1) % size;
+    head.fetchAndStoreRelease(consumerHead);
+    return item;
+  }
+
+ private:
+  PipelineQueue(const PipelineQueue &);
+  PipelineQueue &operator=(const PipelineQueue &);
+
+  // One slot is always left empty, to tell a full queue from an empty one.
+  const int size;
+  T *slots;
+  QAtomicInt head;  // Next slot to pop; written by the consumer.
+  QAtomicInt tail;  // Next slot to push; written by the producer.
+  int producerTail;  // The producer's own copy of tail.
+  int consumerHead;  // The consumer's own copy of head.
+};
+
+
+// Lines decoded from one of the inputs of diff_pipeline.  The last batch of
+// each input is marked, and may be empty.
+struct PipelineBatch {
+  int input;
+  QStringList lines;
+  bool last;
+};
+
+
+// Reader stage of diff_pipeline: decodes both inputs into lines, one after
+// the other.  It has a thread of its own rather than one of the pool, so
+// that a caller on a busy pool cannot wait on a reader which never starts.
+class PipelineReader : public QThread {
+ public:
+  PipelineReader(QIODevice &input1, QIODevice &input2,
+                 PipelineQueue<PipelineBatch> &queue) : queue(queue) {
+    inputs[0] = &input1;
+    inputs[1] = &input2;
+  }
+
+ protected:
+  void run() {
+    for (int t = 0; t < 2; t++) {
+      QByteArray pending;
+      while (!inputs[t]->atEnd()) {
+        const QByteArray block = inputs[t]->read(PIPELINE_READ_SIZE);
+        if (block.isEmpty()) {
+          break;
+        }
+        pending += block;
+        // A newline byte never occurs inside a UTF-8 sequence, so whole
+        // lines can be decoded on their own.
+        const int end = pending.lastIndexOf('\n');
+        if (end != -1) {
+          push(t, QString::fromUtf8(pending.constData(), end + 1), false);
+          pending = pending.mid(end + 1);
+        }
+      }
+      push(t, QString::fromUtf8(pending.constData(), pending.size()), true);
+    }
+  }
+
+ private:
+  void push(int input, const QString &text, bool last) {
+    PipelineBatch batch;
+    batch.input = input;
+    batch.last = last;
+    int lineStart = 0;
+    while (lineStart < text.length()) {
+      int lineEnd = text.indexOf('\n', lineStart);
+      if (lineEnd == -1) {
+        lineEnd = text.length() - 1;
+      }
+      batch.lines.append(text.mid(lineStart, lineEnd + 1 - lineStart));
+      lineStart = lineEnd + 1;
+    }
+    queue.push(batch);
+  }
+
+  QIODevice *inputs[2];
+  PipelineQueue<PipelineBatch> &queue;
+};
+
+
+// Rediff stage of diff_pipeline: one replacement block, rediffed character
+// by character on the thread pool.  Blocks that need no rediff are
+// finished when they are made.
+class PipelineBlock : public QRunnable {
+ public:
+  explicit PipelineBlock(const QList<Diff> &diffs) : diffs(diffs) {
+    setAutoDelete(false);
+    done.release();
+  }
+
+  PipelineBlock(const diff_match_patch &dmp, const QString &text1,
+                const QString &text2) : dmp(dmp), text1(text1), text2(text2) {
+    setAutoDelete(false);
+  }
+
+  void run() {
+    diffs = dmp.diff_main(text1, text2, false);
+    done.release();
+  }
+
+  QList<Diff> diffs;
+  QSemaphore done;
+
+ private:
+  diff_match_patch dmp;
+  QString text1;
+  QString text2;
+};
+
+
+QList<Diff> diff_match_patch::diff_pipeline(QIODevice &input1,
+    QIODevice &input2, QTextStream &delta) {
+  // Tokenize lines as the reader decodes them.
+  PipelineQueue<PipelineBatch> queue(PIPELINE_QUEUE_SIZE);
+  PipelineReader reader(input1, input2, queue);
+  reader.start();
+  QStringList lineArray;
+  QMap<QString, int> lineHash;
+  lineArray.append("");
+  QString chars[2] = {QString(""), QString("")};
+  // The texts themselves, once there are too many unique lines for tokens.
+  bool untokenized = false;
+  QString texts[2] = {QString(""), QString("")};
+  int finished = 0;
+  while (finished < 2) {
+    const PipelineBatch batch = queue.pop();
+    foreach(const QString &line, batch.lines) {
+      if (untokenized) {
+        texts[batch.input] += line;
+        continue;
+      }
+      int token = lineHash.value(line, -1);
+      if (token == -1) {
+        if (lineArray.size() > 0xFFFF) {
+          // Tokens are 16 bits.  Turn what was read back into text and read
+          // the rest as it is.
+          untokenized = true;
+          for (int t = 0; t < 2; t++) {
+            for (int i = 0; i < chars[t].length(); i++) {
+              texts[t] += lineArray.at(chars[t][i].unicode());
+            }
+            chars[t].clear();
+          }
+          lineHash.clear();
+          lineArray.clear();
+          texts[batch.input] += line;
+          continue;
+        }
+        lineArray.append(line);
+        token = lineArray.size() - 1;
+        lineHash.insert(line, token);
+      }
+      chars[batch.input] += QChar(static_cast<ushort>(token));
+    }
+    if (batch.last) {
+      finished++;
+    }
+  }
+  reader.wait();
+  lineHash.clear();
+
+  // The timeout covers the diff, not the reading.  clock() counts the time
+  // of every thread, and the reader has finished, so start it only now.
+  clock_t deadline;
+  if (Diff_Timeout <= 0) {
+    deadline = std::numeric_limits<clock_t>::max();
+  } else {
+    deadline = clock() + (clock_t)(Diff_Timeout * CLOCKS_PER_SEC);
+  }
+  if (untokenized) {
+    // A character diff of the whole texts, written out at the end.
+    QList<Diff> diffs = diff_main(texts[0], texts[1], false, deadline);
+    delta << diff_toDelta(diffs);
+    return diffs;
+  }
+
+  QList<Diff> lineDiffs = diff_main(chars[0], chars[1], false, deadline);
+  diff_cleanupSemanticTokens(lineDiffs, lineArray);
+  diff_charsToLines(lineDiffs, lineArray);
+  lineArray.clear();
+
+  // Rediff the replacement blocks on the thread pool, at most a few blocks
+  // ahead of the collector.  Each rediff is a diff_main with a timeout of
+  // its own, as in diff_lineMode.  Each block is one task, so the diffs
+  // within it run serially and never wait on tasks queued behind them.
+  diff_match_patch rediffer = *this;
+  rediffer.Capture_File.clear();
+  rediffer.Diff_Threads = 1;
+  rediffer.Match_Threads = 1;
+  const int window = 2 * QThread::idealThreadCount();
+  QQueue<PipelineBlock *> blocks;
+  QList<Diff> diffs;
+  lineDiffs.append(Diff(EQUAL, ""));  // Dummy entry at the end.
+  QString text_delete = "";
+  QString text_insert = "";
+  for (int x = 0; x < lineDiffs.size(); x++) {
+    const Diff &lineDiff = lineDiffs.at(x);
+    if (lineDiff.operation == DELETE) {
+      text_delete += lineDiff.text;
+      continue;
+    } else if (lineDiff.operation == INSERT) {
+      text_insert += lineDiff.text;
+      continue;
+    }
+    // Upon reaching an equality, queue the changes before it and then it.
+    if (!text_delete.isEmpty() && !text_insert.isEmpty()) {
+      PipelineBlock *block = new PipelineBlock(rediffer, text_delete,
+                                               text_insert);
+      QThreadPool::globalInstance()->start(block);
+      blocks.enqueue(block);
+    } else if (!text_delete.isEmpty()) {
+      blocks.enqueue(new PipelineBlock(QList<Diff>()
+                                       << Diff(DELETE, text_delete)));
+    } else if (!text_insert.isEmpty()) {
+      blocks.enqueue(new PipelineBlock(QList<Diff>()
+                                       << Diff(INSERT, text_insert)));
+    }
+    if (!lineDiff.text.isEmpty()) {
+      blocks.enqueue(new PipelineBlock(QList<Diff>() << lineDiff));
+    }
+    text_delete = "";
+    text_insert = "";
+
+    // Collect finished blocks in order.
+    while (!blocks.isEmpty() && (blocks.size() > window
+        || x == lineDiffs.size() - 1)) {
+      PipelineBlock *block = blocks.dequeue();
+      block->done.acquire();
+      diffs += block->diffs;
+      delete block;
+    }
+  }
+  // Edits may shift across the edges of blocks, as in diff_main, so the
+  // delta is only written once the whole diff is merged.
+  diff_cleanupMerge(diffs);
+  delta << diff_toDelta(diffs);
+  return diffs;
+}
+
+
+// Diff of the base against one variant, for diff_align.  Variants which
+// were tokenized are diffed line by line against the shared table.  The
+// timeout of each variant counts from the start of its own diff, not from
+// the time it spent queued behind the others.
+class AlignVariant : public QRunnable {
+ public:
+  AlignVariant(const diff_match_patch &dmp, const QString &text1,
+               const QString &text2) :
+    dmp(dmp), text1(text1), text2(text2), lineArray(NULL) {
+    setAutoDelete(false);
+  }
+
+  void run() {
+    clock_t deadline;
+    if (dmp.Diff_Timeout <= 0) {
+      deadline = std::numeric_limits<clock_t>::max();
+    } else {
+      deadline = clock() + (clock_t)(dmp.Diff_Timeout * CLOCKS_PER_SEC);
+    }
+    if (lineArray != NULL) {
+      diffs = dmp.diff_lineModeTokens(chars1, chars2, *lineArray, deadline);
+      dmp.diff_cleanupMerge(diffs);
+    } else {
+      diffs = dmp.diff_main(text1, text2, true, deadline);
+    }
+    done.release();
+  }
+
+  QString chars1;
+  QString chars2;
+  const QStringList *lineArray;
+  QList<Diff> diffs;
+  QSemaphore done;
+
+ private:
+  diff_match_patch dmp;
+  QString text1;
+  QString text2;
+};
+
+
+QList<AlignedRow> diff_match_patch::diff_align(const QString &base,
+    const QStringList &variants) {
+  // Check for null inputs.
+  if (base.isNull()) {
+    throw "Null inputs. (diff_align)";
+  }
+  foreach(const QString &variant, variants) {
+    if (variant.isNull()) {
+      throw "Null inputs. (diff_align)";
+    }
+  }
+
+  // Tokenize the base once, and the variants which want a line-level pass
+  // against the same table.  Tokenizing shares the table, so it stays on
+  // this thread.
+  // Each variant is diffed by a single task; a worker that split its diff
+  // over the pool would wait on the very tasks it holds a thread from.
+  diff_match_patch worker = *this;
+  worker.Capture_File.clear();
+  worker.Diff_Threads = 1;
+  worker.Match_Threads = 1;
+  QStringList lineArray;
+  QMap<QString, int> lineHash;
+  // "\x00" is a valid character, but various debuggers don't like it.
+  // So we'll insert a junk entry to avoid generating a null character.
+  lineArray.append("");
+  QString baseChars;
+  QList<AlignVariant *> jobs;
+  try {
+    foreach(const QString &variant, variants) {
+      jobs.append(new AlignVariant(worker, base, variant));
+      AlignVariant *job = jobs.last();
+      if (base != variant && diff_useLineMode(base, variant)) {
+        if (baseChars.isNull()) {
+          baseChars = diff_linesToCharsMunge(base, lineArray, lineHash);
+        }
+        job->chars1 = baseChars;
+        job->chars2 = diff_linesToCharsMunge(variant, lineArray, lineHash);
+        job->lineArray = &lineArray;
+      }
+    }
+  } catch (...) {
+    // None of the jobs has started yet.
+    foreach(AlignVariant *job, jobs) {
+      delete job;
+    }
+    throw;
+  }
+  lineHash.clear();
+  foreach(AlignVariant *job, jobs) {
+    if (lineArray.size() > 0xFFFF) {
+      // Too many distinct lines for the tokens; each variant gets a diff of
+      // its own.
+      job->lineArray = NULL;
+    }
+    QThreadPool::globalInstance()->start(job);
+  }
+
+  // Sweep over the base, cutting a row wherever any of the edit scripts
+  // moves on to its next diff.
+  const int count = jobs.size();
+  QVector<int> current(count, 0);
+  QVector<int> offset(count, 0);
+  foreach(AlignVariant *job, jobs) {
+    job->done.acquire();
+  }
+  QList<AlignedRow> rows;
+  int pos = 0;
+  while (true) {
+    // Insertions at this point of the base share a row.
+    AlignedRow row;
+    row.start = pos;
+    row.changed = QVector<bool>(count, false);
+    for (int x = 0; x < count; x++) {
+      const QList<Diff> &diffs = jobs[x]->diffs;
+      row.variants.append("");
+      if (current[x] < diffs.size()
+          && diffs[current[x]].operation == INSERT) {
+        row.variants[x] = diffs[current[x]].text;
+        row.changed[x] = true;
+        current[x]++;
+      }
+    }
+    if (row.isChanged()) {
+      rows.append(row);
+    }
+    if (pos == base.length()) {
+      break;
+    }
+
+    int end = base.length();
+    for (int x = 0; x < count; x++) {
+      const QList<Diff> &diffs = jobs[x]->diffs;
+      end = std::min(end, pos + diffs[current[x]].text.length() - offset[x]);
+    }
+    row.base = safeMid(base, pos, end - pos);
+    for (int x = 0; x < count; x++) {
+      const QList<Diff> &diffs = jobs[x]->diffs;
+      const Diff &aDiff = diffs[current[x]];
+      if (aDiff.operation == EQUAL) {
+        row.variants[x] = row.base;
+        row.changed[x] = false;
+      } else {
+        row.variants[x] = "";
+        row.changed[x] = true;
+      }
+      offset[x] += end - pos;
+      if (offset[x] == aDiff.text.length()) {
+        offset[x] = 0;
+        current[x]++;
+        // A replacement ends on the row of the last of its deletion.
+        if (aDiff.operation == DELETE && current[x] < diffs.size()
+            && diffs[current[x]].operation == INSERT) {
+          row.variants[x] = diffs[current[x]].text;
+          current[x]++;
+        }
+      }
+    }
+    rows.append(row);
+    pos = end;
+  }
+  foreach(AlignVariant *job, jobs) {
+    delete job;
+  }
+  return rows;
+}
+
+
+bool diff_match_patch::diff_boundedMain(const QString &text1,
+    const QString &text2, int maxEdits, clock_t deadline, QList<Diff> &diffs) {
+  // Trim off common prefix and suffix.
+  const int prefixLength = diff_commonPrefix(text1, text2);
+  QString textChopped1 = safeMid(text1, prefixLength);
+  QString textChopped2 = safeMid(text2, prefixLength);
+  const int suffixLength = diff_commonSuffix(textChopped1, textChopped2);
+  textChopped1 = textChopped1.left(textChopped1.length() - suffixLength);
+  textChopped2 = textChopped2.left(textChopped2.length() - suffixLength);
+  const int length1 = textChopped1.length();
+  const int length2 = textChopped2.length();
+
+  QList<Diff> middle;
+  if (length1 == 0 || length2 == 0) {
+    if (length1 + length2 > maxEdits) {
+      return false;
+    }
+    if (length1 != 0) {
+      middle.append(Diff(DELETE, textChopped1));
+    } else if (length2 != 0) {
+      middle.append(Diff(INSERT, textChopped2));
+    }
+  } else if (qAbs(length1 - length2) > maxEdits) {
+    return false;
+  } else {
+    // A snake found after d forward steps
+    // costs 2d-1 or 2d edits, so only walk as far as the budget reaches.
+    const int max_d = (length1 + length2 + 1) / 2;
+    const int steps = std::min(max_d, (maxEdits + 1) / 2 + 1);
+    int x, y;
+    const int edits = diff_bisectSnake(textChopped1, textChopped2, steps,
+                                       deadline, x, y);
+    if (edits == -1) {
+      if (steps < max_d || length1 + length2 > maxEdits
+          || clock() > deadline) {
+        return false;
+      }
+      // The paths never met, so the texts have nothing in common and
+      // replacing everything is the minimal diff.
+      middle.append(Diff(DELETE, textChopped1));
+      middle.append(Diff(INSERT, textChopped2));
+    } else if (edits > maxEdits) {
+      return false;
+    } else if (!diff_boundedMain(textChopped1.left(x), textChopped2.left(y),
+                                 edits, deadline, middle)
+        || !diff_boundedMain(safeMid(textChopped1, x), safeMid(textChopped2, y),
+                             edits, deadline, middle)) {
+      // Both halves lie on a minimal path, so neither exceeds the total.
+      return false;
+    }
+  }
+
+  if (prefixLength != 0) {
+    diffs.append(Diff(EQUAL, text1.left(prefixLength)));
+  }
+  diffs += middle;
+  if (suffixLength != 0) {
+    diffs.append(Diff(EQUAL, text1.right(suffixLength)));
+  }
+  return true;
+}
+
+
+QList<Diff> diff_match_patch::diff_compute(QString text1, QString text2,
+    bool checklines, clock_t deadline) {
+  QList<Diff> diffs;
+
+  if (text1.isEmpty()) {
+    // Just add some text (speedup).
+    diffs.append(Diff(INSERT, text2));
+    return diffs;
+  }
+
+  if (text2.isEmpty()) {
+    // Just delete some text (speedup).
+    diffs.append(Diff(DELETE, text1));
+    return diffs;
+  }
+
+  {
+    const QString longtext = text1.length() > text2.length() ? text1 : text2;
+    const QString shorttext = text1.length() > text2.length() ? text2 : text1;
+    const int i = longtext.indexOf(shorttext);
+    if (i != -1) {
+      // Shorter text is inside the longer text (speedup).
+      const Operation op = (text1.length() > text2.length()) ? DELETE : INSERT;
+      diffs.append(Diff(op, longtext.left(i)));
+      diffs.append(Diff(EQUAL, shorttext));
+      diffs.append(Diff(op, safeMid(longtext, i + shorttext.length())));
+      return diffs;
+    }
+
+    if (shorttext.length() == 1) {
+      // Single character string.
+      // After the previous speedup, the character can't be an equality.
+      diffs.append(Diff(DELETE, text1));
+      diffs.append(Diff(INSERT, text2));
+      return diffs;
+    }
+    // Garbage collect longtext and shorttext by scoping out.
+  }
+
+  // Check to see if the problem can be split in two.
+  const QStringList hm = diff_halfMatch(text1, text2);
+  if (hm.count() > 0) {
+    // A half-match was found, sort out the return data.
+    const QString text1_a = hm[0];
+    const QString text1_b = hm[1];
+    const QString text2_a = hm[2];
+    const QString text2_b = hm[3];
+    const QString mid_common = hm[4];
+    // Send both pairs off for separate processing.
+    const QList<Diff> diffs_a = diff_main(text1_a, text2_a,
+                                          checklines, deadline);
+    const QList<Diff> diffs_b = diff_main(text1_b, text2_b,
+                                          checklines, deadline);
+    // Merge the results.
+    diffs = diffs_a;
+    diffs.append(Diff(EQUAL, mid_common));
+    diffs += diffs_b;
+    return diffs;
+  }
+
+  // Perform a real diff.
+  if (checklines && diff_useLineMode(text1, text2)) {
+    return diff_lineMode(text1, text2, deadline);
+  }
+
+  return diff_bisect(text1, text2, deadline);
+}
+
+
+bool diff_match_patch::diff_useLineMode(const QString &text1,
+                                        const QString &text2) {
+  if (text1.length() <= Diff_LineModeThreshold
+      || text2.length() <= Diff_LineModeThreshold) {
+    return false;
+  }
+  if (Diff_TokenCost <= 0 || Diff_BisectCost <= 0) {
+    // No cost model, any texts over the threshold get a line-level pass.
+    return true;
+  }
+
+  const DiffFeatures features = diff_features(text1, text2);
+  // Assume that edits are spread through the texts like the unique lines.
+  const double edits = features.uniqueLineRatio
+      * (features.length1 + features.length2);
+  return diff_strategyCost(STRATEGY_LINEMODE, features, edits,
+                           features.avgLineLength)
+      < diff_strategyCost(STRATEGY_BISECT, features, edits, 0);
+}
+
+
+double diff_match_patch::diff_strategyCost(Strategy strategy,
+    const DiffFeatures &features, double edits, double blockLength) {
+  const double tokenCost = Diff_TokenCost > 0
+      ? Diff_TokenCost : DEFAULT_TOKEN_COST;
+  const double bisectCost = Diff_BisectCost > 0
+      ? Diff_BisectCost : DEFAULT_BISECT_COST;
+  const double chars = features.length1 + features.length2;
+  const double lines = features.lines1 + features.lines2;
+  const double charEdits = std::max(1.0, edits);
+  switch (strategy) {
+    case STRATEGY_BISECT:
+      // Myers is O(ND) on the characters.
+      return bisectCost * chars * charEdits;
+    case STRATEGY_LINEMODE: {
+      // Line mode tokenizes, runs Myers on the tokens, then rediffs the
+      // changed blocks.
+      const double lineEdits = chars > 0
+          ? std::max(1.0, charEdits * lines / chars) : 1.0;
+      return tokenCost * chars + bisectCost * lines * lineEdits
+          + bisectCost * charEdits * blockLength;
+    }
+    default:
+      return 0.0;
+  }
+}
+
+
+QList<Diff> diff_match_patch::diff_lineMode(QString text1, QString text2,
+    clock_t deadline) {
+  // Scan the text on a line-by-line basis first.
+  const QList<QVariant> b = diff_linesToChars(text1, text2);
+  return diff_lineModeTokens(b[0].toString(), b[1].toString(),
+                             b[2].toStringList(), deadline);
+}
+
+
+QList<Diff> diff_match_patch::diff_lineModeTokens(const QString &chars1,
+    const QString &chars2, const QStringList &linearray, clock_t deadline) {
+  QList<Diff> diffs = diff_main(chars1, chars2, false, deadline);
+
+  // Eliminate freak matches (e.g. blank lines) while the lines are still
+  // tokens, then convert the diff back to original text.
+  diff_cleanupSemanticTokens(diffs, linearray);
+  diff_charsToLines(diffs, linearray);
+
+  // Rediff any replacement blocks, this time character-by-character.
+  // Add a dummy entry at the end.
+  diffs.append(Diff(EQUAL, ""));
+  int count_delete = 0;
+  int count_insert = 0;
+  QString text_delete = "";
+  QString text_insert = "";
+
+  QMutableListIterator<Diff> pointer(diffs);
+  Diff *thisDiff = pointer.hasNext() ? &pointer.next() : NULL;
+  while (thisDiff != NULL) {
+    switch (thisDiff->operation) {
+      case INSERT:
+        count_insert++;
+        text_insert += thisDiff->text;
+        break;
+      case DELETE:
+        count_delete++;
+        text_delete += thisDiff->text;
+        break;
+      case EQUAL:
+        // Upon reaching an equality, check for prior redundancies.
+        if (count_delete >= 1 && count_insert >= 1) {
+          // Delete the offending records and add the merged ones.
+          pointer.previous();
+          for (int j = 0; j < count_delete + count_insert; j++) {
+            pointer.previous();
+            pointer.remove();
+          }
+          foreach(const Diff &newDiff,
+              diff_main(text_delete, text_insert, false, deadline)) {
+            pointer.insert(newDiff);
+          }
+        }
+        count_insert = 0;
+        count_delete = 0;
+        text_delete = "";
+        text_insert = "";
+        break;
+    }
+    thisDiff = pointer.hasNext() ? &pointer.next() : NULL;
+  }
+  diffs.removeLast();  // Remove the dummy entry at the end.
+
+  return diffs;
+}
+
+
+QList<Diff> diff_match_patch::diff_records(const QString &text1,
+                                           const QString &text2) {
+  return diff_records(text1, text2, "\n", QRegExp("^([^,]*)"), ",");
+}
+
+
+QList<Diff> diff_match_patch::diff_records(const QString &text1,
+    const QString &text2, const QString &separator, const QRegExp &keyPattern,
+    const QString &fieldSeparator) {
+  // Check for null inputs.
+  if (text1.isNull() || text2.isNull()) {
+    throw "Null inputs. (diff_records)";
+  }
+  if (separator.isEmpty()) {
+    throw "Empty record separator. (diff_records)";
+  }
+
+  // Split both texts into records, noting whether the last one is ended.
+  QStringList records[2];
+  QStringList keys[2];
+  bool trailing[2];
+  const QString *texts[2] = {&text1, &text2};
+  QRegExp keyFinder = keyPattern;
+  for (int t = 0; t < 2; t++) {
+    trailing[t] = texts[t]->endsWith(separator);
+    if (!texts[t]->isEmpty()) {
+      records[t] = texts[t]->split(separator);
+    }
+    if (trailing[t]) {
+      records[t].removeLast();
+    }
+    foreach(const QString &record, records[t]) {
+      if (keyFinder.indexIn(record) == -1) {
+        keys[t].append(record);
+      } else {
+        keys[t].append(keyFinder.cap(keyFinder.numCaptures() > 0 ? 1 : 0));
+      }
+    }
+  }
+
+  // Hash join on the key.  Records with a duplicate key pair up with an
+  // identical record if there is one, otherwise in order of appearance.
+  QHash<QString, QList<int> > index1;
+  for (int x = 0; x < records[0].size(); x++) {
+    index1[keys[0][x]].append(x);
+  }
+  QVector<int> match2(records[1].size(), -1);
+  for (int y = 0; y < records[1].size(); y++) {
+    QHash<QString, QList<int> >::iterator candidates = index1.find(keys[1][y]);
+    if (candidates != index1.end() && !candidates.value().isEmpty()) {
+      QList<int> &unmatched = candidates.value();
+      int pick = 0;
+      for (int z = 0; z < unmatched.size(); z++) {
+        if (records[0][unmatched[z]] == records[1][y]) {
+          pick = z;
+          break;
+        }
+      }
+      match2[y] = unmatched.takeAt(pick);
+    }
+  }
+
+  // Pairs which are in the same order in both texts stay in place: the
+  // longest increasing run of old indices, in the order of text2, found by
+  // patience sorting.  The other pairs have moved, and are deleted where
+  // they were and inserted where they are.
+  QVector<int> tails;  // Last pair of the best run of each length.
+  QVector<int> previous(records[1].size(), -1);
+  for (int y = 0; y < records[1].size(); y++) {
+    if (match2[y] == -1) {
+      continue;
+    }
+    int low = 0;
+    int high = tails.size();
+    while (low < high) {
+      const int mid = (low + high) / 2;
+      if (match2[tails[mid]] < match2[y]) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    previous[y] = low > 0 ? tails[low - 1] : -1;
+    if (low == tails.size()) {
+      tails.append(y);
+    } else {
+      tails[low] = y;
+    }
+  }
+  QVector<int> kept1(records[0].size(), -1);
+  QVector<bool> kept2(records[1].size(), false);
+  for (int y = tails.isEmpty() ? -1 : tails.last(); y != -1; y = previous[y]) {
+    kept1[match2[y]] = y;
+    kept2[y] = true;
+  }
+
+  // Lay out the records in the order of both texts: pairs of (old, new)
+  // indices, -1 where a record is only in one of them.
+  QList<QPair<int, int> > layout;
+  int x = 0;
+  int y = 0;
+  while (x < records[0].size() || y < records[1].size()) {
+    if (x < records[0].size() && kept1[x] == -1) {
+      layout.append(qMakePair(x++, -1));
+    } else if (y < records[1].size() && !kept2[y]) {
+      layout.append(qMakePair(-1, y++));
+    } else {
+      layout.append(qMakePair(x++, y++));
+    }
+  }
+
+  // Each record is followed by a separator in a text unless it is the last
+  // record of that text which was not ended.
+  int remaining1 = records[0].size();
+  int remaining2 = records[1].size();
+  QList<Diff> diffs;
+  typedef QPair<int, int> Pairing;
+  foreach(Pairing pairing, layout) {
+    bool separator1 = false;
+    bool separator2 = false;
+    if (pairing.first != -1) {
+      separator1 = --remaining1 > 0 || trailing[0];
+    }
+    if (pairing.second != -1) {
+      separator2 = --remaining2 > 0 || trailing[1];
+    }
+    if (pairing.second == -1) {
+      diffs.append(Diff(DELETE, records[0][pairing.first]));
+    } else if (pairing.first == -1) {
+      diffs.append(Diff(INSERT, records[1][pairing.second]));
+    } else {
+      diffs += diff_recordFields(records[0][pairing.first],
+                                 records[1][pairing.second], fieldSeparator);
+    }
+    if (separator1 && separator2) {
+      diffs.append(Diff(EQUAL, separator));
+    } else if (separator1) {
+      diffs.append(Diff(DELETE, separator));
+    } else if (separator2) {
+      diffs.append(Diff(INSERT, separator));
+    }
+  }
+  diff_cleanupMerge(diffs);
+  return diffs;
+}
+
+
+QList<Diff> diff_match_patch::diff_recordFields(const QString &record1,
+    const QString &record2, const QString &fieldSeparator) {
+  QList<Diff> diffs;
+  if (record1 == record2) {
+    diffs.append(Diff(EQUAL, record1));
+    return diffs;
+  }
+  if (fieldSeparator.isEmpty()) {
+    return diff_main(record1, record2, false);
+  }
+  const QStringList fields1 = record1.split(fieldSeparator);
+  const QStringList fields2 = record2.split(fieldSeparator);
+  if (fields1.size() != fields2.size()) {
+    return diff_main(record1, record2, false);
+  }
+  for (int x = 0; x < fields1.size(); x++) {
+    if (x != 0) {
+      diffs.append(Diff(EQUAL, fieldSeparator));
+    }
+    diffs += diff_main(fields1[x], fields2[x], false);
+  }
+  return diffs;
+}
+
+
+QList<Diff> diff_match_patch::diff_bisect(const QString &text1,
+    const QString &text2, clock_t deadline) {
+  const int max_d = (text1.length() + text2.length() + 1) / 2;
+  int x, y;
+  if (diff_bisectSnake(text1, text2, max_d, deadline, x, y) != -1) {
+    return diff_bisectSplit(text1, text2, x, y, deadline);
+  }
+  // Diff took too long and hit the deadline or
+  // number of diffs equals number of characters, no commonality at all.
+  QList<Diff> diffs;
+  diffs.append(Diff(DELETE, text1));
+  diffs.append(Diff(INSERT, text2));
+  return diffs;
+}
+
+
+int diff_match_patch::diff_bisectSnake(const QString &text1,
+    const QString &text2, int maxSteps, clock_t deadline, int &x, int &y) {
+  int steps;
+  const int edits = DiffCore::bisectSnake(coreChars(text1), text1.length(),
+      coreChars(text2), text2.length(), maxSteps, deadline, x, y, steps);
+  // Step d explores 2d + 1 diagonals.
+  DMP_WORK(WORK_BISECT, static_cast<quint64>(steps) * steps);
+  return edits;
+}
+
+QList<Diff> diff_match_patch::diff_bisectSplit(const QString &text1,
+    const QString &text2, int x, int y, clock_t deadline) {
+  QString text1a = text1.left(x);
+  QString text2a = text2.left(y);
+  QString text1b = safeMid(text1, x);
+  QString text2b = safeMid(text2, y);
+
+  // Compute both diffs serially.
+  QList<Diff> diffs = diff_main(text1a, text2a, false, deadline);
+  QList<Diff> diffsb = diff_main(text1b, text2b, false, deadline);
+
+  return diffs + diffsb;
+}
+
+QList<QVariant> diff_match_patch::diff_linesToChars(const QString &text1,
+                                                    const QString &text2) {
+  const int threads = Diff_Threads > 0 ? Diff_Threads
+      : QThread::idealThreadCount();
+  if (threads > 1
+      && text1.length() + text2.length() >= 2 * TOKENIZE_CHUNK_MIN) {
+    return diff_linesToCharsParallel(text1, text2, threads);
+  }
+
+  QStringList lineArray;
+  QMap<QString, int> lineHash;
+  // e.g. linearray[4] == "Hello\n"
+  // e.g. linehash.get("Hello\n") == 4
+
+  // "\x00" is a valid character, but various debuggers don't like it.
+  // So we'll insert a junk entry to avoid generating a null character.
+  lineArray.append("");
+
+  const QString chars1 = diff_linesToCharsMunge(text1, lineArray, lineHash);
+  const QString chars2 = diff_linesToCharsMunge(text2, lineArray, lineHash);
+
+  QList<QVariant> listRet;
   listRet.append(QVariant::fromValue(chars1));
   listRet.append(QVariant::fromValue(chars2));
   listRet.append(QVariant::fromValue(lineArray));
@@ -530,10 +3321,14 @@ QString diff_match_patch::diff_linesToCharsMunge(const QString &text,
   // Walk the text, pulling out a substring for each line.
   // text.split('\n') would would temporarily double our memory footprint.
   // Modifying text would create many large strings to garbage collect.
+  const CoreChar *units = coreChars(text);
   while (lineEnd < text.length() - 1) {
-    lineEnd = text.indexOf('\n', lineStart);
+    lineEnd = DiffCore::indexOf(units + lineStart, text.length() - lineStart,
+                                '\n');
     if (lineEnd == -1) {
       lineEnd = text.length() - 1;
+    } else {
+      lineEnd += lineStart;
     }
     line = safeMid(text, lineStart, lineEnd + 1 - lineStart);
     lineStart = lineEnd + 1;
@@ -550,6 +3345,195 @@ QString diff_match_patch::diff_linesToCharsMunge(const QString &text,
 }
 
 
+// A run of whole lines of one text, tokenized on its own by diff_linesToChars.
+struct TokenChunk {
+  const QString *text;
+  int start;
+  int end;
+  // Unique lines in order of first occurrence, and the index in lines of
+  // each line of the chunk.
+  QStringList lines;
+  QVector<int> tokens;
+  // For each unique line, the chunk and index where it first occurs in
+  // either text.
+  QVector<int> ownerChunk;
+  QVector<int> ownerLine;
+  // For each unique line, its index in the shared line array.
+  QVector<int> ids;
+  QString chars;
+};
+
+
+// Tokenizes one chunk into its own table, or, once the shared ids are
+// known, encodes it.
+class TokenizeChunk : public QRunnable {
+ public:
+  TokenizeChunk(TokenChunk &chunk, bool encode, QSemaphore &done) :
+    chunk(chunk), encode(encode), done(done) {
+  }
+
+  void run() {
+    if (encode) {
+      chunk.chars.reserve(chunk.tokens.size());
+      foreach(int token, chunk.tokens) {
+        chunk.chars += QChar(static_cast<ushort>(chunk.ids[token]));
+      }
+    } else {
+      QHash<QString, int> lineHash;
+      int lineStart = chunk.start;
+      while (lineStart < chunk.end) {
+        int lineEnd = chunk.text->indexOf('\n', lineStart);
+        if (lineEnd == -1 || lineEnd >= chunk.end) {
+          lineEnd = chunk.end - 1;
+        }
+        const QString line = chunk.text->mid(lineStart,
+                                             lineEnd + 1 - lineStart);
+        QHash<QString, int>::const_iterator known = lineHash.constFind(line);
+        if (known != lineHash.constEnd()) {
+          chunk.tokens.append(known.value());
+        } else {
+          chunk.lines.append(line);
+          lineHash.insert(line, chunk.lines.size() - 1);
+          chunk.tokens.append(chunk.lines.size() - 1);
+        }
+        lineStart = lineEnd + 1;
+      }
+      chunk.ownerChunk.resize(chunk.lines.size());
+      chunk.ownerLine.resize(chunk.lines.size());
+      chunk.ids.resize(chunk.lines.size());
+    }
+    done.release();
+  }
+
+ private:
+  TokenChunk &chunk;
+  const bool encode;
+  QSemaphore &done;
+};
+
+
+// Finds where each line first occurs, for the lines whose hash falls in
+// one shard.  Shards own disjoint lines, so they write disjoint entries.
+class TokenizeShard : public QRunnable {
+ public:
+  TokenizeShard(TokenChunk *chunks, int chunkCount, int shard, int shards,
+                QSemaphore &done) :
+    chunks(chunks), chunkCount(chunkCount), shard(shard), shards(shards),
+    done(done) {
+  }
+
+  void run() {
+    QHash<QString, QPair<int, int> > owners;
+    for (int c = 0; c < chunkCount; c++) {
+      TokenChunk &chunk = chunks[c];
+      for (int i = 0; i < chunk.lines.size(); i++) {
+        const QString &line = chunk.lines.at(i);
+        if (static_cast<int>(qHash(line) % shards) != shard) {
+          continue;
+        }
+        QHash<QString, QPair<int, int> >::iterator owner = owners.find(line);
+        if (owner == owners.end()) {
+          owner = owners.insert(line, qMakePair(c, i));
+        }
+        chunk.ownerChunk[i] = owner.value().first;
+        chunk.ownerLine[i] = owner.value().second;
+      }
+    }
+    done.release();
+  }
+
+ private:
+  TokenChunk *chunks;
+  const int chunkCount;
+  const int shard;
+  const int shards;
+  QSemaphore &done;
+};
+
+
+QList<QVariant> diff_match_patch::diff_linesToCharsParallel(
+    const QString &text1, const QString &text2, int threads) {
+  // Cut both texts into chunks of whole lines, a few per thread.
+  const QString *texts[2] = {&text1, &text2};
+  const int chunkSize = std::max(TOKENIZE_CHUNK_MIN,
+      (text1.length() + text2.length()) / (4 * threads));
+  QVector<TokenChunk> chunks;
+  int firstChunk2 = 0;
+  for (int t = 0; t < 2; t++) {
+    int start = 0;
+    while (start < texts[t]->length()) {
+      int end = std::min(start + chunkSize, texts[t]->length());
+      if (end < texts[t]->length()) {
+        const int lineEnd = texts[t]->indexOf('\n', end - 1);
+        end = (lineEnd == -1) ? texts[t]->length() : lineEnd + 1;
+      }
+      TokenChunk chunk;
+      chunk.text = texts[t];
+      chunk.start = start;
+      chunk.end = end;
+      chunks.append(chunk);
+      start = end;
+    }
+    if (t == 0) {
+      firstChunk2 = chunks.size();
+    }
+  }
+  TokenChunk *data = chunks.data();
+  const int chunkCount = chunks.size();
+
+  // Tokenize each chunk into its own table.
+  QSemaphore done;
+  for (int c = 0; c < chunkCount; c++) {
+    QThreadPool::globalInstance()->start(
+        new TokenizeChunk(data[c], false, done));
+  }
+  done.acquire(chunkCount);
+
+  // Find the first occurrence of each line, sharded by hash.
+  for (int shard = 0; shard < threads; shard++) {
+    QThreadPool::globalInstance()->start(
+        new TokenizeShard(data, chunkCount, shard, threads, done));
+  }
+  done.acquire(threads);
+
+  // Number the lines in order of first occurrence.  A line's first
+  // occurrence always comes before its other ones, so one pass will do.
+  // "\x00" is a valid character, but various debuggers don't like it.
+  // So we'll insert a junk entry to avoid generating a null character.
+  QStringList lineArray;
+  lineArray.append("");
+  for (int c = 0; c < chunkCount; c++) {
+    TokenChunk &chunk = data[c];
+    for (int i = 0; i < chunk.lines.size(); i++) {
+      if (chunk.ownerChunk[i] == c && chunk.ownerLine[i] == i) {
+        lineArray.append(chunk.lines.at(i));
+        chunk.ids[i] = lineArray.size() - 1;
+      } else {
+        chunk.ids[i] = data[chunk.ownerChunk[i]].ids[chunk.ownerLine[i]];
+      }
+    }
+  }
+
+  // Encode the chunks with the shared numbers.
+  for (int c = 0; c < chunkCount; c++) {
+    QThreadPool::globalInstance()->start(
+        new TokenizeChunk(data[c], true, done));
+  }
+  done.acquire(chunkCount);
+  QString chars1 = "";
+  QString chars2 = "";
+  for (int c = 0; c < chunkCount; c++) {
+    (c < firstChunk2 ? chars1 : chars2) += data[c].chars;
+  }
+
+  QList<QVariant> listRet;
+  listRet.append(QVariant::fromValue(chars1));
+  listRet.append(QVariant::fromValue(chars2));
+  listRet.append(QVariant::fromValue(lineArray));
+  return listRet;
+}
+
+
 
 void diff_match_patch::diff_charsToLines(QList<Diff> &diffs,
                                          const QStringList &lineArray) {
@@ -566,73 +3550,480 @@ void diff_match_patch::diff_charsToLines(QList<Diff> &diffs,
 }
 
 
-int diff_match_patch::diff_commonPrefix(const QString &text1,
-                                        const QString &text2) {
-  // Performance analysis: http://neil.fraser.name/news/2007/10/09/
-  const int n = std::min(text1.length(), text2.length());
-  for (int i = 0; i < n; i++) {
-    if (text1[i] != text2[i]) {
-      return i;
+DiffFeatures diff_match_patch::diff_features(const QString &text1,
+                                             const QString &text2) {
+  DiffFeatures features;
+  features.length1 = text1.length();
+  features.length2 = text2.length();
+  // Number of occurrences of each line in text1 and in text2.
+  QHash<QString, QPair<int, int> > lineCounts;
+  int lineStart = 0;
+  int lineEnd = -1;
+  while (lineEnd < text1.length() - 1) {
+    lineEnd = text1.indexOf('\n', lineStart);
+    if (lineEnd == -1) {
+      lineEnd = text1.length() - 1;
+    }
+    lineCounts[safeMid(text1, lineStart, lineEnd + 1 - lineStart)].first++;
+    lineStart = lineEnd + 1;
+    features.lines1++;
+  }
+  lineStart = 0;
+  lineEnd = -1;
+  while (lineEnd < text2.length() - 1) {
+    lineEnd = text2.indexOf('\n', lineStart);
+    if (lineEnd == -1) {
+      lineEnd = text2.length() - 1;
+    }
+    lineCounts[safeMid(text2, lineStart, lineEnd + 1 - lineStart)].second++;
+    lineStart = lineEnd + 1;
+    features.lines2++;
+  }
+
+  const int lines = features.lines1 + features.lines2;
+  if (lines == 0) {
+    return features;
+  }
+  int uniqueLines = 0;
+  QHashIterator<QString, QPair<int, int> > i(lineCounts);
+  while (i.hasNext()) {
+    i.next();
+    if (i.value().first == 0 || i.value().second == 0) {
+      uniqueLines += i.value().first + i.value().second;
     }
   }
-  return n;
+  features.avgLineLength = (features.length1 + features.length2)
+      / static_cast<double>(lines);
+  features.uniqueLineRatio = uniqueLines / static_cast<double>(lines);
+  return features;
 }
 
 
-int diff_match_patch::diff_commonSuffix(const QString &text1,
-                                        const QString &text2) {
-  // Performance analysis: http://neil.fraser.name/news/2007/10/09/
-  const int text1_length = text1.length();
-  const int text2_length = text2.length();
-  const int n = std::min(text1_length, text2_length);
-  for (int i = 1; i <= n; i++) {
-    if (text1[text1_length - i] != text2[text2_length - i]) {
-      return i - 1;
+double diff_match_patch::diff_similarity(const QString &text1,
+                                         const QString &text2) {
+  if (text1 == text2) {
+    return 1.0;
+  }
+  const int q = std::min(8, std::min(text1.length(), text2.length()));
+  if (q == 0) {
+    return 0.0;
+  }
+  // Keep roughly 512 q-grams per text.  The sample is chosen by hash value,
+  // so a q-gram present in both texts is sampled in both or in neither.
+  const uint rate = std::max(1, (text1.length() + text2.length()) / 1024);
+  QSet<uint> samples[2];
+  const QString *texts[2] = {&text1, &text2};
+  uint power = 1;
+  for (int i = 1; i < q; i++) {
+    power *= 31;
+  }
+  for (int t = 0; t < 2; t++) {
+    const QString &text = *texts[t];
+    uint hash = 0;
+    for (int i = 0; i < text.length(); i++) {
+      if (i >= q) {
+        hash -= text[i - q].unicode() * power;
+      }
+      hash = hash * 31 + text[i].unicode();
+      if (i >= q - 1) {
+        const uint mixed = (hash * 2654435761U) >> 8;
+        if (mixed % rate == 0) {
+          samples[t].insert(hash);
+        }
+      }
     }
   }
-  return n;
+  const int common = QSet<uint>(samples[0]).intersect(samples[1]).size();
+  const int total = samples[0].size() + samples[1].size() - common;
+  return total == 0 ? 0.0 : common / static_cast<double>(total);
 }
 
-int diff_match_patch::diff_commonOverlap(const QString &text1,
-                                         const QString &text2) {
-  // Cache the text lengths to prevent multiple calls.
-  const int text1_length = text1.length();
-  const int text2_length = text2.length();
-  // Eliminate the null case.
-  if (text1_length == 0 || text2_length == 0) {
-    return 0;
+
+CostEstimate diff_match_patch::diff_estimate(const QString &text1,
+                                             const QString &text2) {
+  return diff_estimate(text1, text2, true);
+}
+
+
+CostEstimate diff_match_patch::diff_estimate(const QString &text1,
+    const QString &text2, bool checklines) {
+  // Check for null inputs.
+  if (text1.isNull() || text2.isNull()) {
+    throw "Null inputs. (diff_estimate)";
   }
-  // Truncate the longer string.
-  QString text1_trunc = text1;
-  QString text2_trunc = text2;
-  if (text1_length > text2_length) {
-    text1_trunc = text1.right(text2_length);
-  } else if (text1_length < text2_length) {
-    text2_trunc = text2.left(text1_length);
-  }
-  const int text_length = std::min(text1_length, text2_length);
-  // Quick check for the worst case.
-  if (text1_trunc == text2_trunc) {
-    return text_length;
-  }
-
-  // Start by looking for a single character match
-  // and increase length until no match is found.
-  // Performance analysis: http://neil.fraser.name/news/2010/11/04/
-  int best = 0;
-  int length = 1;
-  while (true) {
-    QString pattern = text1_trunc.right(length);
-    int found = text2_trunc.indexOf(pattern);
-    if (found == -1) {
-      return best;
+
+  const double scanCost = Diff_ScanCost > 0 ? Diff_ScanCost : DEFAULT_SCAN_COST;
+  CostEstimate estimate;
+  // diff_main holds both texts and builds a result of about the same size.
+  estimate.bytes = 2 * sizeof(QChar) * (text1.length() + text2.length());
+  estimate.seconds = scanCost * (text1.length() + text2.length());
+  if (text1 == text2) {
+    return estimate;
+  }
+
+  // Mirror the prefix and suffix trim of diff_main.
+  estimate.commonPrefix = diff_commonPrefix(text1, text2);
+  QString middle1 = safeMid(text1, estimate.commonPrefix);
+  QString middle2 = safeMid(text2, estimate.commonPrefix);
+  estimate.commonSuffix = diff_commonSuffix(middle1, middle2);
+  middle1 = middle1.left(middle1.length() - estimate.commonSuffix);
+  middle2 = middle2.left(middle2.length() - estimate.commonSuffix);
+
+  estimate.features = diff_features(middle1, middle2);
+  const double chars = middle1.length() + middle2.length();
+  estimate.seconds += scanCost * chars;
+  estimate.bytes += sizeof(QChar) * chars;
+  if (middle1.isEmpty() || middle2.isEmpty()) {
+    estimate.strategy = STRATEGY_TRIVIAL;
+    estimate.similarity = 0.0;
+    estimate.edits = static_cast<int>(chars);
+    return estimate;
+  }
+
+  estimate.similarity = diff_similarity(middle1, middle2);
+  // Jaccard similarity J of the q-grams leaves (1 - J) / (1 + J) of each
+  // text unmatched.  Scattered edits make this an overestimate.
+  estimate.edits = static_cast<int>(std::max(
+      static_cast<double>(qAbs(middle1.length() - middle2.length())),
+      chars * (1.0 - estimate.similarity) / (1.0 + estimate.similarity)));
+  // Changed lines which are not shared with the other text cluster into
+  // blocks which line mode rediffs character by character.
+  const double blockLength = std::max(estimate.features.avgLineLength,
+      estimate.features.uniqueLineRatio * chars
+      * (1.0 - estimate.similarity));
+  if (checklines && diff_useLineMode(middle1, middle2)) {
+    estimate.strategy = STRATEGY_LINEMODE;
+    const double lines = estimate.features.lines1 + estimate.features.lines2;
+    // Line hash, line array and the munged texts.
+    estimate.bytes += static_cast<qint64>(sizeof(QChar) * (chars + lines)
+        + 4 * sizeof(void *) * lines);
+  } else {
+    estimate.strategy = STRATEGY_BISECT;
+    // The two V arrays of diff_bisect.
+    estimate.bytes += static_cast<qint64>(2 * sizeof(int) * chars);
+  }
+  double seconds = diff_strategyCost(estimate.strategy, estimate.features,
+                                     estimate.edits, blockLength);
+  if (Diff_Timeout > 0) {
+    seconds = std::min(seconds, static_cast<double>(Diff_Timeout));
+  }
+  estimate.seconds += seconds;
+  return estimate;
+}
+
+
+QVector<uint> diff_match_patch::diff_sketch(const QString &text) {
+  return diff_sketch(text, true);
+}
+
+
+QVector<uint> diff_match_patch::diff_sketch(const QString &text, bool lines) {
+  // Hash each distinct token once.
+  QSet<uint> tokens;
+  int tokenStart = 0;
+  while (tokenStart < text.length()) {
+    int tokenEnd;
+    if (lines) {
+      tokenEnd = text.indexOf('\n', tokenStart);
+      if (tokenEnd == -1) {
+        tokenEnd = text.length() - 1;
+      }
+      tokenEnd++;
+    } else {
+      while (tokenStart < text.length() && text[tokenStart].isSpace()) {
+        tokenStart++;
+      }
+      tokenEnd = tokenStart;
+      while (tokenEnd < text.length() && !text[tokenEnd].isSpace()) {
+        tokenEnd++;
+      }
+      if (tokenEnd == tokenStart) {
+        break;
+      }
+    }
+    tokens.insert(qHash(text.mid(tokenStart, tokenEnd - tokenStart)));
+    tokenStart = tokenEnd;
+  }
+
+  // Each slot keeps the minimum of its own permutation of the token hashes.
+  QVector<uint> sketch(Sketch_Size, std::numeric_limits<uint>::max());
+  foreach(uint token, tokens) {
+    for (int x = 0; x < Sketch_Size; x++) {
+      uint hash = (token ^ (x * 0x9E3779B9U)) * 0x85EBCA6BU;
+      hash ^= hash >> 13;
+      hash *= 0xC2B2AE35U;
+      hash ^= hash >> 16;
+      if (hash < sketch[x]) {
+        sketch[x] = hash;
+      }
+    }
+  }
+  return sketch;
+}
+
+
+void diff_match_patch::diff_calibrate(
+    const QList<QPair<QString, QString> > &samples) {
+  typedef QPair<QString, QString> TextPair;
+  // Time each step repeatedly until at least this much time has passed.
+  const clock_t minTime = CLOCKS_PER_SEC / 50;
+  double tokenTime = 0.0;
+  double tokenChars = 0.0;
+  double bisectTime = 0.0;
+  double bisectWork = 0.0;
+  double scanTime = 0.0;
+  double scanChars = 0.0;
+  foreach(TextPair sample, samples) {
+    // Strip the common prefix and suffix, just like diff_main would.
+    int commonlength = diff_commonPrefix(sample.first, sample.second);
+    QString text1 = safeMid(sample.first, commonlength);
+    QString text2 = safeMid(sample.second, commonlength);
+    commonlength = diff_commonSuffix(text1, text2);
+    text1 = text1.left(text1.length() - commonlength);
+    text2 = text2.left(text2.length() - commonlength);
+    if (text1.isEmpty() || text2.isEmpty()) {
+      continue;
+    }
+    const double chars = text1.length() + text2.length();
+
+    const QString copy1 = QString(text1.constData(), text1.length());
+    int runs = 0;
+    clock_t start = clock();
+    clock_t elapsed;
+    do {
+      diff_commonPrefix(text1, copy1);
+      runs++;
+      elapsed = clock() - start;
+    } while (elapsed < minTime);
+    scanTime += elapsed / static_cast<double>(CLOCKS_PER_SEC) / runs;
+    scanChars += text1.length();
+
+    runs = 0;
+    start = clock();
+    do {
+      diff_linesToChars(text1, text2);
+      runs++;
+      elapsed = clock() - start;
+    } while (elapsed < minTime);
+    tokenTime += elapsed / static_cast<double>(CLOCKS_PER_SEC) / runs;
+    tokenChars += chars;
+
+    QList<Diff> diffs;
+    runs = 0;
+    start = clock();
+    do {
+      diffs = diff_bisect(text1, text2, std::numeric_limits<clock_t>::max());
+      runs++;
+      elapsed = clock() - start;
+    } while (elapsed < minTime);
+    bisectTime += elapsed / static_cast<double>(CLOCKS_PER_SEC) / runs;
+    bisectWork += chars * std::max(1, diff_levenshtein(diffs));
+  }
+  if (tokenChars > 0 && bisectWork > 0) {
+    Diff_TokenCost = tokenTime / tokenChars;
+    Diff_BisectCost = bisectTime / bisectWork;
+    Diff_ScanCost = scanTime / scanChars;
+  }
+}
+
+
+bool diff_match_patch::profile_load(const QString &fileName) {
+  if (!QFile::exists(fileName)) {
+    return false;
+  }
+  QSettings profile(fileName, QSettings::IniFormat);
+  if (profile.status() != QSettings::NoError) {
+    return false;
+  }
+  Diff_LineModeThreshold = profile.value("Diff_LineModeThreshold",
+      Diff_LineModeThreshold).toInt();
+  Diff_HalfMatchSeeds = static_cast<short>(profile.value("Diff_HalfMatchSeeds",
+      Diff_HalfMatchSeeds).toInt());
+  Diff_TokenCost = profile.value("Diff_TokenCost", Diff_TokenCost).toDouble();
+  Diff_BisectCost = profile.value("Diff_BisectCost",
+      Diff_BisectCost).toDouble();
+  Diff_ScanCost = profile.value("Diff_ScanCost", Diff_ScanCost).toDouble();
+  return true;
+}
+
+
+bool diff_match_patch::profile_save(const QString &fileName) {
+  QSettings profile(fileName, QSettings::IniFormat);
+  profile.setValue("Diff_LineModeThreshold", Diff_LineModeThreshold);
+  profile.setValue("Diff_HalfMatchSeeds", Diff_HalfMatchSeeds);
+  profile.setValue("Diff_TokenCost", Diff_TokenCost);
+  profile.setValue("Diff_BisectCost", Diff_BisectCost);
+  profile.setValue("Diff_ScanCost", Diff_ScanCost);
+  profile.sync();
+  return profile.status() == QSettings::NoError;
+}
+
+
+QList<CapturedCall> diff_match_patch::capture_load(const QString &fileName) {
+  QList<CapturedCall> calls;
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return calls;
+  }
+  QTextStream input(&file);
+  input.setCodec("UTF-8");
+  while (!input.atEnd()) {
+    const QString line = input.readLine();
+    if (!line.isEmpty()) {
+      calls.append(CapturedCall::fromString(line));
+    }
+  }
+  return calls;
+}
+
+
+bool diff_match_patch::capture_replay(const CapturedCall &call,
+                                      double &seconds) {
+  capture_loadSettings(call.settings);
+  Capture_File = "";
+  seconds = 0.0;
+  if (call.function == "diff_main" && call.inputs.size() == 3) {
+    const QString &text1 = call.inputs[1];
+    const QString text2 = diff_text2(diff_fromDelta(text1, call.inputs[2]));
+    const clock_t start = clock();
+    const QList<Diff> diffs = diff_main(text1, text2, call.inputs[0] == "1");
+    seconds = (clock() - start) / static_cast<double>(CLOCKS_PER_SEC);
+    return qHash(diff_toDelta(diffs)) == call.resultHash;
+  }
+  if (call.function == "patch_apply" && call.inputs.size() == 2) {
+    QList<Patch> patches = patch_fromText(call.inputs[0]);
+    const clock_t start = clock();
+    const QPair<QString, QVector<bool> > result =
+        patch_apply(patches, call.inputs[1]);
+    seconds = (clock() - start) / static_cast<double>(CLOCKS_PER_SEC);
+    return qHash(captureResult(result)) == call.resultHash;
+  }
+  if (call.function == "patch_make" && call.inputs.size() == 2) {
+    const clock_t start = clock();
+    const QList<Patch> patches = patch_make(call.inputs[0], call.inputs[1]);
+    seconds = (clock() - start) / static_cast<double>(CLOCKS_PER_SEC);
+    return qHash(patch_toText(patches)) == call.resultHash;
+  }
+  throw QString("Unknown captured call: %1").arg(call.function);
+}
+
+
+QString diff_match_patch::capture_settings() {
+  QStringList settings;
+  settings << QString("Diff_Timeout=%1").arg(Diff_Timeout)
+      << QString("Diff_EditCost=%1").arg(Diff_EditCost)
+      << QString("Match_Threshold=%1").arg(Match_Threshold)
+      << QString("Match_Distance=%1").arg(Match_Distance)
+      << QString("Patch_DeleteThreshold=%1").arg(Patch_DeleteThreshold)
+      << QString("Patch_Margin=%1").arg(Patch_Margin)
+      << QString("Match_MaxBits=%1").arg(Match_MaxBits)
+      << QString("Diff_LineModeThreshold=%1").arg(Diff_LineModeThreshold)
+      << QString("Diff_HalfMatchSeeds=%1").arg(Diff_HalfMatchSeeds)
+      << QString("Diff_TokenCost=%1").arg(Diff_TokenCost, 0, 'g', 17)
+      << QString("Diff_BisectCost=%1").arg(Diff_BisectCost, 0, 'g', 17)
+      << QString("Diff_ScanCost=%1").arg(Diff_ScanCost, 0, 'g', 17)
+      << QString("Match_Threads=%1").arg(Match_Threads)
+      << QString("Diff_Threads=%1").arg(Diff_Threads);
+  return settings.join("&");
+}
+
+
+void diff_match_patch::capture_loadSettings(const QString &settings) {
+  foreach(const QString &setting,
+          settings.split("&", QString::SkipEmptyParts)) {
+    const QString key = setting.section('=', 0, 0);
+    const QString value = setting.section('=', 1);
+    if (key == "Diff_Timeout") {
+      Diff_Timeout = value.toFloat();
+    } else if (key == "Diff_EditCost") {
+      Diff_EditCost = static_cast<short>(value.toInt());
+    } else if (key == "Match_Threshold") {
+      Match_Threshold = value.toFloat();
+    } else if (key == "Match_Distance") {
+      Match_Distance = value.toInt();
+    } else if (key == "Patch_DeleteThreshold") {
+      Patch_DeleteThreshold = value.toFloat();
+    } else if (key == "Patch_Margin") {
+      Patch_Margin = static_cast<short>(value.toInt());
+    } else if (key == "Match_MaxBits") {
+      Match_MaxBits = static_cast<short>(value.toInt());
+    } else if (key == "Diff_LineModeThreshold") {
+      Diff_LineModeThreshold = value.toInt();
+    } else if (key == "Diff_HalfMatchSeeds") {
+      Diff_HalfMatchSeeds = static_cast<short>(value.toInt());
+    } else if (key == "Diff_TokenCost") {
+      Diff_TokenCost = value.toDouble();
+    } else if (key == "Diff_BisectCost") {
+      Diff_BisectCost = value.toDouble();
+    } else if (key == "Diff_ScanCost") {
+      Diff_ScanCost = value.toDouble();
+    } else if (key == "Match_Threads") {
+      Match_Threads = static_cast<short>(value.toInt());
+    } else if (key == "Diff_Threads") {
+      Diff_Threads = static_cast<short>(value.toInt());
     }
-    length += found;
-    if (found == 0 || text1_trunc.right(length) == text2_trunc.left(length)) {
-      best = length;
-      length++;
+  }
+}
+
+
+void diff_match_patch::capture_write(const CapturedCall &call) {
+  QFile file(Capture_File);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+    // Capture is best effort; never fail the call over it.
+    return;
+  }
+  QTextStream output(&file);
+  output.setCodec("UTF-8");
+  output << call.toString() << "\n";
+}
+
+
+QString diff_match_patch::kernel_variant() {
+  return DiffCore::kernelVariant();
+}
+
+
+QStringList diff_match_patch::kernel_variants() {
+  QStringList variants;
+  for (int i = 0; i < DiffCore::kernelCount(); i++) {
+    if (DiffCore::kernelSupported(i)) {
+      variants.append(DiffCore::kernelName(i));
     }
   }
+  return variants;
+}
+
+
+bool diff_match_patch::kernel_select(const QString &variant) {
+  return DiffCore::kernelSelect(variant.toLatin1().constData());
+}
+
+
+int diff_match_patch::diff_commonPrefix(const QString &text1,
+                                        const QString &text2) {
+  // Performance analysis: http://neil.fraser.name/news/2007/10/09/
+  const int n = std::min(text1.length(), text2.length());
+  return DiffCore::commonPrefix(coreChars(text1), coreChars(text2), n);
+}
+
+
+int diff_match_patch::diff_commonSuffix(const QString &text1,
+                                        const QString &text2) {
+  // Performance analysis: http://neil.fraser.name/news/2007/10/09/
+  const int text1_length = text1.length();
+  const int text2_length = text2.length();
+  const int n = std::min(text1_length, text2_length);
+  return DiffCore::commonSuffix(coreChars(text1) + text1_length,
+                                coreChars(text2) + text2_length, n);
+}
+
+int diff_match_patch::diff_commonOverlap(const QString &text1,
+                                         const QString &text2) {
+  long long scanned = 0;
+  const int overlap = DiffCore::commonOverlap(coreChars(text1),
+      text1.length(), coreChars(text2), text2.length(), scanned);
+  DMP_WORK(WORK_OVERLAP, scanned);
+  return overlap;
 }
 
 QStringList diff_match_patch::diff_halfMatch(const QString &text1,
@@ -647,22 +4038,20 @@ QStringList diff_match_patch::diff_halfMatch(const QString &text1,
     return QStringList();  // Pointless.
   }
 
-  // First check if the second quarter is the seed for a half-match.
-  const QStringList hm1 = diff_halfMatchI(longtext, shorttext,
-      (longtext.length() + 3) / 4);
-  // Check again based on the third quarter.
-  const QStringList hm2 = diff_halfMatchI(longtext, shorttext,
-      (longtext.length() + 1) / 2);
+  // Spread the seeds evenly; with the default two seeds these are the second
+  // and the third quarters.
+  const int seeds = Diff_HalfMatchSeeds;
   QStringList hm;
-  if (hm1.isEmpty() && hm2.isEmpty()) {
+  for (int k = 1; k <= seeds; k++) {
+    const QStringList hmk = diff_halfMatchI(longtext, shorttext,
+        (k * longtext.length() + seeds + 1) / (seeds + 2));
+    // Several matched.  Select the longest, later seeds win ties.
+    if (!hmk.isEmpty() && (hm.isEmpty() || hmk[4].length() >= hm[4].length())) {
+      hm = hmk;
+    }
+  }
+  if (hm.isEmpty()) {
     return QStringList();
-  } else if (hm2.isEmpty()) {
-    hm = hm1;
-  } else if (hm1.isEmpty()) {
-    hm = hm2;
-  } else {
-    // Both matched.  Select the longest.
-    hm = hm1[4].length() > hm2[4].length() ? hm1 : hm2;
   }
 
   // A half-match was found, sort out the return data.
@@ -690,6 +4079,7 @@ QStringList diff_match_patch::diff_halfMatchI(const QString &longtext,
         safeMid(shorttext, j));
     const int suffixLength = diff_commonSuffix(longtext.left(i),
         shorttext.left(j));
+    DMP_WORK(WORK_HALFMATCH, seed.length() + prefixLength + suffixLength);
     if (best_common.length() < suffixLength + prefixLength) {
       best_common = safeMid(shorttext, j - suffixLength, suffixLength)
           + safeMid(shorttext, j, prefixLength);
@@ -714,9 +4104,112 @@ void diff_match_patch::diff_cleanupSemantic(QList<Diff> &diffs) {
   if (diffs.isEmpty()) {
     return;
   }
+  // Normalize the diff.
+  if (diff_cleanupSemanticEqualities(diffs, NULL)) {
+    diff_cleanupMerge(diffs);
+  }
+  diff_cleanupSemanticLossless(diffs);
+
+  // Find any overlaps between deletions and insertions.
+  // e.g: <del>abcxxx</del><ins>xxxdef</ins>
+  //   -> <del>abc</del>xxx<ins>def</ins>
+  // e.g: <del>xxxabc</del><ins>defxxx</ins>
+  //   -> <ins>def</ins>xxx<del>abc</del>
+  // Only extract an overlap if it is as big as the edit ahead or behind it.
+  QMutableListIterator<Diff> pointer(diffs);
+  Diff *prevDiff = NULL;
+  Diff *thisDiff = NULL;
+  if (pointer.hasNext()) {
+    prevDiff = &pointer.next();
+    if (pointer.hasNext()) {
+      thisDiff = &pointer.next();
+    }
+  }
+  while (thisDiff != NULL) {
+    if (prevDiff->operation == DELETE &&
+        thisDiff->operation == INSERT) {
+      QString deletion = prevDiff->text;
+      QString insertion = thisDiff->text;
+      int overlap_length1 = diff_commonOverlap(deletion, insertion);
+      int overlap_length2 = diff_commonOverlap(insertion, deletion);
+      if (overlap_length1 >= overlap_length2) {
+        if (overlap_length1 >= deletion.length() / 2.0 ||
+            overlap_length1 >= insertion.length() / 2.0) {
+          // Overlap found.  Insert an equality and trim the surrounding edits.
+          pointer.previous();
+          pointer.insert(Diff(EQUAL, insertion.left(overlap_length1)));
+          prevDiff->text =
+              deletion.left(deletion.length() - overlap_length1);
+          thisDiff->text = safeMid(insertion, overlap_length1);
+          // pointer.insert inserts the element before the cursor, so there is
+          // no need to step past the new element.
+        }
+      } else {
+        if (overlap_length2 >= deletion.length() / 2.0 ||
+            overlap_length2 >= insertion.length() / 2.0) {
+          // Reverse overlap found.
+          // Insert an equality and swap and trim the surrounding edits.
+          pointer.previous();
+          pointer.insert(Diff(EQUAL, deletion.left(overlap_length2)));
+          prevDiff->operation = INSERT;
+          prevDiff->text =
+              insertion.left(insertion.length() - overlap_length2);
+          thisDiff->operation = DELETE;
+          thisDiff->text = safeMid(deletion, overlap_length2);
+          // pointer.insert inserts the element before the cursor, so there is
+          // no need to step past the new element.
+        }
+      }
+      thisDiff = pointer.hasNext() ? &pointer.next() : NULL;
+    }
+    prevDiff = thisDiff;
+    thisDiff = pointer.hasNext() ? &pointer.next() : NULL;
+  }
+}
+
+
+void diff_match_patch::diff_cleanupSemanticLossless(QList<Diff> &diffs) {
+  diff_cleanupSemanticShift(diffs, NULL);
+}
+
+
+void diff_match_patch::diff_cleanupSemanticTokens(QList<Diff> &diffs,
+    const QStringList &lineArray) {
+  if (diffs.isEmpty()) {
+    return;
+  }
+  // Normalize the diff.
+  if (diff_cleanupSemanticEqualities(diffs, &lineArray)) {
+    diff_cleanupMerge(diffs);
+  }
+  // Overlaps between deletions and insertions are left to the
+  // character-level rediff in diff_lineMode.
+  diff_cleanupSemanticShift(diffs, &lineArray);
+}
+
+
+// Number of characters in a text, or in the lines that a run of tokens
+// stands for.
+static int diff_semanticLength(const QString &text,
+                               const QStringList *lineArray) {
+  if (lineArray == NULL) {
+    return text.length();
+  }
+  int length = 0;
+  for (int i = 0; i < text.length(); i++) {
+    length += lineArray->value(static_cast<ushort>(text[i].unicode()))
+        .length();
+  }
+  return length;
+}
+
+
+bool diff_match_patch::diff_cleanupSemanticEqualities(QList<Diff> &diffs,
+    const QStringList *lineArray) {
   bool changes = false;
   QStack<Diff> equalities;  // Stack of equalities.
   QString lastequality;  // Always equal to equalities.lastElement().text
+  int lastequality_length = 0;  // diff_semanticLength of lastequality.
   QMutableListIterator<Diff> pointer(diffs);
   // Number of characters that changed prior to the equality.
   int length_insertions1 = 0;
@@ -726,6 +4219,7 @@ void diff_match_patch::diff_cleanupSemantic(QList<Diff> &diffs) {
   int length_deletions2 = 0;
   Diff *thisDiff = pointer.hasNext() ? &pointer.next() : NULL;
   while (thisDiff != NULL) {
+    DMP_WORK(WORK_CLEANUP, 1);
     if (thisDiff->operation == EQUAL) {
       // Equality found.
       equalities.push(*thisDiff);
@@ -734,21 +4228,21 @@ void diff_match_patch::diff_cleanupSemantic(QList<Diff> &diffs) {
       length_insertions2 = 0;
       length_deletions2 = 0;
       lastequality = thisDiff->text;
+      lastequality_length = diff_semanticLength(lastequality, lineArray);
     } else {
       // An insertion or deletion.
       if (thisDiff->operation == INSERT) {
-        length_insertions2 += thisDiff->text.length();
+        length_insertions2 += diff_semanticLength(thisDiff->text, lineArray);
       } else {
-        length_deletions2 += thisDiff->text.length();
+        length_deletions2 += diff_semanticLength(thisDiff->text, lineArray);
       }
       // Eliminate an equality that is smaller or equal to the edits on both
       // sides of it.
       if (!lastequality.isNull()
-          && (lastequality.length()
+          && (lastequality_length
               <= std::max(length_insertions1, length_deletions1))
-          && (lastequality.length()
+          && (lastequality_length
               <= std::max(length_insertions2, length_deletions2))) {
-        // printf("Splitting: '%s'\n", qPrintable(lastequality));
         // Walk back to offending equality.
         while (*thisDiff != equalities.top()) {
           thisDiff = &pointer.previous();
@@ -788,72 +4282,12 @@ void diff_match_patch::diff_cleanupSemantic(QList<Diff> &diffs) {
     }
     thisDiff = pointer.hasNext() ? &pointer.next() : NULL;
   }
-
-  // Normalize the diff.
-  if (changes) {
-    diff_cleanupMerge(diffs);
-  }
-  diff_cleanupSemanticLossless(diffs);
-
-  // Find any overlaps between deletions and insertions.
-  // e.g: <del>abcxxx</del><ins>xxxdef</ins>
-  //   -> <del>abc</del>xxx<ins>def</ins>
-  // e.g: <del>xxxabc</del><ins>defxxx</ins>
-  //   -> <ins>def</ins>xxx<del>abc</del>
-  // Only extract an overlap if it is as big as the edit ahead or behind it.
-  pointer.toFront();
-  Diff *prevDiff = NULL;
-  thisDiff = NULL;
-  if (pointer.hasNext()) {
-    prevDiff = &pointer.next();
-    if (pointer.hasNext()) {
-      thisDiff = &pointer.next();
-    }
-  }
-  while (thisDiff != NULL) {
-    if (prevDiff->operation == DELETE &&
-        thisDiff->operation == INSERT) {
-      QString deletion = prevDiff->text;
-      QString insertion = thisDiff->text;
-      int overlap_length1 = diff_commonOverlap(deletion, insertion);
-      int overlap_length2 = diff_commonOverlap(insertion, deletion);
-      if (overlap_length1 >= overlap_length2) {
-        if (overlap_length1 >= deletion.length() / 2.0 ||
-            overlap_length1 >= insertion.length() / 2.0) {
-          // Overlap found.  Insert an equality and trim the surrounding edits.
-          pointer.previous();
-          pointer.insert(Diff(EQUAL, insertion.left(overlap_length1)));
-          prevDiff->text =
-              deletion.left(deletion.length() - overlap_length1);
-          thisDiff->text = safeMid(insertion, overlap_length1);
-          // pointer.insert inserts the element before the cursor, so there is
-          // no need to step past the new element.
-        }
-      } else {
-        if (overlap_length2 >= deletion.length() / 2.0 ||
-            overlap_length2 >= insertion.length() / 2.0) {
-          // Reverse overlap found.
-          // Insert an equality and swap and trim the surrounding edits.
-          pointer.previous();
-          pointer.insert(Diff(EQUAL, deletion.left(overlap_length2)));
-          prevDiff->operation = INSERT;
-          prevDiff->text =
-              insertion.left(insertion.length() - overlap_length2);
-          thisDiff->operation = DELETE;
-          thisDiff->text = safeMid(deletion, overlap_length2);
-          // pointer.insert inserts the element before the cursor, so there is
-          // no need to step past the new element.
-        }
-      }
-      thisDiff = pointer.hasNext() ? &pointer.next() : NULL;
-    }
-    prevDiff = thisDiff;
-    thisDiff = pointer.hasNext() ? &pointer.next() : NULL;
-  }
+  return changes;
 }
 
 
-void diff_match_patch::diff_cleanupSemanticLossless(QList<Diff> &diffs) {
+void diff_match_patch::diff_cleanupSemanticShift(QList<Diff> &diffs,
+    const QStringList *lineArray) {
   QString equality1, edit, equality2;
   QString commonString;
   int commonOffset;
@@ -887,15 +4321,15 @@ void diff_match_patch::diff_cleanupSemanticLossless(QList<Diff> &diffs) {
         bestEquality1 = equality1;
         bestEdit = edit;
         bestEquality2 = equality2;
-        bestScore = diff_cleanupSemanticScore(equality1, edit)
-            + diff_cleanupSemanticScore(edit, equality2);
+        bestScore = diff_cleanupSemanticEditScore(equality1, edit, equality2,
+                                                  lineArray);
         while (!edit.isEmpty() && !equality2.isEmpty()
             && edit[0] == equality2[0]) {
           equality1 += edit[0];
           edit = safeMid(edit, 1) + equality2[0];
           equality2 = safeMid(equality2, 1);
-          score = diff_cleanupSemanticScore(equality1, edit)
-              + diff_cleanupSemanticScore(edit, equality2);
+          score = diff_cleanupSemanticEditScore(equality1, edit, equality2,
+                                                lineArray);
           // The >= encourages trailing rather than leading whitespace on edits.
           if (score >= bestScore) {
             bestScore = score;
@@ -934,6 +4368,32 @@ void diff_match_patch::diff_cleanupSemanticLossless(QList<Diff> &diffs) {
 }
 
 
+int diff_match_patch::diff_cleanupSemanticEditScore(const QString &equality1,
+    const QString &edit, const QString &equality2,
+    const QStringList *lineArray) {
+  if (lineArray == NULL) {
+    return diff_cleanupSemanticScore(equality1, edit)
+        + diff_cleanupSemanticScore(edit, equality2);
+  }
+  return diff_cleanupSemanticTokenScore(equality1, edit, *lineArray)
+      + diff_cleanupSemanticTokenScore(edit, equality2, *lineArray);
+}
+
+
+int diff_match_patch::diff_cleanupSemanticTokenScore(const QString &one,
+    const QString &two, const QStringList &lineArray) {
+  // Two lines either side are enough to see a blank line at the boundary.
+  QString lines1, lines2;
+  for (int i = std::max(0, one.length() - 2); i < one.length(); i++) {
+    lines1 += lineArray.value(static_cast<ushort>(one[i].unicode()));
+  }
+  for (int i = 0; i < two.length() && i < 2; i++) {
+    lines2 += lineArray.value(static_cast<ushort>(two[i].unicode()));
+  }
+  return diff_cleanupSemanticScore(lines1, lines2);
+}
+
+
 int diff_match_patch::diff_cleanupSemanticScore(const QString &one,
                                                 const QString &two) {
   if (one.isEmpty() || two.isEmpty()) {
@@ -981,6 +4441,10 @@ int diff_match_patch::diff_cleanupSemanticScore(const QString &one,
 QRegExp diff_match_patch::BLANKLINEEND = QRegExp("\\n\\r?\\n$");
 QRegExp diff_match_patch::BLANKLINESTART = QRegExp("^\\r?\\n\\r?\\n");
 
+#ifdef DMP_WORK_COUNTERS
+quint64 diff_match_patch::workCounters[WORK_COUNTERS];
+#endif
+
 
 void diff_match_patch::diff_cleanupEfficiency(QList<Diff> &diffs) {
   if (diffs.isEmpty()) {
@@ -1239,78 +4703,137 @@ void diff_match_patch::diff_cleanupMerge(QList<Diff> &diffs) {
 
 
 int diff_match_patch::diff_xIndex(const QList<Diff> &diffs, int loc) {
-  int chars1 = 0;
-  int chars2 = 0;
-  int last_chars1 = 0;
-  int last_chars2 = 0;
-  Diff lastDiff;
-  foreach(Diff aDiff, diffs) {
-    if (aDiff.operation != INSERT) {
-      // Equality or deletion.
-      chars1 += aDiff.text.length();
-    }
-    if (aDiff.operation != DELETE) {
-      // Equality or insertion.
-      chars2 += aDiff.text.length();
-    }
-    if (chars1 > loc) {
-      // Overshot the location.
-      lastDiff = aDiff;
-      break;
-    }
-    last_chars1 = chars1;
-    last_chars2 = chars2;
+  CoreArray<CoreDiff> view;
+  coreDiffs(diffs, view);
+  return DiffCore::xIndex(view.data(), view.size(), loc);
+}
+
+
+QString diff_match_patch::diff_prettyHtml(const QList<Diff> &diffs) {
+  QString html;
+  foreach(const Diff &aDiff, diffs) {
+    html += diff_prettyHtmlDiff(aDiff.operation, aDiff.text);
+  }
+  return html;
+}
+
+
+QString diff_match_patch::diff_prettyHtml(const DiffIndex &index, int start2,
+                                          int end2) {
+  start2 = std::max(0, start2);
+  end2 = std::min(index.length2(), end2);
+  if (end2 < start2 || (end2 == start2 && index.length2() != 0)) {
+    // Windows are half-open, so an empty one shows nothing, unless all of
+    // text2 is empty and the deletions have nowhere else to go.
+    return "";
   }
-  if (lastDiff.operation == DELETE) {
-    // The location was deleted.
-    return last_chars2;
+  const int firstDiff = index.diffAt(start2);
+  int lastDiff = firstDiff;
+  const int count = index.diffs().size();
+  while (lastDiff < count && (index.start2(lastDiff) < end2
+      || (end2 == index.length2()
+          && index.diffs()[lastDiff].operation == DELETE))) {
+    // Trailing deletions belong to the window at the end of text2.
+    lastDiff++;
   }
-  // Add the remaining character length.
-  return last_chars2 + (loc - last_chars1);
+  return diff_prettyHtmlSlice(index, firstDiff, lastDiff, start2, end2);
 }
 
 
-QString diff_match_patch::diff_prettyHtml(const QList<Diff> &diffs) {
+QString diff_match_patch::diff_prettyHtmlHunks(const DiffIndex &index,
+                                               int firstHunk, int lastHunk) {
+  const QList<DiffHunk> &hunks = index.hunks();
+  firstHunk = std::max(0, firstHunk);
+  lastHunk = std::min(hunks.size() - 1, lastHunk);
+  if (lastHunk < firstHunk) {
+    return "";
+  }
+  const int firstDiff = hunks[firstHunk].firstDiff;
+  const int lastDiff = hunks[lastHunk].firstDiff + hunks[lastHunk].diffCount;
+  return diff_prettyHtmlSlice(index, firstDiff, lastDiff,
+                              index.start2(firstDiff), index.start2(lastDiff));
+}
+
+
+QString diff_match_patch::diff_prettyHtmlSlice(const DiffIndex &index,
+                                               int firstDiff, int lastDiff,
+                                               int start2, int end2) {
   QString html;
-  QString text;
-  foreach(Diff aDiff, diffs) {
-    text = aDiff.text;
-    text.replace("&", "&amp;").replace("<", "&lt;")
-        .replace(">", "&gt;").replace("\n", "&para;<br>");
-    switch (aDiff.operation) {
-      case INSERT:
-        html += QString("<ins style=\"background:#e6ffe6;\">") + text
-            + QString("</ins>");
-        break;
-      case DELETE:
-        html += QString("<del style=\"background:#ffe6e6;\">") + text
-            + QString("</del>");
-        break;
-      case EQUAL:
-        html += QString("<span>") + text + QString("</span>");
-        break;
+  for (int x = firstDiff; x < lastDiff; x++) {
+    const Diff &aDiff = index.diffs()[x];
+    if (aDiff.operation == DELETE) {
+      html += diff_prettyHtmlDiff(aDiff.operation, aDiff.text);
+      continue;
+    }
+    const QString &text = aDiff.text;
+    int begin = std::max(0, start2 - index.start2(x));
+    int end = std::min(text.length(), end2 - index.start2(x));
+    // Don't split a surrogate pair at either edge.  A pair across the edge
+    // between two windows belongs to the earlier one, so that adjacent
+    // windows render it once.
+    if (begin > 0 && begin < text.length() && text[begin].isLowSurrogate()
+        && text[begin - 1].isHighSurrogate()) {
+      begin++;
+    }
+    if (end > 0 && end < text.length() && text[end - 1].isHighSurrogate()
+        && text[end].isLowSurrogate()) {
+      end++;
+    }
+    if (begin < end) {
+      html += diff_prettyHtmlDiff(aDiff.operation,
+                                  text.mid(begin, end - begin));
     }
   }
   return html;
 }
 
 
-QString diff_match_patch::diff_text1(const QList<Diff> &diffs) {
-  QString text;
-  foreach(Diff aDiff, diffs) {
-    if (aDiff.operation != INSERT) {
-      text += aDiff.text;
-    }
+QString diff_match_patch::diff_prettyHtmlDiff(Operation operation,
+                                              QString text) {
+  text.replace("&", "&amp;").replace("<", "&lt;")
+      .replace(">", "&gt;").replace("\n", "&para;<br>");
+  switch (operation) {
+    case INSERT:
+      return QString("<ins style=\"background:#e6ffe6;\">") + text
+          + QString("</ins>");
+    case DELETE:
+      return QString("<del style=\"background:#ffe6e6;\">") + text
+          + QString("</del>");
+    case EQUAL:
+      return QString("<span>") + text + QString("</span>");
   }
-  return text;
+  return "";
+}
+
+
+QString diff_match_patch::diff_text1(const QList<Diff> &diffs) {
+  return diff_text(diffs, INSERT);
 }
 
 
 QString diff_match_patch::diff_text2(const QList<Diff> &diffs) {
+  return diff_text(diffs, DELETE);
+}
+
+
+QString diff_match_patch::diff_text(const QList<Diff> &diffs,
+                                    Operation skip) {
+  CoreArray<CoreDiff> view;
+  coreDiffs(diffs, view);
   QString text;
-  foreach(Diff aDiff, diffs) {
-    if (aDiff.operation != DELETE) {
-      text += aDiff.text;
+  const int length = DiffCore::textLength(view.data(), view.size(), skip);
+  if (length != 0) {
+    text.resize(length);
+    DiffCore::text(view.data(), view.size(), skip,
+                   reinterpret_cast<CoreChar *>(text.data()));
+  } else {
+    // As when the texts were appended: empty rather than null once any
+    // diff counts towards the text.
+    for (int x = 0; x < view.size(); x++) {
+      if (view[x].operation != skip) {
+        text = "";
+        break;
+      }
     }
   }
   return text;
@@ -1318,33 +4841,15 @@ QString diff_match_patch::diff_text2(const QList<Diff> &diffs) {
 
 
 int diff_match_patch::diff_levenshtein(const QList<Diff> &diffs) {
-  int levenshtein = 0;
-  int insertions = 0;
-  int deletions = 0;
-  foreach(Diff aDiff, diffs) {
-    switch (aDiff.operation) {
-      case INSERT:
-        insertions += aDiff.text.length();
-        break;
-      case DELETE:
-        deletions += aDiff.text.length();
-        break;
-      case EQUAL:
-        // A deletion and an insertion is one substitution.
-        levenshtein += std::max(insertions, deletions);
-        insertions = 0;
-        deletions = 0;
-        break;
-    }
-  }
-  levenshtein += std::max(insertions, deletions);
-  return levenshtein;
+  CoreArray<CoreDiff> view;
+  coreDiffs(diffs, view);
+  return DiffCore::levenshtein(view.data(), view.size());
 }
 
 
 QString diff_match_patch::diff_toDelta(const QList<Diff> &diffs) {
   QString text;
-  foreach(Diff aDiff, diffs) {
+  foreach(const Diff &aDiff, diffs) {
     switch (aDiff.operation) {
       case INSERT: {
         QString encoded = QString(QUrl::toPercentEncoding(aDiff.text,
@@ -1375,7 +4880,7 @@ QList<Diff> diff_match_patch::diff_fromDelta(const QString &text1,
   QList<Diff> diffs;
   int pointer = 0;  // Cursor in text1
   QStringList tokens = delta.split("\t");
-  foreach(QString token, tokens) {
+  foreach(const QString &token, tokens) {
     if (token.isEmpty()) {
       // Blank tokens are ok (from a trailing \t).
       continue;
@@ -1406,16 +4911,92 @@ QList<Diff> diff_match_patch::diff_fromDelta(const QString &text1,
         }
         break;
       }
-      default:
-        throw QString("Invalid diff operation in diff_fromDelta: %1")
-            .arg(token[0]);
+      default:
+        throw QString("Invalid diff operation in diff_fromDelta: %1")
+            .arg(token[0]);
+    }
+  }
+  if (pointer != text1.length()) {
+    throw QString("Delta length (%1) smaller than source text length (%2)")
+        .arg(pointer).arg(text1.length());
+  }
+  return diffs;
+}
+
+
+QByteArray diff_match_patch::diff_toCompressedDelta(
+    const QList<Diff> &diffs) {
+  QByteArray delta;
+  QBuffer buffer(&delta);
+  buffer.open(QIODevice::WriteOnly);
+  DeltaEncoder encoder(buffer);
+  foreach(const Diff &aDiff, diffs) {
+    encoder.write(aDiff);
+  }
+  encoder.finish();
+  buffer.close();
+  return delta;
+}
+
+
+QList<Diff> diff_match_patch::diff_fromCompressedDelta(const QString &text1,
+    const QByteArray &delta) {
+  QByteArray data = delta;
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::ReadOnly);
+  DeltaDecoder decoder(buffer);
+  QList<Diff> diffs;
+  int pointer = 0;  // Cursor in text1
+  Operation op;
+  int length;
+  QString text;
+  while (decoder.read(op, length, text)) {
+    if (op == INSERT) {
+      diffs.append(Diff(INSERT, text));
+    } else {
+      if (length > text1.length() - pointer) {
+        throw QString("Delta length (%1) larger than source text length (%2)")
+            .arg(pointer + length).arg(text1.length());
+      }
+      diffs.append(Diff(op, safeMid(text1, pointer, length)));
+      pointer += length;
+    }
+  }
+  if (pointer != text1.length()) {
+    throw QString("Delta length (%1) smaller than source text length (%2)")
+        .arg(pointer).arg(text1.length());
+  }
+  return diffs;
+}
+
+
+QString diff_match_patch::diff_applyCompressedDelta(const QString &text1,
+                                                    QIODevice &delta) {
+  DeltaDecoder decoder(delta);
+  QString text2;
+  int pointer = 0;  // Cursor in text1
+  Operation op;
+  int length;
+  QString text;
+  while (decoder.read(op, length, text)) {
+    if (op == INSERT) {
+      text2 += text;
+    } else {
+      if (length > text1.length() - pointer) {
+        throw QString("Delta length (%1) larger than source text length (%2)")
+            .arg(pointer + length).arg(text1.length());
+      }
+      if (op == EQUAL) {
+        text2 += safeMid(text1, pointer, length);
+      }
+      pointer += length;
     }
   }
   if (pointer != text1.length()) {
     throw QString("Delta length (%1) smaller than source text length (%2)")
         .arg(pointer).arg(text1.length());
   }
-  return diffs;
+  return text2;
 }
 
 
@@ -1447,6 +5028,145 @@ int diff_match_patch::match_main(const QString &text, const QString &pattern,
 }
 
 
+QList<CorpusMatch> diff_match_patch::match_corpus(const CorpusIndex &index,
+                                                  const QString &pattern) {
+  // Check for null inputs.
+  if (pattern.isNull()) {
+    throw "Null inputs. (match_corpus)";
+  }
+  if (!(Match_MaxBits == 0 || pattern.length() <= Match_MaxBits)) {
+    throw "Pattern too long for this application.";
+  }
+
+  // A match scores at least errors / pattern length.
+  const int errors = std::min(pattern.length(),
+      static_cast<int>(Match_Threshold * pattern.length()));
+  // Best score of each match found, keyed on (document, location).
+  QMap<QPair<QString, int>, double> scores;
+  typedef QPair<QString, int> Location;
+  // Matches start within errors of a candidate, and a candidate stands for
+  // the locations up to errors after it; only that window is searched.
+  const int margin = 2 * errors + 1;
+  foreach(Location candidate, index.candidates(pattern, errors)) {
+    const QString text = index.text(candidate.first);
+    const int start = std::max(0, candidate.second - margin);
+    const QString window = safeMid(text, start,
+        candidate.second + pattern.length() + margin - start);
+    int loc = match_main(window, pattern, candidate.second - start);
+    if (loc == -1) {
+      continue;
+    }
+    loc += start;
+    const QList<Diff> diffs = diff_main(pattern,
+        safeMid(text, loc, pattern.length()), false);
+    // The candidate is only where the index looked, so the score is the
+    // errors alone.
+    const double score = match_bitapScore(diff_levenshtein(diffs), loc, loc,
+                                          pattern);
+    const Location location = qMakePair(candidate.first, loc);
+    if (!scores.contains(location) || score < scores.value(location)) {
+      scores.insert(location, score);
+    }
+  }
+
+  // Rank on score, then document and location.  A window may settle on a
+  // worse match overlapping the best one of a neighbouring window; only the
+  // best of overlapping matches is kept.
+  QList<QPair<double, Location> > ranked;
+  QMapIterator<Location, double> i(scores);
+  while (i.hasNext()) {
+    i.next();
+    ranked.append(qMakePair(i.value(), i.key()));
+  }
+  qSort(ranked);
+  QList<CorpusMatch> matches;
+  QMap<QString, QList<int> > kept;
+  typedef QPair<double, Location> Ranking;
+  foreach(Ranking ranking, ranked) {
+    bool overlaps = false;
+    foreach(int loc, kept.value(ranking.second.first)) {
+      if (qAbs(loc - ranking.second.second) < pattern.length()) {
+        overlaps = true;
+        break;
+      }
+    }
+    if (overlaps) {
+      continue;
+    }
+    kept[ranking.second.first].append(ranking.second.second);
+    matches.append(CorpusMatch(ranking.second.first, ranking.second.second,
+                               ranking.first));
+  }
+  return matches;
+}
+
+
+/**
+ * One step of the Bitap recurrence, from position j + 1 to position j.
+ * @param next State at j + 1 for this error level.
+ * @param charMatch Alphabet mask of the character at j.
+ * @param last_rd State of the previous error level, or NULL.
+ * @param j Position.
+ * @return State at j.
+ */
+static inline int match_bitapStep(int next, int charMatch, const int *last_rd,
+                                  int j) {
+  if (last_rd == NULL) {
+    // First pass: exact match.
+    return ((next << 1) | 1) & charMatch;
+  }
+  // Subsequent passes: fuzzy match.
+  return ((next << 1) | 1) & charMatch
+      | (((last_rd[j + 1] | last_rd[j]) << 1) | 1)
+      | last_rd[j + 1];
+}
+
+
+/**
+ * A segment of a match_bitap window, computed on a pool thread.
+ */
+class BitapSegment : public QRunnable {
+ public:
+  BitapSegment(const QString &text, const QMap<QChar, int> &s, int d,
+               int first, int last, int warmup, int *rd, const int *last_rd,
+               QSemaphore &done) :
+    text(text), s(s), d(d), first(first), last(last), warmup(warmup), rd(rd),
+    last_rd(last_rd), done(done) {
+  }
+
+  void run() {
+    // Start as at the end of the window and run in over the overlap;
+    // rd is only written inside the segment.
+    int state = (1 << d) - 1;
+    for (int j = warmup; j >= first; j--) {
+      int charMatch;
+      if (text.length() <= j - 1) {
+        // Out of range.
+        charMatch = 0;
+      } else {
+        charMatch = s.value(text[j - 1], 0);
+      }
+      state = match_bitapStep(state, charMatch, last_rd, j);
+      if (j <= last) {
+        rd[j] = state;
+      }
+    }
+    done.release();
+  }
+
+ private:
+  const QString &text;
+  const QMap<QChar, int> &s;
+  const int d;
+  const int first;
+  const int last;
+  const int warmup;
+  int *rd;
+  const int *last_rd;
+  QSemaphore &done;
+};
+
+
 int diff_match_patch::match_bitap(const QString &text, const QString &pattern,
                                   int loc) {
   if (!(Match_MaxBits == 0 || pattern.length() <= Match_MaxBits)) {
@@ -1475,6 +5195,8 @@ int diff_match_patch::match_bitap(const QString &text, const QString &pattern,
   int matchmask = 1 << (pattern.length() - 1);
   best_loc = -1;
 
+  const int threads = Match_Threads > 0 ? Match_Threads
+      : QThread::idealThreadCount();
   int bin_min, bin_mid;
   int bin_max = pattern.length() + text.length();
   int *rd;
@@ -1501,22 +5223,23 @@ int diff_match_patch::match_bitap(const QString &text, const QString &pattern,
 
     rd = new int[finish + 2];
     rd[finish + 1] = (1 << d) - 1;
+    // On a wide window compute the whole state up front, in parallel.
+    const bool filled = threads > 1
+        && finish - start + 1 >= 2 * MATCH_SEGMENT_MIN;
+    if (filled) {
+      match_bitapParallel(text, s, d, pattern.length() + d, start, finish, rd,
+                          last_rd, threads);
+    }
     for (int j = finish; j >= start; j--) {
-      int charMatch;
-      if (text.length() <= j - 1) {
-        // Out of range.
-        charMatch = 0;
-      } else {
-        charMatch = s.value(text[j - 1], 0);
-      }
-      if (d == 0) {
-        // First pass: exact match.
-        rd[j] = ((rd[j + 1] << 1) | 1) & charMatch;
-      } else {
-        // Subsequent passes: fuzzy match.
-        rd[j] = ((rd[j + 1] << 1) | 1) & charMatch
-            | (((last_rd[j + 1] | last_rd[j]) << 1) | 1)
-            | last_rd[j + 1];
+      if (!filled) {
+        int charMatch;
+        if (text.length() <= j - 1) {
+          // Out of range.
+          charMatch = 0;
+        } else {
+          charMatch = s.value(text[j - 1], 0);
+        }
+        rd[j] = match_bitapStep(rd[j + 1], charMatch, last_rd, j);
       }
       if ((rd[j] & matchmask) != 0) {
         double score = match_bitapScore(d, j - 1, loc, pattern);
@@ -1549,6 +5272,34 @@ int diff_match_patch::match_bitap(const QString &text, const QString &pattern,
 }
 
 
+void diff_match_patch::match_bitapParallel(const QString &text,
+    const QMap<QChar, int> &s, int d, int overlap, int start, int finish,
+    int *rd, const int *last_rd, int threads) {
+  const int length = finish - start + 1;
+  const int segments = std::max(1, std::min(threads,
+                                            length / MATCH_SEGMENT_MIN));
+  QSemaphore done;
+  for (int x = 0; x < segments; x++) {
+    const int first = start + static_cast<int>(
+        static_cast<qint64>(length) * x / segments);
+    const int last = start + static_cast<int>(
+        static_cast<qint64>(length) * (x + 1) / segments) - 1;
+    const int warmup = std::min(finish, last + overlap);
+    BitapSegment *segment = new BitapSegment(text, s, d, first, last, warmup,
+                                             rd, last_rd, done);
+    // The rightmost segment starts from the real end of the window.  The
+    // others only go to the pool if a thread is free to take them now:
+    // called from a pool task, waiting on queued segments could deadlock.
+    if (warmup == finish
+        || !QThreadPool::globalInstance()->tryStart(segment)) {
+      segment->run();
+      delete segment;
+    }
+  }
+  done.acquire(segments);
+}
+
+
 double diff_match_patch::match_bitapScore(int e, int x, int loc,
                                           const QString &pattern) {
   const float accuracy = static_cast<float> (e) / pattern.length();
@@ -1590,6 +5341,7 @@ void diff_match_patch::patch_addContext(Patch &patch, const QString &text) {
   // matches are found, increase the pattern length.
   while (text.indexOf(pattern) != text.lastIndexOf(pattern)
       && pattern.length() < Match_MaxBits - Patch_Margin - Patch_Margin) {
+    DMP_WORK(WORK_CONTEXT, 2 * text.length());
     padding += Patch_Margin;
     pattern = safeMid(text, std::max(0, patch.start2 - padding),
         std::min(text.length(), patch.start2 + patch.length1 + padding)
@@ -1621,12 +5373,130 @@ void diff_match_patch::patch_addContext(Patch &patch, const QString &text) {
 }
 
 
+CostEstimate diff_match_patch::patch_estimateMake(const QString &text1,
+                                                  const QString &text2) {
+  // Check for null inputs.
+  if (text1.isNull() || text2.isNull()) {
+    throw "Null inputs. (patch_estimateMake)";
+  }
+
+  CostEstimate estimate = diff_estimate(text1, text2, true);
+  if (estimate.strategy == STRATEGY_NONE) {
+    return estimate;
+  }
+  const double scanCost = Diff_ScanCost > 0 ? Diff_ScanCost : DEFAULT_SCAN_COST;
+  // Each completed patch rebuilds the rolling postpatch text, and the
+  // cleanup passes walk the diff a few times.
+  const double lines = estimate.features.lines1 + estimate.features.lines2;
+  const double hunks = std::max(1.0, std::min(
+      static_cast<double>(estimate.edits),
+      estimate.features.uniqueLineRatio * lines / 2));
+  estimate.seconds += scanCost * (text1.length() + text2.length())
+      * (hunks + 4);
+  // Pre and post patch texts, plus the patch list.
+  estimate.bytes += static_cast<qint64>(
+      2 * sizeof(QChar) * (text1.length() + text2.length())
+      + hunks * (sizeof(Patch) + 2 * Patch_Margin * sizeof(QChar)));
+  return estimate;
+}
+
+
+CostEstimate diff_match_patch::patch_estimateApply(
+    const QList<Patch> &patches, const QString &text) {
+  // Check for null inputs.
+  if (text.isNull()) {
+    throw "Null inputs. (patch_estimateApply)";
+  }
+
+  CostEstimate estimate;
+  estimate.features.length1 = text.length();
+  estimate.features.length2 = text.length();
+  estimate.bytes = 2 * sizeof(QChar) * text.length();
+  if (patches.isEmpty()) {
+    return estimate;
+  }
+  const double scanCost = Diff_ScanCost > 0 ? Diff_ScanCost : DEFAULT_SCAN_COST;
+  const double bisectCost = Diff_BisectCost > 0
+      ? Diff_BisectCost : DEFAULT_BISECT_COST;
+  // How far from the expected location match_bitap will search.
+  const int window = Match_Distance == 0 ? 0
+      : static_cast<int>(Match_Threshold * Match_Distance);
+
+  estimate.strategy = STRATEGY_EXACT;
+  // Offset between patch coordinates and coordinates in the original text.
+  int shift = 0;
+  int exact = 0;
+  foreach(const Patch &aPatch, patches) {
+    const QString text1 = diff_text1(aPatch.diffs);
+    const int expected_loc = std::max(0, std::min(aPatch.start2 - shift,
+                                                  text.length()));
+    foreach(const Diff &aDiff, aPatch.diffs) {
+      if (aDiff.operation != EQUAL) {
+        estimate.edits += aDiff.text.length();
+      }
+    }
+    // Every applied patch rebuilds the text.
+    estimate.seconds += scanCost * (text.length() + text1.length());
+    if (safeMid(text, expected_loc, text1.length()) == text1) {
+      exact++;
+    } else {
+      estimate.strategy = STRATEGY_FUZZY;
+      // Each pattern of up to Match_MaxBits characters scans a window
+      // around its expected location once per allowed error.
+      const int bits = Match_MaxBits == 0
+          ? text1.length() : std::min(text1.length(), int(Match_MaxBits));
+      const int searches = text1.length() > Match_MaxBits && Match_MaxBits != 0
+          ? 2 : 1;
+      const int span = std::min(text.length(), 2 * window + bits);
+      estimate.seconds += searches * bisectCost * bits * span
+          + scanCost * text.length();
+      estimate.bytes = std::max(estimate.bytes, static_cast<qint64>(
+          2 * sizeof(QChar) * text.length()
+          + 2 * sizeof(int) * std::min(text.length(),
+                                       expected_loc + window + bits)));
+      // A fuzzy match is then diffed against the pattern.
+      estimate.seconds += bisectCost * 2 * text1.length() * std::max(1.0,
+          static_cast<double>(Patch_DeleteThreshold) * text1.length());
+    }
+    shift += aPatch.length2 - aPatch.length1;
+  }
+  estimate.features.length2 = text.length() + shift;
+  estimate.similarity = exact / static_cast<double>(patches.size());
+  return estimate;
+}
+
+
 QList<Patch> diff_match_patch::patch_make(const QString &text1,
                                           const QString &text2) {
   // Check for null inputs.
   if (text1.isNull() || text2.isNull()) {
     throw "Null inputs. (patch_make)";
   }
+  if (!Capture_File.isEmpty() && captureDepth == 0) {
+    // Time the call and keep it if it was slow.
+    const clock_t start = clock();
+    QList<Patch> patches;
+    captureDepth++;
+    try {
+      patches = patch_make(text1, text2);
+    } catch (...) {
+      captureDepth--;
+      throw;
+    }
+    captureDepth--;
+    const double seconds =
+        (clock() - start) / static_cast<double>(CLOCKS_PER_SEC);
+    if (seconds >= Capture_Threshold) {
+      CapturedCall call;
+      call.function = "patch_make";
+      call.seconds = seconds;
+      call.settings = capture_settings();
+      call.inputs << text1 << text2;
+      call.resultHash = qHash(patch_toText(patches));
+      capture_write(call);
+    }
+    return patches;
+  }
 
   // No diffs provided, compute our own.
   QList<Diff> diffs = diff_main(text1, text2, true);
@@ -1675,7 +5545,7 @@ QList<Patch> diff_match_patch::patch_make(const QString &text1,
   // context info.
   QString prepatch_text = text1;
   QString postpatch_text = text1;
-  foreach(Diff aDiff, diffs) {
+  foreach(const Diff &aDiff, diffs) {
     if (patch.diffs.isEmpty() && aDiff.operation != EQUAL) {
       // A new patch starts here.
       patch.start1 = char_count1;
@@ -1741,11 +5611,10 @@ QList<Patch> diff_match_patch::patch_make(const QString &text1,
 
 QList<Patch> diff_match_patch::patch_deepCopy(QList<Patch> &patches) {
   QList<Patch> patchesCopy;
-  foreach(Patch aPatch, patches) {
+  foreach(const Patch &aPatch, patches) {
     Patch patchCopy = Patch();
-    foreach(Diff aDiff, aPatch.diffs) {
-      Diff diffCopy = Diff(aDiff.operation, aDiff.text);
-      patchCopy.diffs.append(diffCopy);
+    foreach(const Diff &aDiff, aPatch.diffs) {
+      patchCopy.diffs.append(aDiff);
     }
     patchCopy.start1 = aPatch.start1;
     patchCopy.start2 = aPatch.start2;
@@ -1759,6 +5628,32 @@ QList<Patch> diff_match_patch::patch_deepCopy(QList<Patch> &patches) {
 
 QPair<QString, QVector<bool> > diff_match_patch::patch_apply(
     QList<Patch> &patches, const QString &sourceText) {
+  if (!Capture_File.isEmpty() && captureDepth == 0) {
+    // Time the call and keep it if it was slow.
+    const clock_t start = clock();
+    QPair<QString, QVector<bool> > result;
+    captureDepth++;
+    try {
+      result = patch_apply(patches, sourceText);
+    } catch (...) {
+      captureDepth--;
+      throw;
+    }
+    captureDepth--;
+    const double seconds =
+        (clock() - start) / static_cast<double>(CLOCKS_PER_SEC);
+    if (seconds >= Capture_Threshold) {
+      CapturedCall call;
+      call.function = "patch_apply";
+      call.seconds = seconds;
+      call.settings = capture_settings();
+      call.inputs << patch_toText(patches) << sourceText;
+      call.resultHash = qHash(captureResult(result));
+      capture_write(call);
+    }
+    return result;
+  }
+
   QString text = sourceText;  // Copy to preserve original.
   if (patches.isEmpty()) {
     return QPair<QString,QVector<bool> >(text, QVector<bool>(0));
@@ -1778,7 +5673,7 @@ QPair<QString, QVector<bool> > diff_match_patch::patch_apply(
   // has an effective expected position of 22.
   int delta = 0;
   QVector<bool> results(patchesCopy.size());
-  foreach(Patch aPatch, patchesCopy) {
+  foreach(const Patch &aPatch, patchesCopy) {
     int expected_loc = aPatch.start2 + delta;
     QString text1 = diff_text1(aPatch.diffs);
     int start_loc;
@@ -1820,18 +5715,19 @@ QPair<QString, QVector<bool> > diff_match_patch::patch_apply(
       } else {
         // Imperfect match.  Run a diff to get a framework of equivalent
         // indices.
-        QList<Diff> diffs = diff_main(text1, text2, false);
-        if (text1.length() > Match_MaxBits
-            && diff_levenshtein(diffs) / static_cast<float> (text1.length())
-            > Patch_DeleteThreshold) {
+        QList<Diff> diffs;
+        if (!patch_fuzzyDiff(text1, text2, diffs)) {
           // The end points match, but the content is unacceptably bad.
           results[x] = false;
         } else {
           diff_cleanupSemanticLossless(diffs);
+          // One view of the framework serves every diff_xIndex lookup.
+          CoreArray<CoreDiff> view;
+          coreDiffs(diffs, view);
           int index1 = 0;
-          foreach(Diff aDiff, aPatch.diffs) {
+          foreach(const Diff &aDiff, aPatch.diffs) {
             if (aDiff.operation != EQUAL) {
-              int index2 = diff_xIndex(diffs, index1);
+              int index2 = DiffCore::xIndex(view.data(), view.size(), index1);
               if (aDiff.operation == INSERT) {
                 // Insertion
                 text = text.left(start_loc + index2) + aDiff.text
@@ -1839,8 +5735,8 @@ QPair<QString, QVector<bool> > diff_match_patch::patch_apply(
               } else if (aDiff.operation == DELETE) {
                 // Deletion
                 text = text.left(start_loc + index2)
-                    + safeMid(text, start_loc + diff_xIndex(diffs,
-                    index1 + aDiff.text.length()));
+                    + safeMid(text, start_loc + DiffCore::xIndex(view.data(),
+                    view.size(), index1 + aDiff.text.length()));
               }
             }
             if (aDiff.operation != DELETE) {
@@ -1859,6 +5755,242 @@ QPair<QString, QVector<bool> > diff_match_patch::patch_apply(
 }
 
 
+bool diff_match_patch::patch_fuzzyDiff(const QString &text1,
+    const QString &text2, QList<Diff> &diffs) {
+  if (text1.length() > Match_MaxBits) {
+    // A diff's Levenshtein distance is at least half its inserted plus
+    // deleted characters, so a bounded diff which runs out of budget proves
+    // the threshold is exceeded without finishing a full diff.
+    if (qAbs(text1.length() - text2.length())
+        > Patch_DeleteThreshold * text1.length()) {
+      return false;
+    }
+    clock_t deadline;
+    if (Diff_Timeout <= 0) {
+      deadline = std::numeric_limits<clock_t>::max();
+    } else {
+      deadline = clock() + (clock_t)(Diff_Timeout * CLOCKS_PER_SEC);
+    }
+    QList<Diff> bounded;
+    const double budget = 2.0 * Patch_DeleteThreshold * text1.length();
+    const int maxEdits = static_cast<int>(std::min(budget,
+        static_cast<double>(text1.length() + text2.length())));
+    if (!diff_boundedMain(text1, text2, maxEdits, deadline, bounded)) {
+      // Out of budget, or out of time; a diff_main run after the timeout
+      // would only be cut short into a diff too coarse to accept.
+      return false;
+    }
+    diff_cleanupMerge(bounded);
+    diffs = bounded;
+  } else {
+    diffs = diff_main(text1, text2, false);
+  }
+  return text1.length() <= Match_MaxBits
+      || diff_levenshtein(diffs) / static_cast<float> (text1.length())
+      <= Patch_DeleteThreshold;
+}
+
+
+QVector<bool> diff_match_patch::patch_applyStream(QList<Patch> &patches,
+    QTextStream &input, QTextStream &output) {
+  // Characters read from the input at a time.
+  const int chunkSize = 65536;
+  if (patches.isEmpty()) {
+    while (!input.atEnd()) {
+      output << input.read(chunkSize);
+    }
+    return QVector<bool>(0);
+  }
+
+  // Deep copy the patches so that no changes are made to originals.
+  QList<Patch> patchesCopy = patch_deepCopy(patches);
+  const QString nullPadding = patch_addPadding(patchesCopy);
+  patch_splitMax(patchesCopy);
+
+  // How far from the expected location match_bitap can find a match.
+  int reach;
+  bool bounded = true;
+  if (Match_Distance == 0) {
+    reach = 0;
+    bounded = Match_Threshold < 1.0f;
+  } else {
+    reach = static_cast<int>(Match_Threshold * Match_Distance) + 1;
+  }
+  for (int x = 1; x < patchesCopy.size(); x++) {
+    if (patchesCopy[x].start2 < patchesCopy[x - 1].start2) {
+      bounded = false;
+    }
+  }
+  if (!bounded) {
+    // Matches may be anywhere, so the whole text is needed.
+    const QString text = input.readAll();
+    QPair<QString, QVector<bool> > results = patch_apply(patches, text);
+    output << results.first;
+    return results.second;
+  }
+  // How far behind the next expected location text is kept: matches of the
+  // previous patch and of the next one may each drift by the reach, and
+  // neighbouring patches may share their context.
+  const int lag = 2 * reach + 2 * Patch_Margin + Match_MaxBits;
+
+  // The text is padded on both ends, just like in patch_apply.  The buffer
+  // holds the text from position 'offset' on; everything before has been
+  // written, bar the leading padding.
+  QString buffer = nullPadding;
+  int offset = 0;
+  bool atEnd = false;
+  int x = 0;
+  int delta = 0;
+  QVector<bool> results(patchesCopy.size());
+  foreach(const Patch &aPatch, patchesCopy) {
+    int expected_loc = aPatch.start2 + delta;
+    QString text1 = diff_text1(aPatch.diffs);
+    // Load a window around the expected location.
+    const int windowStart = std::max(offset, expected_loc - reach);
+    const int windowEnd = expected_loc + 2 * text1.length() + reach
+        + Match_MaxBits + 1;
+    patch_streamFill(input, buffer, windowEnd - offset, nullPadding, atEnd);
+    const bool whole = atEnd && offset == 0 && windowStart == 0;
+    const QString window = safeMid(buffer, windowStart - offset);
+    const int loc = expected_loc - windowStart;
+
+    int start_loc;
+    int end_loc = -1;
+    if (text1.length() > Match_MaxBits) {
+      // patch_splitMax will only provide an oversized pattern in the case of
+      // a monster delete.
+      start_loc = patch_streamMatch(window, whole, text1.left(Match_MaxBits),
+                                    loc);
+      if (start_loc != -1) {
+        end_loc = patch_streamMatch(window, whole,
+            text1.right(Match_MaxBits), loc + text1.length() - Match_MaxBits);
+        if (end_loc == -1 || start_loc >= end_loc) {
+          // Can't find valid trailing context.  Drop this patch.
+          start_loc = -1;
+        } else {
+          end_loc += windowStart - offset;
+        }
+      }
+    } else {
+      start_loc = patch_streamMatch(window, whole, text1, loc);
+    }
+    if (start_loc == -1) {
+      // No match found.  :(
+      results[x] = false;
+      // Subtract the delta for this failed patch from subsequent patches.
+      delta -= aPatch.length2 - aPatch.length1;
+    } else {
+      // Found a match.  :)
+      results[x] = true;
+      delta = windowStart + start_loc - expected_loc;
+      // From here on, positions are relative to the buffer.
+      start_loc += windowStart - offset;
+      QString text2;
+      if (end_loc == -1) {
+        text2 = safeMid(buffer, start_loc, text1.length());
+      } else {
+        text2 = safeMid(buffer, start_loc, end_loc + Match_MaxBits - start_loc);
+      }
+      if (text1 == text2) {
+        // Perfect match, just shove the replacement text in.
+        buffer = buffer.left(start_loc) + diff_text2(aPatch.diffs)
+            + safeMid(buffer, start_loc + text1.length());
+      } else {
+        // Imperfect match.  Run a diff to get a framework of equivalent
+        // indices.
+        QList<Diff> diffs;
+        if (!patch_fuzzyDiff(text1, text2, diffs)) {
+          // The end points match, but the content is unacceptably bad.
+          results[x] = false;
+        } else {
+          diff_cleanupSemanticLossless(diffs);
+          // One view of the framework serves every diff_xIndex lookup.
+          CoreArray<CoreDiff> view;
+          coreDiffs(diffs, view);
+          int index1 = 0;
+          foreach(const Diff &aDiff, aPatch.diffs) {
+            if (aDiff.operation != EQUAL) {
+              int index2 = DiffCore::xIndex(view.data(), view.size(), index1);
+              if (aDiff.operation == INSERT) {
+                // Insertion
+                buffer = buffer.left(start_loc + index2) + aDiff.text
+                    + safeMid(buffer, start_loc + index2);
+              } else if (aDiff.operation == DELETE) {
+                // Deletion
+                buffer = buffer.left(start_loc + index2)
+                    + safeMid(buffer, start_loc + DiffCore::xIndex(view.data(),
+                    view.size(), index1 + aDiff.text.length()));
+              }
+            }
+            if (aDiff.operation != DELETE) {
+              index1 += aDiff.text.length();
+            }
+          }
+        }
+      }
+    }
+    x++;
+
+    // Write out the text which the next patch can no longer reach.
+    if (x < patchesCopy.size()) {
+      const int flush = std::min(buffer.length(),
+          patchesCopy[x].start2 + delta - lag - offset);
+      if (flush > 0) {
+        output << safeMid(buffer.left(flush),
+                          std::max(0, nullPadding.length() - offset));
+        buffer = safeMid(buffer, flush);
+        offset += flush;
+      }
+    }
+  }
+
+  // Copy the rest of the text, holding back what may be trailing padding.
+  while (true) {
+    patch_streamFill(input, buffer, buffer.length() + chunkSize, nullPadding,
+                     atEnd);
+    const int flush = buffer.length() - nullPadding.length();
+    if (atEnd || flush >= chunkSize) {
+      output << safeMid(buffer.left(std::max(0, flush)),
+                        std::max(0, nullPadding.length() - offset));
+      buffer = safeMid(buffer, std::max(0, flush));
+      offset += std::max(0, flush);
+    }
+    if (atEnd) {
+      break;
+    }
+  }
+  return results;
+}
+
+
+void diff_match_patch::patch_streamFill(QTextStream &input, QString &buffer,
+    int size, const QString &nullPadding, bool &atEnd) {
+  while (!atEnd && buffer.length() < size) {
+    if (input.atEnd()) {
+      buffer += nullPadding;
+      atEnd = true;
+    } else {
+      buffer += input.read(std::max(size - buffer.length(), 4096));
+    }
+  }
+}
+
+
+int diff_match_patch::patch_streamMatch(const QString &window, bool whole,
+                                        const QString &pattern, int loc) {
+  if (whole) {
+    return match_main(window, pattern, loc);
+  }
+  // As match_main, minus the shortcuts which look at the whole text.
+  loc = std::max(0, std::min(loc, window.length()));
+  if (loc + pattern.length() <= window.length()
+      && safeMid(window, loc, pattern.length()) == pattern) {
+    return loc;
+  }
+  return match_bitap(window, pattern, loc);
+}
+
+
 QString diff_match_patch::patch_addPadding(QList<Patch> &patches) {
   short paddingLength = Patch_Margin;
   QString nullPadding = "";
@@ -1997,6 +6129,7 @@ void diff_match_patch::patch_splitMax(QList<Patch> &patches) {
       precontext = diff_text2(patch.diffs);
       precontext = safeMid(precontext, precontext.length() - Patch_Margin);
       // Append the end context for this patch.
+      DMP_WORK(WORK_SPLITMAX, 2 * diff_text1(bigpatch.diffs).length());
       if (diff_text1(bigpatch.diffs).length() > Patch_Margin) {
         postcontext = diff_text1(bigpatch.diffs).left(Patch_Margin);
       } else {
@@ -2021,15 +6154,179 @@ void diff_match_patch::patch_splitMax(QList<Patch> &patches) {
 }
 
 
+void diff_match_patch::patch_normalize(QList<Patch> &patches) {
+  // Insertion sort on location.  A patch which lies entirely before its
+  // predecessor commutes with it, one which overlaps or touches it is merged
+  // into it.
+  Patch merged;
+  for (int x = 1; x < patches.size(); x++) {
+    int y = x;
+    while (y > 0) {
+      Patch &previous = patches[y - 1];
+      const Patch &current = patches[y];
+      if (current.start2 + current.length1 < previous.start2) {
+        // Applying the current patch first shifts the previous one.
+        const int shift = current.length2 - current.length1;
+        previous.start1 += shift;
+        previous.start2 += shift;
+        patches.swap(y - 1, y);
+        y--;
+      } else if (patch_merge(previous, current, merged)
+          && (Match_MaxBits == 0 || merged.length1 <= Match_MaxBits
+          || previous.length1 > Match_MaxBits
+          || current.length1 > Match_MaxBits)) {
+        patches[y - 1] = merged;
+        patches.removeAt(y);
+        x--;
+        y--;
+      } else {
+        break;
+      }
+    }
+  }
+
+  // Drop patches which change nothing, including merges which cancel out.
+  QMutableListIterator<Patch> pointer(patches);
+  while (pointer.hasNext()) {
+    bool changes = false;
+    foreach(const Diff &aDiff, pointer.next().diffs) {
+      if (aDiff.operation != EQUAL) {
+        changes = true;
+        break;
+      }
+    }
+    if (!changes) {
+      pointer.remove();
+    }
+  }
+
+  if (Match_MaxBits != 0) {
+    patch_splitMax(patches);
+  }
+}
+
+
+bool diff_match_patch::patch_merge(const Patch &first, const Patch &second,
+                                   Patch &merged) {
+  // Both patches are located in the text between them: the first one
+  // produces [start1, end1) of it, the second one consumes [start2, end2).
+  const int start1 = first.start2;
+  const int end1 = first.start2 + first.length2;
+  const int start2 = second.start2;
+  const int end2 = second.start2 + second.length1;
+  if (start2 > end1 || end2 < start1) {
+    return false;
+  }
+
+  // Pad each patch with equalities so that both cover the same span.
+  const QString middle1 = diff_text2(first.diffs);
+  const QString middle2 = diff_text1(second.diffs);
+  QList<Diff> diffs1 = first.diffs;
+  QList<Diff> diffs2 = second.diffs;
+  if (start2 < start1) {
+    diffs1.prepend(Diff(EQUAL, middle2.left(start1 - start2)));
+  } else if (start1 < start2) {
+    diffs2.prepend(Diff(EQUAL, middle1.left(start2 - start1)));
+  }
+  if (end2 > end1) {
+    diffs1.append(Diff(EQUAL, safeMid(middle2, end1 - start2)));
+  } else if (end1 > end2) {
+    diffs2.append(Diff(EQUAL, safeMid(middle1, end2 - start1)));
+  }
+  if (diff_text2(diffs1) != diff_text1(diffs2)) {
+    return false;
+  }
+  // Empty diffs would leave one script to run out before the other.
+  for (int x = diffs1.size() - 1; x >= 0; x--) {
+    if (diffs1[x].text.isEmpty()) {
+      diffs1.removeAt(x);
+    }
+  }
+  for (int x = diffs2.size() - 1; x >= 0; x--) {
+    if (diffs2[x].text.isEmpty()) {
+      diffs2.removeAt(x);
+    }
+  }
+
+  // Walk both edit scripts over the text between them.
+  QList<Diff> diffs;
+  int index1 = 0;
+  int index2 = 0;
+  int offset1 = 0;
+  int offset2 = 0;
+  while (index1 < diffs1.size() || index2 < diffs2.size()) {
+    if (index1 < diffs1.size() && diffs1[index1].operation == DELETE) {
+      diffs.append(Diff(DELETE, safeMid(diffs1[index1].text, offset1)));
+      index1++;
+      offset1 = 0;
+      continue;
+    }
+    if (index2 < diffs2.size() && diffs2[index2].operation == INSERT) {
+      diffs.append(Diff(INSERT, safeMid(diffs2[index2].text, offset2)));
+      index2++;
+      offset2 = 0;
+      continue;
+    }
+    if (index1 == diffs1.size() || index2 == diffs2.size()) {
+      // The texts matched, so only a malformed diff gets here.
+      return false;
+    }
+    // Both scripts consume the same text here.
+    const Diff &diff1 = diffs1[index1];
+    const Diff &diff2 = diffs2[index2];
+    const int length = std::min(diff1.text.length() - offset1,
+                                diff2.text.length() - offset2);
+    const QString text = diff1.text.mid(offset1, length);
+    if (diff1.operation == EQUAL) {
+      diffs.append(Diff(diff2.operation, text));
+    } else if (diff2.operation == EQUAL) {
+      diffs.append(Diff(INSERT, text));
+    }
+    // else: inserted by the first patch, deleted by the second one.
+    offset1 += length;
+    offset2 += length;
+    if (offset1 == diff1.text.length()) {
+      index1++;
+      offset1 = 0;
+    }
+    if (offset2 == diff2.text.length()) {
+      index2++;
+      offset2 = 0;
+    }
+  }
+  diff_cleanupMerge(diffs);
+
+  merged = Patch();
+  merged.diffs = diffs;
+  merged.start1 = first.start1 + std::min(start1, start2) - first.start2;
+  merged.start2 = std::min(start1, start2);
+  merged.length1 = diff_text1(diffs).length();
+  merged.length2 = diff_text2(diffs).length();
+  return true;
+}
+
+
 QString diff_match_patch::patch_toText(const QList<Patch> &patches) {
   QString text;
-  foreach(Patch aPatch, patches) {
+  foreach(const Patch &aPatch, patches) {
     text.append(aPatch.toString());
   }
   return text;
 }
 
 
+QList<Patch> diff_match_patch::patch_fromUnifiedDiff(const QString &diff,
+                                                     const QString &text1) {
+  QString input = diff;
+  QTextStream stream(&input, QIODevice::ReadOnly);
+  UnifiedDiffReader reader(stream);
+  if (!reader.next()) {
+    return QList<Patch>();
+  }
+  return reader.patches(text1);
+}
+
+
 QList<Patch> diff_match_patch::patch_fromText(const QString &textline) {
   QList<Patch> patches;
   if (textline.isEmpty()) {
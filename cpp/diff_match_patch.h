@@ -19,6 +19,8 @@
 #ifndef DIFF_MATCH_PATCH_H
 #define DIFF_MATCH_PATCH_H
 
+#include "diff_match_patch_core.h"
+
 /*
  * Functions for diff, match and patch.
  * Computes the difference between two texts to create a patch.
@@ -57,15 +59,22 @@
  */
 
 
-/**-
-* The data structure representing a diff is a Linked list of Diff objects:
-* {Diff(Operation.DELETE, "Hello"), Diff(Operation.INSERT, "Goodbye"),
-*  Diff(Operation.EQUAL, " world.")}
-* which means: delete "Hello", add "Goodbye" and keep " world."
-*/
-enum Operation {
-  DELETE, INSERT, EQUAL
+#ifdef DMP_WORK_COUNTERS
+/**
+ * Hot paths whose work grows faster than their input on some texts.  Builds
+ * defining DMP_WORK_COUNTERS (such as perffuzz) count the characters
+ * scanned or the steps taken by each in diff_match_patch::workCounters.
+ */
+enum WorkCounter {
+  WORK_BISECT,     // Diagonals explored by diff_bisect.
+  WORK_HALFMATCH,  // Characters compared by diff_halfMatchI.
+  WORK_CLEANUP,    // Diffs visited by diff_cleanupSemantic.
+  WORK_OVERLAP,    // Characters searched by diff_commonOverlap.
+  WORK_CONTEXT,    // Characters searched by patch_addContext.
+  WORK_SPLITMAX,   // Characters rebuilt by patch_splitMax.
+  WORK_COUNTERS
 };
+#endif
 
 
 /**
@@ -110,7 +119,802 @@ class Patch {
    */
   Patch();
   bool isNull() const;
-  QString toString();
+  QString toString() const;
+};
+
+
+/**
+ * Measurable characteristics of a pair of texts.
+ * Used by the strategy cost model in diff_compute.
+ */
+class DiffFeatures {
+ public:
+  int length1;
+  int length2;
+  int lines1;
+  int lines2;
+  // Average number of characters per line over both texts.
+  double avgLineLength;
+  // Fraction of lines (over both texts) which do not occur in the other text.
+  double uniqueLineRatio;
+
+  /**
+   * Constructor.  Initializes all features to zero.
+   */
+  DiffFeatures();
+  QString toString() const;
+};
+
+
+/**
+ * The strategies a diff or patch job is expected to take.
+ */
+enum Strategy {
+  // Texts are identical.
+  STRATEGY_NONE,
+  // After trimming the common prefix and suffix one text is empty.
+  STRATEGY_TRIVIAL,
+  // Line-level diff followed by a character-level rediff (diff_lineMode).
+  STRATEGY_LINEMODE,
+  // Character-level Myers diff (diff_bisect).
+  STRATEGY_BISECT,
+  // Every patch is found at its expected location.
+  STRATEGY_EXACT,
+  // At least one patch needs a fuzzy search (match_bitap).
+  STRATEGY_FUZZY
+};
+
+
+/**
+ * Predicted cost of a diff or patch job, computed without running it.
+ */
+class CostEstimate {
+ public:
+  Strategy strategy;
+  // Length of the common prefix and suffix which diff_main trims off.
+  int commonPrefix;
+  int commonSuffix;
+  // Features of the remaining middle block.
+  DiffFeatures features;
+  // Estimated fraction of content shared by both texts (0.0 - 1.0).
+  // For patch_apply, the fraction of patches which match exactly.
+  double similarity;
+  // Estimated number of edited characters.
+  int edits;
+  // Predicted wall time in seconds and peak working memory in bytes.
+  double seconds;
+  qint64 bytes;
+
+  /**
+   * Constructor.  Initializes an estimate for a no-op job.
+   */
+  CostEstimate();
+  QString toString() const;
+
+  static QString strStrategy(Strategy strategy);
+};
+
+
+/**
+ * In-memory index of MinHash sketches (see diff_match_patch::diff_sketch)
+ * for finding the stored texts most similar to a new one.  Sketches are
+ * split into bands; only texts which agree with the query on every slot of
+ * at least one band are scored.  The sketch of a text without tokens is
+ * similar to nothing, not even to another such sketch.
+ */
+class SketchIndex {
+ public:
+  /**
+   * Constructor.  Bands of four slots.
+   */
+  SketchIndex();
+
+  /**
+   * Constructor.
+   * @param bandSize Slots per band.  Larger bands find fewer, closer
+   *     candidates.
+   */
+  SketchIndex(int bandSize);
+
+  /**
+   * Add a sketch to the index, replacing any previous sketch for the key.
+   * Throws if the sketch is smaller than a band.
+   * @param key Identifier of the text.
+   * @param sketch Sketch of the text.
+   */
+  void insert(const QString &key, const QVector<uint> &sketch);
+
+  /**
+   * Remove a sketch from the index.
+   * @param key Identifier of the text.
+   * @return True if the key was present.
+   */
+  bool remove(const QString &key);
+
+  bool contains(const QString &key) const;
+  int size() const;
+
+  /**
+   * Find the stored texts most similar to the sketched one.
+   * @param sketch Sketch of the new text.
+   * @param count Maximum number of candidates to return.
+   * @return List of (key, estimated similarity) pairs, most similar first.
+   */
+  QList<QPair<QString, double> > nearest(const QVector<uint> &sketch,
+                                         int count) const;
+
+  /**
+   * Estimate the Jaccard similarity of two sketched texts.
+   * @param sketch1 First sketch.
+   * @param sketch2 Second sketch.
+   * @return Fraction of slots on which the sketches agree (0.0 - 1.0).
+   */
+  static double similarity(const QVector<uint> &sketch1,
+                           const QVector<uint> &sketch2);
+
+ private:
+  // True if the sketched text had no tokens, so every slot is still blank.
+  static bool isBlank(const QVector<uint> &sketch);
+  uint bandHash(const QVector<uint> &sketch, int band) const;
+
+  int bandSize;
+  QHash<QString, QVector<uint> > sketches;
+  // Keys of the texts in each (band, band hash) bucket.
+  QHash<QPair<int, uint>, QStringList> buckets;
+};
+
+
+/**
+ * One hit of a fuzzy search across a corpus (see
+ * diff_match_patch::match_corpus).
+ */
+class CorpusMatch {
+ public:
+  QString document;
+  int location;
+  // Score of the match (0.0 = good, 1.0 = bad).
+  double score;
+
+  /**
+   * Constructor.  Initializes a hit with the provided values.
+   * @param document Key of the document.
+   * @param location Index of the match in the document.
+   * @param score Score of the match.
+   */
+  CorpusMatch(const QString &document, int location, double score);
+  CorpusMatch();
+  QString toString() const;
+};
+
+
+/**
+ * In-memory index of q-gram postings over a corpus of documents, which
+ * proposes locations for a fuzzy search without scanning every document.
+ */
+class CorpusIndex {
+ public:
+  /**
+   * Constructor.  Indexes 3-grams.
+   */
+  CorpusIndex();
+
+  /**
+   * Constructor.
+   * @param q Length of the indexed q-grams.
+   */
+  CorpusIndex(int q);
+
+  /**
+   * Add a document to the index, replacing any previous one with the key.
+   * @param key Identifier of the document.
+   * @param text Text of the document.
+   */
+  void insert(const QString &key, const QString &text);
+
+  /**
+   * Remove a document from the index.
+   * @param key Identifier of the document.
+   * @return True if the key was present.
+   */
+  bool remove(const QString &key);
+
+  bool contains(const QString &key) const;
+  int size() const;
+  QString text(const QString &key) const;
+
+  /**
+   * Propose locations where the pattern may occur with up to the given
+   * number of errors.  A match with k errors contains one of k + 1 disjoint
+   * segments of the pattern exactly, so only the postings of the rarest
+   * q-gram of each segment are read.  When the segments would be shorter
+   * than a q-gram, as for a short pattern or a loose threshold, the index
+   * cannot rule out any location and every location of every document is
+   * proposed.  Locations of a document less than k apart are proposed once.
+   * @param pattern The pattern to search for.
+   * @param errors Maximum number of errors in a match.
+   * @return List of (document key, expected location) pairs.
+   */
+  QList<QPair<QString, int> > candidates(const QString &pattern,
+                                         int errors) const;
+
+ private:
+  uint qgramHash(const QString &text, int pos) const;
+
+  int q;
+  int nextId;
+  QHash<QString, int> ids;
+  QHash<int, QString> keys;
+  QHash<int, QString> texts;
+  // Positions of each q-gram in each document.
+  QHash<uint, QHash<int, QVector<int> > > postings;
+};
+
+
+/**
+ * A maximal run of insertions and deletions in a diff, for navigating
+ * between changes.
+ */
+class DiffHunk {
+ public:
+  // Index of the first diff of the hunk and number of diffs in it.
+  int firstDiff;
+  int diffCount;
+  int start1;
+  int length1;
+  int start2;
+  int length2;
+
+  DiffHunk();
+  QString toString() const;
+};
+
+
+/**
+ * Prefix sums over a diff list, so that a slice of a large diff can be
+ * located and rendered without walking the whole list.
+ */
+class DiffIndex {
+ public:
+  /**
+   * Constructor.  Indexes an empty diff.
+   */
+  DiffIndex();
+
+  /**
+   * Constructor.  Builds the index in one pass over the diffs.
+   * @param diffs LinkedList of Diff objects.
+   */
+  DiffIndex(const QList<Diff> &diffs);
+
+  const QList<Diff> &diffs() const;
+  const QList<DiffHunk> &hunks() const;
+
+  // Lengths of the source and destination texts.
+  int length1() const;
+  int length2() const;
+
+  // Offsets of a diff in the source and destination texts.
+  int start1(int diff) const;
+  int start2(int diff) const;
+
+  /**
+   * Find the first diff which touches a location in the destination text.
+   * A deletion touches the location where it was removed from.
+   * @param loc Location within text2.
+   * @return Index of the diff, or the number of diffs if there is none.
+   */
+  int diffAt(int loc) const;
+
+  /**
+   * Find the first hunk which ends at or after a location in the
+   * destination text.  The previous and next hunks are its neighbours.
+   * @param loc Location within text2.
+   * @return Index of the hunk, or the number of hunks if there is none.
+   */
+  int hunkAt(int loc) const;
+
+ private:
+  QList<Diff> diffList;
+  QList<DiffHunk> hunkList;
+  // starts1[x] and starts2[x] are the offsets of diff x; the last entries
+  // are the text lengths.
+  QVector<int> starts1;
+  QVector<int> starts2;
+};
+
+
+/**
+ * One row of an N-way alignment (see diff_match_patch::diff_align): a run
+ * of the base text, or an insertion between two base characters, and what
+ * each variant has in its place.
+ */
+class AlignedRow {
+ public:
+  // Offset of the row in the base text.
+  int start;
+  // Text of the base; empty for a row which only some variants insert.
+  QString base;
+  // Text of each variant in place of the base.
+  QStringList variants;
+  // Whether each variant differs from the base in this row.
+  QVector<bool> changed;
+
+  AlignedRow();
+  // True if any variant differs from the base in this row.
+  bool isChanged() const;
+  QString toString() const;
+};
+
+
+/**
+ * Merkle tree over the content-defined chunks of a document.  Chunk
+ * boundaries depend only on the text near them, so an edit disturbs the
+ * chunks around it and the tree nodes above those, while the rest of the
+ * tree is shared with the previous version.
+ */
+class ChunkTree {
+ public:
+  /**
+   * Constructor.  Builds the tree of an empty text.
+   */
+  ChunkTree();
+
+  /**
+   * Constructor.  Chunks the text with a typical chunk size of 1024.
+   * @param text Text of the document.
+   */
+  ChunkTree(const QString &text);
+
+  /**
+   * Constructor.
+   * @param text Text of the document.
+   * @param chunkSize Typical length of a chunk.
+   */
+  ChunkTree(const QString &text, int chunkSize);
+
+  const QString &text() const;
+  int chunkSize() const;
+  int chunkCount() const;
+  // Hash of the whole document.
+  quint64 hash() const;
+
+  /**
+   * Bring the tree up to date with an edit of its text.  Only chunks
+   * touched by the edit are scanned again; the others are reused until the
+   * chunk boundaries fall back into step.
+   * @param diffs LinkedList of Diff objects from the current text to the
+   *     new text.
+   */
+  void update(const QList<Diff> &diffs);
+
+  /**
+   * Find the regions where two versions differ, descending only into the
+   * subtrees whose hashes disagree.
+   * @param other Tree of the other version, built with the same chunk size.
+   * @return List of DiffHunk objects with the offsets and lengths of each
+   *     region in this text and the other text (firstDiff and diffCount
+   *     are zero).
+   */
+  QList<DiffHunk> changes(const ChunkTree &other) const;
+
+  /**
+   * Serialize the tree.  Only the chunk lengths and hashes are saved; the
+   * text is stored elsewhere.
+   * @return Text representation of the chunks.
+   */
+  QString toText() const;
+
+  /**
+   * Restore a tree saved by toText without scanning the text.
+   * @param data Text representation of the chunks.
+   * @param text Text of the document the tree was saved with.
+   * @return The tree.
+   * @throws QString If invalid input or if it does not fit the text.
+   */
+  static ChunkTree fromText(const QString &data, const QString &text);
+
+ private:
+  // A chunk (level 0) or a run of nodes of the level below.
+  struct Node {
+    quint64 hash;
+    int level;
+    int start;
+    int length;
+    int firstChild;
+    int childCount;
+  };
+
+  int chunkEnd(int start) const;
+  quint64 chunkHash(int start, int length) const;
+  void addChunk(int start, int length, quint64 hash);
+  void buildLevels();
+  void expand(QVector<Node> &nodes, int level) const;
+  void localize(const ChunkTree &other, const QVector<Node> &nodes1,
+                const QVector<Node> &nodes2, int start1, int start2,
+                QList<DiffHunk> &regions) const;
+
+  QString content;
+  int size;
+  // levels[0] holds the chunks, the last level holds the root.
+  QVector<QVector<Node> > levels;
+};
+
+
+/**
+ * Reads a unified diff, as written by git diff or diff -u, one file at a
+ * time.  Hunks are kept in line numbers until patches() is given the old
+ * text, so a large multi-file diff never has to be held in memory.
+ */
+class UnifiedDiffReader {
+ public:
+  /**
+   * Constructor.
+   * @param input Stream to read the diff from.
+   */
+  UnifiedDiffReader(QTextStream &input);
+
+  /**
+   * Read the headers and hunks of the next file.  Hunks with no file
+   * header (a bare list of hunks) count as one file.
+   * @return False if there are no more files.
+   * @throws QString If a hunk is malformed.
+   */
+  bool next();
+
+  // Paths from the ---/+++ headers (or the diff --git line), as written.
+  QString oldPath() const;
+  QString newPath() const;
+  int hunkCount() const;
+
+  /**
+   * Convert the hunks of the current file into patches, with line numbers
+   * converted to character offsets in the old text and context lines as
+   * equalities.
+   * @param text1 Old text of the file.
+   * @return List of Patch objects.
+   */
+  QList<Patch> patches(const QString &text1) const;
+
+ private:
+  bool readLine(QString &line);
+  void unreadLine(const QString &line);
+  void readHunk(const QString &header);
+
+  QTextStream &input;
+  // Read ahead of the current line.
+  QString buffer;
+  QString pending;
+  bool hasPending;
+  QString path1;
+  QString path2;
+  // Hunks with start1 and start2 as 0-based line numbers.
+  QList<Patch> hunks;
+};
+
+
+/**
+ * A slow call to diff_main, patch_make or patch_apply, as recorded by the
+ * capture hook
+ * (see diff_match_patch::Capture_File).
+ */
+class CapturedCall {
+ public:
+  // "diff_main", "patch_make" or "patch_apply".
+  QString function;
+  // Seconds the call took when it was captured.
+  double seconds;
+  // Hash of the result, to tell whether a replay behaves the same.
+  uint resultHash;
+  // Settings of the instance, as key=value pairs joined with '&'.
+  QString settings;
+  // Arguments of the call.  diff_main: checklines ("1" or "0"), text1 and
+  // the delta of the result (see diff_toDelta), from which text2 follows.
+  // patch_make: text1 and text2.
+  // patch_apply: the patches (see patch_toText) and the text.
+  QStringList inputs;
+
+  CapturedCall();
+
+  /**
+   * Encode the call as one line of a capture file.
+   * @return Tab-separated, percent-encoded fields.
+   */
+  QString toString() const;
+
+  /**
+   * Decode a line of a capture file.
+   * @param line Line written by toString.
+   * @return The call.
+   * @throws QString If invalid input.
+   */
+  static CapturedCall fromString(const QString &line);
+};
+
+
+class diff_match_patch;
+
+/**
+ * A diff of texts that arrive in chunks, such as uploads.  As data arrives
+ * the common prefix is committed, and the lines of text2 are matched
+ * against lines that occur only once in the part of text1 seen so far,
+ * again each time more of text1 arrives.  Each such anchor closes a
+ * region: it is diffed and committed at once, and can no longer change.
+ * Only what follows the last anchor is left for when the inputs end.
+ * Committed regions are never revisited, so the result can differ from
+ * diff_main on the whole texts, but text1 and text2 always follow from it.
+ */
+class StreamingDiff {
+ public:
+  /**
+   * Constructor for a diff where both texts arrive in chunks.
+   * @param dmp Instance whose settings and diff_main are used.  It has to
+   *     outlive the stream.
+   */
+  explicit StreamingDiff(diff_match_patch &dmp);
+
+  /**
+   * Constructor for a diff where only text2 arrives in chunks.
+   * @param dmp Instance whose settings and diff_main are used.  It has to
+   *     outlive the stream.
+   * @param text1 The whole old text.
+   */
+  StreamingDiff(diff_match_patch &dmp, const QString &text1);
+
+  /**
+   * Add a chunk to the old text, and commit whatever it settles.
+   * @param chunk Next part of text1.
+   */
+  void append1(const QString &chunk);
+
+  /**
+   * Add a chunk to the new text, and commit whatever it settles.
+   * @param chunk Next part of text2.
+   */
+  void append2(const QString &chunk);
+
+  /**
+   * Mark the end of the old text.  Once both texts have ended, the rest
+   * of the diff is committed.
+   */
+  void finish1();
+
+  /**
+   * Mark the end of the new text.  Once both texts have ended, the rest
+   * of the diff is committed.
+   */
+  void finish2();
+
+  /**
+   * Take the diffs committed since the last call.  Concatenated in order,
+   * the taken diffs make up the whole diff.
+   * @return LinkedList of Diff objects.
+   */
+  QList<Diff> takeDiffs();
+
+  // True once both texts have ended and everything is committed.
+  bool isFinished() const;
+  // Characters of text1 and text2 covered by the committed diffs.
+  int committed1() const;
+  int committed2() const;
+
+ private:
+  void indexLines();
+  void advance();
+  bool findAnchor(int &start1, int &start2, int &length);
+  void commit(const QList<Diff> &diffs);
+
+  diff_match_patch &dmp;
+  QString text1;
+  QString text2;
+  bool finished1;
+  bool finished2;
+  int done1;
+  int done2;
+  // Start of the first line of text1 not yet indexed, and of the first
+  // line of text2 not yet tried as an anchor.
+  int indexed1;
+  int scanned2;
+  // Start of each line of text1, and how often each line occurs.
+  QHash<QString, int> lineStarts1;
+  QHash<QString, int> lineCounts1;
+  QList<Diff> pending;
+};
+
+
+/**
+ * A run of line-mode diffs over successive versions of one document:
+ * v1 to v2, v2 to v3, and so on.  The tokens of the latest version and the
+ * table of lines are kept from one diff to the next, so each new version
+ * is tokenized once, against the lines already known.
+ */
+class DiffSession {
+ public:
+  /**
+   * Constructor.
+   * @param dmp Instance whose settings are used.  It has to outlive the
+   *     session.
+   * @param text First version of the document.
+   */
+  DiffSession(diff_match_patch &dmp, const QString &text);
+
+  /**
+   * Diff the latest version against the next one, which then becomes the
+   * latest.  Two versions with more than 65535 distinct lines between them
+   * get a character diff instead.
+   * @param text Next version of the document.
+   * @return Linked List of Diff objects.
+   */
+  QList<Diff> next(const QString &text);
+
+  // Latest version of the document.
+  QString text() const;
+  // Number of distinct lines known to the session.
+  int lineCount() const;
+
+ private:
+  void reset();
+
+  diff_match_patch &dmp;
+  QString latest;
+  // Tokens of the latest version (see diff_linesToChars).
+  QString latestChars;
+  QStringList lineArray;
+  QMap<QString, int> lineHash;
+};
+
+
+/**
+ * Adaptive probabilities for the compressed delta format, kept in step by
+ * DeltaEncoder and DeltaDecoder.  Each is the 12-bit chance of a 0 bit.
+ * The low byte of an inserted character mixes four predictions: the byte
+ * alone, after the previous character, after the previous two, and the
+ * character which followed the last occurrence of the previous five in the
+ * inserted text so far.
+ */
+class DeltaModel {
+ public:
+  DeltaModel();
+
+  /**
+   * Predict the next bit of the low byte of a character.
+   * @param node The bits of the byte so far, after a leading 1.
+   * @return 12-bit chance of a 0 bit.
+   */
+  int predictLow(int node);
+
+  /**
+   * Learn from the bit that followed the last predictLow.
+   * @param bit The bit.
+   */
+  void updateLow(int bit);
+
+  /**
+   * Make a character the context of the next one.
+   * @param c The character just coded.
+   */
+  void pushChar(ushort c);
+
+  // Operation (DELETE, INSERT, EQUAL or end), given the previous one.
+  quint16 ops[4][4];
+  // Bit count of a length plus one, given the operation.
+  quint16 lengthBits[3][32];
+  // Top four bits below the leading one, given the operation and bit count.
+  quint16 lengthMantissa[3][32][16];
+  // Whether a character shares its high byte with the previous one.
+  quint16 charSame[2];
+  quint16 charHigh[256];
+  int lastOp;
+  ushort lastChar;
+
+ private:
+  ushort lastChar2;
+  // Low byte alone, after the previous low byte, and after a hash of the
+  // previous two characters.
+  QVector<quint16> lowOrder0;
+  QVector<quint16> lowOrder1;
+  QVector<quint16> lowOrder2;
+  // Inserted text so far, where in it each hash of five characters last
+  // ended, and the current match: where it continues and for how long it
+  // has held.  Chance that the match predicts a bit right, by its length.
+  QVector<ushort> history;
+  QVector<int> matchTable;
+  int matchPointer;
+  int matchLength;
+  quint16 matchRight[16];
+  // Weights of the four predictions, one set per node with and without a
+  // match.
+  QVector<int> weights;
+  // State of the last prediction.
+  quint16 *slots[4];
+  int stretched[4];
+  int expectedBit;
+  int *weightSet;
+  int mixed;
+};
+
+
+/**
+ * Writes a diff as a compressed delta: a binary form of diff_toDelta in
+ * which operations, lengths and inserted characters go through a range
+ * coder with adaptive models.  The output is a "DMPZ" header and version
+ * byte followed by the coded operations, closed by an end marker.
+ */
+class DeltaEncoder {
+ public:
+  /**
+   * Constructor.  Writes the header.
+   * @param output Device receiving the compressed delta.
+   */
+  DeltaEncoder(QIODevice &output);
+
+  /**
+   * Append one operation.  Equalities and deletions only record their
+   * length, as in diff_toDelta.
+   * @param aDiff Diff object.
+   */
+  void write(const Diff &aDiff);
+
+  /**
+   * Write the end marker and flush the coder.  Nothing can be written after.
+   */
+  void finish();
+
+ private:
+  void encode(int prob, int bit);
+  void encodeBit(quint16 &prob, int bit);
+  void encodeDirect(int bit);
+  void encodeTree(quint16 *probs, int bits, int value);
+  void encodeLength(int op, int length);
+  void shiftLow();
+
+  QIODevice &output;
+  QByteArray pending;
+  quint64 low;
+  quint32 range;
+  uchar cache;
+  qint64 cacheSize;
+  DeltaModel model;
+  bool finished;
+};
+
+
+/**
+ * Reads a compressed delta written by DeltaEncoder, one operation at a
+ * time.  Bytes are taken from the device only as the coder needs them, so
+ * anything following the delta is left unread.
+ */
+class DeltaDecoder {
+ public:
+  /**
+   * Constructor.  Reads the header.
+   * @param input Device holding the compressed delta.
+   * @throws QString If the header is not that of a compressed delta.
+   */
+  DeltaDecoder(QIODevice &input);
+
+  /**
+   * Read the next operation.
+   * @param op Set to the operation.
+   * @param length Set to the number of characters it covers.
+   * @param text Set to the inserted text for an insertion, else cleared.
+   * @return False once the end marker has been read.
+   * @throws QString If the delta is truncated or malformed.
+   */
+  bool read(Operation &op, int &length, QString &text);
+
+ private:
+  int decode(int prob);
+  int decodeBit(quint16 &prob);
+  int decodeDirect();
+  int decodeTree(quint16 *probs, int bits);
+  int decodeLength(int op);
+  uchar nextByte();
+
+  QIODevice &input;
+  quint32 range;
+  quint32 code;
+  DeltaModel model;
+  bool finished;
 };
 
 
@@ -121,6 +925,8 @@ class Patch {
 class diff_match_patch {
 
   friend class diff_match_patch_test;
+  friend class DiffSession;
+  friend class AlignVariant;
 
  public:
   // Defaults.
@@ -147,11 +953,49 @@ class diff_match_patch {
   // The number of bits in an int.
   short Match_MaxBits;
 
+  // Both texts must be longer than this before a line-level diff is tried.
+  int Diff_LineModeThreshold;
+  // Number of seeds tried by the half-match speedup (2 = quarter and half).
+  short Diff_HalfMatchSeeds;
+  // Cost model for choosing between a line-level and a character-level diff.
+  // Seconds per character tokenized by diff_linesToChars.
+  // 0 means uncalibrated: line mode is used whenever the threshold is met.
+  double Diff_TokenCost;
+  // Seconds per (character x edit) spent in diff_bisect.
+  double Diff_BisectCost;
+  // Seconds per character copied or scanned by a linear string operation.
+  double Diff_ScanCost;
+
+  // Number of MinHash values in a sketch made by diff_sketch.
+  short Sketch_Size;
+
+  // Threads used by match_bitap on wide search windows (0 = one per core,
+  // 1 = serial).
+  short Match_Threads;
+  // Threads used by diff_linesToChars on large texts (0 = one per core,
+  // 1 = serial).
+  short Diff_Threads;
+
+  // File to which calls of diff_main, patch_make and patch_apply slower than
+  // Capture_Threshold seconds are appended, for replay with capture_replay.
+  // Empty (the default) turns capture off.
+  QString Capture_File;
+  float Capture_Threshold;
+
+#ifdef DMP_WORK_COUNTERS
+  // Work done on each hot path since the counters were last cleared.
+  // Shared by all instances and not thread safe: count with one thread.
+  static quint64 workCounters[WORK_COUNTERS];
+#endif
+
  private:
   // Define some regex patterns for matching boundaries.
   static QRegExp BLANKLINEEND;
   static QRegExp BLANKLINESTART;
 
+  // Nesting of captured calls; only the outermost is recorded.
+  int captureDepth;
+
 
  public:
 
@@ -180,22 +1024,97 @@ class diff_match_patch {
    *     If true, then run a faster slightly less optimal diff.
    * @return Linked List of Diff objects.
    */
-  QList<Diff> diff_main(const QString &text1, const QString &text2, bool checklines);
+  QList<Diff> diff_main(const QString &text1, const QString &text2, bool checklines);
+
+  /**
+   * Find the differences between two texts.  Simplifies the problem by
+   * stripping any common prefix or suffix off the texts before diffing.
+   * @param text1 Old string to be diffed.
+   * @param text2 New string to be diffed.
+   * @param checklines Speedup flag.  If false, then don't run a
+   *     line-level diff first to identify the changed areas.
+   *     If true, then run a faster slightly less optimal diff.
+   * @param deadline Time when the diff should be complete by.  Used
+   *     internally for recursive calls.  Users should set DiffTimeout instead.
+   * @return Linked List of Diff objects.
+   */
+ private:
+  QList<Diff> diff_main(const QString &text1, const QString &text2, bool checklines, clock_t deadline);
+
+  /**
+   * Find the differences between two texts if they are within an edit
+   * budget.  Edits are counted as inserted plus deleted characters, and
+   * only the diagonals reachable with that many edits are explored, so the
+   * cost is O((N+M)*maxEdits) whether or not the texts fit.  Within the
+   * budget the diff is minimal.  Diff_Timeout does not apply.
+   * @param text1 Old string to be diffed.
+   * @param text2 New string to be diffed.
+   * @param maxEdits Maximum number of inserted and deleted characters.
+   * @param diffs Set to the Linked List of Diff objects if within budget.
+   * @return True if the texts are within maxEdits of each other.
+   */
+ public:
+  bool diff_bounded(const QString &text1, const QString &text2, int maxEdits,
+                    QList<Diff> &diffs);
+
+  /**
+   * Recursive part of diff_bounded.  Strips any common prefix or suffix and
+   * appends the diff of the texts to the list.
+   * @param text1 Old string to be diffed.
+   * @param text2 New string to be diffed.
+   * @param maxEdits Maximum number of inserted and deleted characters.
+   * @param deadline Time at which to give up, counted as over budget.
+   * @param diffs LinkedList of Diff objects to append to.
+   * @return True if the texts are within maxEdits of each other.
+   */
+ private:
+  bool diff_boundedMain(const QString &text1, const QString &text2,
+                        int maxEdits, clock_t deadline, QList<Diff> &diffs);
+
+  /**
+   * Find the differences between two versions of a document, diffing only
+   * the regions where their chunk trees disagree.
+   * @param tree1 Chunk tree of the old version.
+   * @param tree2 Chunk tree of the new version.
+   * @return Linked List of Diff objects.
+   */
+ public:
+  QList<Diff> diff_chunked(const ChunkTree &tree1, const ChunkTree &tree2);
+
+  /**
+   * Find the differences between two large UTF-8 inputs with the stages of
+   * a line-mode diff running concurrently.  A reader thread decodes the
+   * inputs into lines while they are tokenized; once the token diff is
+   * done, replacement blocks are rediffed on the thread pool while the
+   * finished ones are collected in order.  The merged diff is then written
+   * out as a delta.  Diff_Timeout counts from the end of reading, and each
+   * rediff has a timeout of its own.  Inputs with more than 65535 unique
+   * lines get a character diff instead.
+   * @param input1 Old text, open for reading.
+   * @param input2 New text, open for reading.
+   * @param delta Stream receiving the diff in diff_toDelta format.
+   * @return Linked List of Diff objects.
+   */
+ public:
+  QList<Diff> diff_pipeline(QIODevice &input1, QIODevice &input2,
+                            QTextStream &delta);
 
   /**
-   * Find the differences between two texts.  Simplifies the problem by
-   * stripping any common prefix or suffix off the texts before diffing.
-   * @param text1 Old string to be diffed.
-   * @param text2 New string to be diffed.
-   * @param checklines Speedup flag.  If false, then don't run a
-   *     line-level diff first to identify the changed areas.
-   *     If true, then run a faster slightly less optimal diff.
-   * @param deadline Time when the diff should be complete by.  Used
-   *     internally for recursive calls.  Users should set DiffTimeout instead.
-   * @return Linked List of Diff objects.
+   * Align one base text against several variants of it, for a view with a
+   * column per variant.  The base is tokenized into lines once and the
+   * variants which get a line-level pass are tokenized against the same
+   * table; the variants are then diffed concurrently on the thread pool,
+   * and the edit scripts are merged in one sweep over the base.  A
+   * variant's insertion after a deletion shares the row of the end of the
+   * deletion; other insertions at the same base offset share a row.
+   * Diff_Timeout applies to each variant from the start of its own diff.
+   * @param base Text the variants are compared with.
+   * @param variants Texts to compare with the base.
+   * @return List of AlignedRow objects covering the base in order.
    */
- private:
-  QList<Diff> diff_main(const QString &text1, const QString &text2, bool checklines, clock_t deadline);
+ public:
+  QList<AlignedRow> diff_align(const QString &base,
+                               const QStringList &variants);
 
   /**
    * Find the differences between two texts.  Assumes that the texts do not
@@ -223,6 +1142,92 @@ class diff_match_patch {
  private:
   QList<Diff> diff_lineMode(QString text1, QString text2, clock_t deadline);
 
+  /**
+   * The part of diff_lineMode that follows tokenization: diff the tokens,
+   * clean up, then rediff the replacement blocks.
+   * @param chars1 Encoded old string (see diff_linesToChars).
+   * @param chars2 Encoded new string.
+   * @param lineArray List of unique strings, indexed by token.
+   * @param deadline Time when the diff should be complete by.
+   * @return Linked List of Diff objects.
+   */
+ private:
+  QList<Diff> diff_lineModeTokens(const QString &chars1, const QString &chars2,
+                                  const QStringList &lineArray,
+                                  clock_t deadline);
+
+  /**
+   * Find the differences between two comma separated tables whose lines are
+   * keyed on the first field.
+   * @param text1 Old table to be diffed.
+   * @param text2 New table to be diffed.
+   * @return Linked List of Diff objects.
+   */
+ public:
+  QList<Diff> diff_records(const QString &text1, const QString &text2);
+
+  /**
+   * Find the differences between two texts made of keyed records, such as
+   * CSV exports or config tables.  Records are matched on their key with a
+   * hash join instead of being aligned.  The most matched records which are
+   * in the same order in both texts are rediffed in place; records which
+   * moved are deleted from their old place and inserted at their new one,
+   * as are records which are gone or new.  diff_text1 of the result is
+   * text1 and diff_text2 is text2.
+   * @param text1 Old text to be diffed.
+   * @param text2 New text to be diffed.
+   * @param separator String which ends each record.
+   * @param keyPattern Regular expression finding the key of a record: its
+   *     first capture, or the whole match if it has none.  Records it does
+   *     not match are keyed on their whole contents.
+   * @param fieldSeparator String between the fields of a record.  Changed
+   *     records with the same number of fields are diffed field by field,
+   *     others character by character.  Empty for character diffs only.
+   * @return Linked List of Diff objects.
+   */
+ public:
+  QList<Diff> diff_records(const QString &text1, const QString &text2,
+                           const QString &separator,
+                           const QRegExp &keyPattern,
+                           const QString &fieldSeparator);
+
+  /**
+   * Diff two versions of a record.
+   * @param record1 Old record, without its separator.
+   * @param record2 New record, without its separator.
+   * @param fieldSeparator String between the fields of a record, or empty.
+   * @return Linked List of Diff objects.
+   */
+ private:
+  QList<Diff> diff_recordFields(const QString &record1,
+                                const QString &record2,
+                                const QString &fieldSeparator);
+
+  /**
+   * Decide whether a line-level diff is likely to be cheaper than a
+   * character-level diff.  Uses the cost model when it has been calibrated,
+   * otherwise only the length threshold.
+   * @param text1 Old string to be diffed.
+   * @param text2 New string to be diffed.
+   * @return True if diff_lineMode should be used.
+   */
+ private:
+  bool diff_useLineMode(const QString &text1, const QString &text2);
+
+  /**
+   * Predict the time of a diff strategy from the cost model.  Uncalibrated
+   * coefficients fall back to typical values.
+   * @param strategy STRATEGY_LINEMODE or STRATEGY_BISECT.
+   * @param features Features of the texts.
+   * @param edits Estimated number of edited characters.
+   * @param blockLength Typical length of a changed block which line mode
+   *     rediffs character by character.
+   * @return Predicted seconds.
+   */
+ private:
+  double diff_strategyCost(Strategy strategy, const DiffFeatures &features,
+                           double edits, double blockLength);
+
   /**
    * Find the 'middle snake' of a diff, split the problem in two
    * and return the recursively constructed diff.
@@ -234,6 +1239,21 @@ class diff_match_patch {
  protected:
   QList<Diff> diff_bisect(const QString &text1, const QString &text2, clock_t deadline);
 
+  /**
+   * Search for the 'middle snake' of a diff with a limited number of
+   * forward and reverse steps.
+   * @param text1 Old string to be diffed.
+   * @param text2 New string to be diffed.
+   * @param maxSteps Number of steps to take in each direction.
+   * @param deadline Time at which to bail if not yet complete.
+   * @param x Set to the index of the split point in text1.
+   * @param y Set to the index of the split point in text2.
+   * @return Edit distance of the texts, or -1 if not found in time.
+   */
+ private:
+  int diff_bisectSnake(const QString &text1, const QString &text2,
+                       int maxSteps, clock_t deadline, int &x, int &y);
+
   /**
    * Given the location of the 'middle snake', split the diff in two parts
    * and recurse.
@@ -271,6 +1291,22 @@ class diff_match_patch {
   QString diff_linesToCharsMunge(const QString &text, QStringList &lineArray,
                                  QMap<QString, int> &lineHash);
 
+  /**
+   * Split two texts into a list of strings, as diff_linesToChars does, on
+   * several threads.  Chunks of whole lines are tokenized concurrently,
+   * then the lines are interned on threads that each own a share of the
+   * hash values, and finally numbered in order of first occurrence, so
+   * that the result is the same as the serial one.
+   * @param text1 First string.
+   * @param text2 Second string.
+   * @param threads Number of threads to use.
+   * @return Three element Object array, containing the encoded text1, the
+   *     encoded text2 and the List of unique strings.
+   */
+ private:
+  QList<QVariant> diff_linesToCharsParallel(const QString &text1,
+                                            const QString &text2, int threads);
+
   /**
    * Rehydrate the text in a diff from a string of line hashes to real lines of
    * text.
@@ -280,6 +1316,163 @@ class diff_match_patch {
  private:
   void diff_charsToLines(QList<Diff> &diffs, const QStringList &lineArray);
 
+  /**
+   * Measure the features of two texts that drive the choice of diff strategy:
+   * lengths, line counts, average line length and unique-line ratio.
+   * @param text1 First string.
+   * @param text2 Second string.
+   * @return DiffFeatures object.
+   */
+ public:
+  DiffFeatures diff_features(const QString &text1, const QString &text2);
+
+  /**
+   * Estimate how similar two texts are without diffing them.  Compares a
+   * content-defined sample of the q-grams of each text.
+   * @param text1 First string.
+   * @param text2 Second string.
+   * @return Estimated fraction of shared content (0.0 - 1.0).
+   */
+ public:
+  double diff_similarity(const QString &text1, const QString &text2);
+
+  /**
+   * Predict the strategy, time and memory of diff_main without running it.
+   * Runs only linear passes: the prefix/suffix trim, line statistics and a
+   * sampled similarity estimate.
+   * @param text1 Old string to be diffed.
+   * @param text2 New string to be diffed.
+   * @return CostEstimate object.
+   */
+ public:
+  CostEstimate diff_estimate(const QString &text1, const QString &text2);
+
+  /**
+   * Predict the strategy, time and memory of diff_main without running it.
+   * @param text1 Old string to be diffed.
+   * @param text2 New string to be diffed.
+   * @param checklines Speedup flag, as passed to diff_main.
+   * @return CostEstimate object.
+   */
+ public:
+  CostEstimate diff_estimate(const QString &text1, const QString &text2,
+                             bool checklines);
+
+  /**
+   * Compute a MinHash sketch of the lines of a text.  The fraction of slots
+   * on which two sketches agree estimates the Jaccard similarity of the two
+   * sets of lines, so a SketchIndex of stored texts can pick the best base
+   * for diff_toDelta without diffing against every candidate.
+   * @param text Text to sketch.
+   * @return Sketch_Size hash values.
+   */
+ public:
+  QVector<uint> diff_sketch(const QString &text);
+
+  /**
+   * Compute a MinHash sketch of the lines or the words of a text.
+   * @param text Text to sketch.
+   * @param lines True to sketch lines, false to sketch whitespace separated
+   *     words.  Only sketches of the same kind may be compared.
+   * @return Sketch_Size hash values.
+   */
+ public:
+  QVector<uint> diff_sketch(const QString &text, bool lines);
+
+  /**
+   * Time the scanner, the line tokenizer and the character-level bisection
+   * on sample pairs of texts and set Diff_ScanCost, Diff_TokenCost and
+   * Diff_BisectCost accordingly.
+   * Intended to be driven by the speed test harness, then saved with
+   * profile_save.
+   * @param samples List of (old text, new text) pairs.
+   */
+ public:
+  void diff_calibrate(const QList<QPair<QString, QString> > &samples);
+
+  /**
+   * Load tuning settings (thresholds and cost model) from an INI file
+   * written by profile_save.  Keys which are missing keep their value.
+   * @param fileName Path of the profile.
+   * @return True if the file could be read.
+   */
+ public:
+  bool profile_load(const QString &fileName);
+
+  /**
+   * Save the tuning settings (thresholds and cost model) to an INI file.
+   * @param fileName Path of the profile.
+   * @return True if the file could be written.
+   */
+ public:
+  bool profile_save(const QString &fileName);
+
+  /**
+   * Read the calls recorded in a capture file.
+   * @param fileName Path of the capture file (see Capture_File).
+   * @return List of CapturedCall objects, empty if the file can't be read.
+   * @throws QString If a line is invalid.
+   */
+ public:
+  QList<CapturedCall> capture_load(const QString &fileName);
+
+  /**
+   * Run a captured call again.  The settings of this instance are replaced
+   * by those recorded with the call, and nothing is captured meanwhile.
+   * @param call The call.
+   * @param seconds Set to the seconds the call took.
+   * @return True if the result is the one which was captured.
+   */
+ public:
+  bool capture_replay(const CapturedCall &call, double &seconds);
+
+  /**
+   * Encode the settings of this instance for a CapturedCall.
+   * @return key=value pairs joined with '&'.
+   */
+ private:
+  QString capture_settings();
+
+  /**
+   * Restore settings encoded by capture_settings.  Unknown keys are
+   * ignored.
+   * @param settings key=value pairs joined with '&'.
+   */
+ private:
+  void capture_loadSettings(const QString &settings);
+
+  /**
+   * Append a call to Capture_File.
+   * @param call The call.
+   */
+ private:
+  void capture_write(const CapturedCall &call);
+
+  /**
+   * Name the CPU kernels in use for the innermost loops (common prefix and
+   * suffix, snakes of diff_bisect, line scanning).  The widest variant the
+   * CPU supports is picked when the library is loaded.
+   * @return "scalar", "sse4.2", "avx2" or "avx512".
+   */
+ public:
+  static QString kernel_variant();
+
+  /**
+   * List the kernel variants this CPU can run.
+   * @return Names as for kernel_variant, plainest first.
+   */
+ public:
+  static QStringList kernel_variants();
+
+  /**
+   * Switch every instance over to another kernel variant, e.g. to compare
+   * them.  Not safe while other threads are diffing.
+   * @param variant Name as for kernel_variant.
+   * @return False if this CPU can't run the variant.
+   */
+ public:
+  static bool kernel_select(const QString &variant);
+
   /**
    * Determine the common prefix of two strings.
    * @param text1 First string.
@@ -361,6 +1554,70 @@ class diff_match_patch {
  private:
   int diff_cleanupSemanticScore(const QString &one, const QString &two);
 
+  /**
+   * Reduce the number of edits by eliminating semantically trivial equalities
+   * in a diff of line tokens, before it is converted back to text.  Each
+   * token counts for the length of its line, and edits are only shifted by
+   * whole lines.
+   * @param diffs LinkedList of Diff objects whose text is encoded as tokens.
+   * @param lineArray List of unique strings, indexed by token.
+   */
+ private:
+  void diff_cleanupSemanticTokens(QList<Diff> &diffs,
+                                  const QStringList &lineArray);
+
+  /**
+   * Eliminate equalities which are no longer than the edits on both sides of
+   * them, turning each into a deletion and an insertion.  The shared first
+   * pass of diff_cleanupSemantic and diff_cleanupSemanticTokens.
+   * @param diffs LinkedList of Diff objects.
+   * @param lineArray List of unique strings indexed by token, if the text of
+   *     the diffs is encoded as tokens, so that each token counts for the
+   *     length of its line.  NULL for text.
+   * @return True if any equality was eliminated.  The diffs then need
+   *     diff_cleanupMerge.
+   */
+ private:
+  bool diff_cleanupSemanticEqualities(QList<Diff> &diffs,
+                                      const QStringList *lineArray);
+
+  /**
+   * Shift single edits surrounded by equalities sideways to the best
+   * boundary, as diff_cleanupSemanticLossless.  Diffs of tokens are only
+   * shifted by whole lines.
+   * @param diffs LinkedList of Diff objects.
+   * @param lineArray List of unique strings indexed by token, or NULL.
+   */
+ private:
+  void diff_cleanupSemanticShift(QList<Diff> &diffs,
+                                 const QStringList *lineArray);
+
+  /**
+   * Score both boundaries of an edit between two equalities.
+   * @param equality1 Equality before the edit.
+   * @param edit The edit.
+   * @param equality2 Equality after the edit.
+   * @param lineArray List of unique strings indexed by token, or NULL.
+   * @return Sum of the scores of both boundaries.
+   */
+ private:
+  int diff_cleanupSemanticEditScore(const QString &equality1,
+                                    const QString &edit,
+                                    const QString &equality2,
+                                    const QStringList *lineArray);
+
+  /**
+   * Score the boundary between two runs of line tokens, as
+   * diff_cleanupSemanticScore would score the lines they stand for.
+   * @param one First run of tokens.
+   * @param two Second run of tokens.
+   * @param lineArray List of unique strings, indexed by token.
+   * @return The score.
+   */
+ private:
+  int diff_cleanupSemanticTokenScore(const QString &one, const QString &two,
+                                     const QStringList &lineArray);
+
   /**
    * Reduce the number of edits by eliminating operationally trivial equalities.
    * @param diffs LinkedList of Diff objects.
@@ -395,6 +1652,57 @@ class diff_match_patch {
  public:
   QString diff_prettyHtml(const QList<Diff> &diffs);
 
+  /**
+   * Render one page of a large diff as a pretty HTML report.  Only the diffs
+   * overlapping the window are visited, so the cost is independent of the
+   * size of the whole diff.  Text is clipped before it is escaped, and a
+   * surrogate pair across an edge is kept whole in the window where it
+   * starts, so that adjacent windows tile the whole rendering.  Deletions
+   * go with the window holding their location in text2, and those at the
+   * end with the last window; an empty window shows nothing, unless text2
+   * is empty.
+   * @param index Index of the diff (see DiffIndex).
+   * @param start2 Start of the window within text2.
+   * @param end2 End of the window within text2 (exclusive).
+   * @return HTML representation of the window.
+   */
+ public:
+  QString diff_prettyHtml(const DiffIndex &index, int start2, int end2);
+
+  /**
+   * Render a range of hunks of a large diff as a pretty HTML report, with
+   * the unchanged text between them.
+   * @param index Index of the diff (see DiffIndex).
+   * @param firstHunk Index of the first hunk.
+   * @param lastHunk Index of the last hunk (inclusive).
+   * @return HTML representation of the hunks.
+   */
+ public:
+  QString diff_prettyHtmlHunks(const DiffIndex &index, int firstHunk,
+                               int lastHunk);
+
+  /**
+   * Render part of a range of diffs, clipped to a window of text2.
+   * @param index Index of the diff.
+   * @param firstDiff Index of the first diff.
+   * @param lastDiff Index after the last diff.
+   * @param start2 Start of the window within text2.
+   * @param end2 End of the window within text2 (exclusive).
+   * @return HTML representation.
+   */
+ private:
+  QString diff_prettyHtmlSlice(const DiffIndex &index, int firstDiff,
+                               int lastDiff, int start2, int end2);
+
+  /**
+   * Render one diff as HTML.
+   * @param operation Operation of the diff.
+   * @param text Text of the diff, not yet escaped.
+   * @return HTML representation.
+   */
+ private:
+  QString diff_prettyHtmlDiff(Operation operation, QString text);
+
   /**
    * Compute and return the source text (all equalities and deletions).
    * @param diffs LinkedList of Diff objects.
@@ -411,6 +1719,15 @@ class diff_match_patch {
  public:
   QString diff_text2(const QList<Diff> &diffs);
 
+  /**
+   * Compute and return the text of one side of the diffs, in one copy.
+   * @param diffs LinkedList of Diff objects.
+   * @param skip INSERT for the source text, DELETE for the destination text.
+   * @return Text.
+   */
+ private:
+  QString diff_text(const QList<Diff> &diffs, Operation skip);
+
   /**
    * Compute the Levenshtein distance; the number of inserted, deleted or
    * substituted characters.
@@ -442,6 +1759,39 @@ class diff_match_patch {
  public:
   QList<Diff> diff_fromDelta(const QString &text1, const QString &delta);
 
+  /**
+   * Crush the diff into a compressed delta (see DeltaEncoder), which
+   * describes the same operations as diff_toDelta in fewer bytes.
+   * @param diffs Array of diff tuples.
+   * @return Compressed delta.
+   */
+ public:
+  QByteArray diff_toCompressedDelta(const QList<Diff> &diffs);
+
+  /**
+   * Given the original text1, and a compressed delta which describes the
+   * operations required to transform text1 into text2, compute the full
+   * diff.
+   * @param text1 Source string for the diff.
+   * @param delta Compressed delta.
+   * @return Array of diff tuples.
+   * @throws QString If invalid input.
+   */
+ public:
+  QList<Diff> diff_fromCompressedDelta(const QString &text1,
+                                       const QByteArray &delta);
+
+  /**
+   * Apply a compressed delta to text1 as it is decoded, without building
+   * the diff.
+   * @param text1 Source string for the diff.
+   * @param delta Device holding the compressed delta.
+   * @return The target string text2.
+   * @throws QString If invalid input.
+   */
+ public:
+  QString diff_applyCompressedDelta(const QString &text1, QIODevice &delta);
+
 
   //  MATCH FUNCTIONS
 
@@ -457,6 +1807,20 @@ class diff_match_patch {
  public:
   int match_main(const QString &text, const QString &pattern, int loc);
 
+  /**
+   * Locate the best instances of 'pattern' across an indexed corpus.  The
+   * index proposes locations (see CorpusIndex::candidates), which are
+   * confirmed with match_bitap on a window around each and ranked on the
+   * errors of the match.  Of overlapping matches in a document only the
+   * best is kept.
+   * @param index Index of the corpus.
+   * @param pattern The pattern to search for.
+   * @return List of CorpusMatch objects, best first.
+   */
+ public:
+  QList<CorpusMatch> match_corpus(const CorpusIndex &index,
+                                  const QString &pattern);
+
   /**
    * Locate the best instance of 'pattern' in 'text' near 'loc' using the
    * Bitap algorithm.  Returns -1 if no match found.
@@ -468,6 +1832,29 @@ class diff_match_patch {
  protected:
   int match_bitap(const QString &text, const QString &pattern, int loc);
 
+  /**
+   * Compute one error level of the Bitap state over a window on several
+   * threads.  The window is cut into segments, each of which starts its
+   * recurrence pattern length + error level characters to its right, by
+   * which point the state no longer depends on where it started.  The
+   * result is the same as a serial pass.  Segments for which the global
+   * thread pool has no free thread run on the calling thread, so this is
+   * safe to call from a pool task.
+   * @param text The text to search.
+   * @param s Alphabet of the pattern.
+   * @param d Error level.
+   * @param overlap Characters scanned beyond the end of each segment.
+   * @param start First index of the window (1-based, as in match_bitap).
+   * @param finish Last index of the window; rd[finish + 1] must be set.
+   * @param rd State of this error level, filled from start to finish.
+   * @param last_rd State of the previous error level, or NULL.
+   * @param threads Number of threads.
+   */
+ private:
+  void match_bitapParallel(const QString &text, const QMap<QChar, int> &s,
+                           int d, int overlap, int start, int finish, int *rd,
+                           const int *last_rd, int threads);
+
   /**
    * Compute and return the score for a match with e errors and x location.
    * @param e Number of errors in match.
@@ -510,6 +1897,27 @@ class diff_match_patch {
  public:
   QList<Patch> patch_make(const QString &text1, const QString &text2);
 
+  /**
+   * Predict the cost of patch_make(text1, text2) without running it.
+   * @param text1 Old text.
+   * @param text2 New text.
+   * @return CostEstimate object.
+   */
+ public:
+  CostEstimate patch_estimateMake(const QString &text1, const QString &text2);
+
+  /**
+   * Predict the cost of patch_apply(patches, text) without running it.
+   * Each patch is checked for an exact match at its expected location;
+   * the others are charged a fuzzy search over their match window.
+   * @param patches Array of patch objects.
+   * @param text Old text.
+   * @return CostEstimate object.
+   */
+ public:
+  CostEstimate patch_estimateApply(const QList<Patch> &patches,
+                                   const QString &text);
+
   /**
    * Compute a list of patches to turn text1 into text2.
    * text1 will be derived from the provided diffs.
@@ -560,6 +1968,65 @@ class diff_match_patch {
  public:
   QPair<QString,QVector<bool> > patch_apply(QList<Patch> &patches, const QString &text);
 
+  /**
+   * Merge a set of patches onto a text read from a stream, writing the
+   * patched text to another stream as it goes.  Only a sliding buffer of
+   * about Match_Distance plus the pattern size around each expected location
+   * is held in memory.  Patches which are not in increasing order, or
+   * settings which allow a search of the whole text, fall back to reading
+   * the whole text and calling patch_apply.
+   * @param patches Array of patch objects.
+   * @param input Stream of the old text.
+   * @param output Stream which receives the new text.
+   * @return Array of boolean values indicating which patches were applied.
+   */
+ public:
+  QVector<bool> patch_applyStream(QList<Patch> &patches, QTextStream &input,
+                                  QTextStream &output);
+
+  /**
+   * Read from a stream until a buffer holds at least the given number of
+   * characters.  At the end of the stream, append the padding once.
+   * @param input Stream of the old text.
+   * @param buffer Buffer to extend.
+   * @param size Number of characters wanted in the buffer.
+   * @param nullPadding Padding string added at the end of the text.
+   * @param atEnd Set once the end of the stream has been reached.
+   */
+ private:
+  void patch_streamFill(QTextStream &input, QString &buffer, int size,
+                        const QString &nullPadding, bool &atEnd);
+
+  /**
+   * Locate the best instance of 'pattern' in a window of the text.
+   * @param window Window of the text.
+   * @param whole True if the window is the whole text.
+   * @param pattern The pattern to search for.
+   * @param loc The location to search around, relative to the window.
+   * @return Best match index relative to the window or -1.
+   */
+ private:
+  int patch_streamMatch(const QString &window, bool whole,
+                        const QString &pattern, int loc);
+
+  /**
+   * Diff the pattern of a patch against the text where it was found, unless
+   * the content is unacceptably bad.  For patterns longer than Match_MaxBits
+   * the Levenshtein distance must be within Patch_DeleteThreshold of the
+   * pattern length.  A bounded diff rejects a monster delete on drifted text
+   * as soon as that is provably exceeded, and is itself the diff otherwise.
+   * Being minimal, it may accept a match just within the threshold which
+   * the half-match shortcuts of diff_main would have put just outside it.
+   * A match whose bounded diff runs out of Diff_Timeout is rejected.
+   * @param text1 The pattern text of the patch.
+   * @param text2 The text found at the match location.
+   * @param diffs Set to the Linked List of Diff objects if accepted.
+   * @return True if the match is accepted.
+   */
+ private:
+  bool patch_fuzzyDiff(const QString &text1, const QString &text2,
+                       QList<Diff> &diffs);
+
   /**
    * Add some padding on text start and end so that edges can match something.
    * Intended to be called only from within patch_apply.
@@ -578,6 +2045,29 @@ class diff_match_patch {
  public:
   void patch_splitMax(QList<Patch> &patches);
 
+  /**
+   * Reduce a list of patches to an equivalent minimal one, e.g. after
+   * concatenating the output of several patch_make calls.  Patches are
+   * sorted on location, those which overlap or touch are merged so shared
+   * context is matched only once, and those which do nothing are dropped.
+   * Merges which would exceed Match_MaxBits are left split, and oversized
+   * patches are broken up just as patch_apply would.
+   * @param patches List of Patch objects.
+   */
+ public:
+  void patch_normalize(QList<Patch> &patches);
+
+  /**
+   * Merge two consecutive patches into one.
+   * @param first Patch applied first.
+   * @param second Patch applied to the result of the first.
+   * @param merged Receives the combined patch.
+   * @return False if the patches neither overlap nor touch, or disagree
+   *     about the text between them.
+   */
+ private:
+  bool patch_merge(const Patch &first, const Patch &second, Patch &merged);
+
   /**
    * Take a list of patches and return a textual representation.
    * @param patches List of Patch objects.
@@ -596,6 +2086,20 @@ class diff_match_patch {
  public:
   QList<Patch> patch_fromText(const QString &textline);
 
+  /**
+   * Parse the hunks of a unified diff of one file, as written by git diff
+   * or diff -u, into a list of Patch objects for patch_apply.  Only the
+   * first file of a multi-file diff is read; see UnifiedDiffReader for the
+   * others.
+   * @param diff Text of the unified diff.
+   * @param text1 Old text of the file, to convert lines into offsets.
+   * @return List of Patch objects.
+   * @throws QString If invalid input.
+   */
+ public:
+  QList<Patch> patch_fromUnifiedDiff(const QString &diff,
+                                     const QString &text1);
+
   /**
    * A safer version of QString.mid(pos).  This one returns "" instead of
    * null when the postion equals the string length.
@@ -11,9 +11,9 @@ mac {
 
 FORMS =
 
-HEADERS = diff_match_patch.h diff_match_patch_test.h
+HEADERS = diff_match_patch_core.h diff_match_patch.h diff_match_patch_test.h
 
-SOURCES = diff_match_patch.cpp diff_match_patch_test.cpp
+SOURCES = diff_match_patch_core.cpp diff_match_patch.cpp diff_match_patch_test.cpp
 
 RESOURCES = 
 
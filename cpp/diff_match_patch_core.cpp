@@ -0,0 +1,608 @@
+/*
+ * Diff Match and Patch
+ * Copyright 2018 The diff-match-patch Authors.
+ * https://github.com/google/diff-match-patch
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <limits.h>
+#include "diff_match_patch_core.h"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DMP_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+
+/////////////////////////////////////////////
+//
+// CPU Kernels
+//
+/////////////////////////////////////////////
+
+// The innermost loops over UTF-16 code units, in a plain version and in
+// versions for each x86 vector extension.  The best one the CPU supports
+// is picked once, when the library is loaded.  Suffix kernels are given
+// pointers one past the end of the texts and compare backwards.
+
+static int kernelCommonPrefixScalar(const CoreChar *text1,
+                                    const CoreChar *text2, int n) {
+  int i = 0;
+  while (i < n && text1[i] == text2[i]) {
+    i++;
+  }
+  return i;
+}
+
+
+static int kernelCommonSuffixScalar(const CoreChar *end1,
+                                    const CoreChar *end2, int n) {
+  int i = 0;
+  while (i < n && end1[-1 - i] == end2[-1 - i]) {
+    i++;
+  }
+  return i;
+}
+
+
+static int kernelIndexOfScalar(const CoreChar *text, int n, CoreChar c) {
+  for (int i = 0; i < n; i++) {
+    if (text[i] == c) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+
+#ifdef DMP_X86_KERNELS
+
+// SSE4.2: eight code units at a time with the string compare instruction.
+
+__attribute__((target("sse4.2")))
+static int kernelCommonPrefixSse42(const CoreChar *text1,
+                                   const CoreChar *text2, int n) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const int j = _mm_cmpestri(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(text1 + i)), 8,
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(text2 + i)), 8,
+        _SIDD_UWORD_OPS | _SIDD_CMP_EQUAL_EACH | _SIDD_NEGATIVE_POLARITY
+        | _SIDD_LEAST_SIGNIFICANT);
+    if (j < 8) {
+      return i + j;
+    }
+  }
+  return i + kernelCommonPrefixScalar(text1 + i, text2 + i, n - i);
+}
+
+
+__attribute__((target("sse4.2")))
+static int kernelCommonSuffixSse42(const CoreChar *end1,
+                                   const CoreChar *end2, int n) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const int j = _mm_cmpestri(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(end1 - i - 8)), 8,
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(end2 - i - 8)), 8,
+        _SIDD_UWORD_OPS | _SIDD_CMP_EQUAL_EACH | _SIDD_NEGATIVE_POLARITY
+        | _SIDD_MOST_SIGNIFICANT);
+    if (j < 8) {
+      return i + 7 - j;
+    }
+  }
+  return i + kernelCommonSuffixScalar(end1 - i, end2 - i, n - i);
+}
+
+
+__attribute__((target("sse4.2")))
+static int kernelIndexOfSse42(const CoreChar *text, int n, CoreChar c) {
+  const __m128i needle = _mm_set1_epi16(static_cast<short>(c));
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const int j = _mm_cmpestri(needle, 1,
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i)), 8,
+        _SIDD_UWORD_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+    if (j < 8) {
+      return i + j;
+    }
+  }
+  const int j = kernelIndexOfScalar(text + i, n - i, c);
+  return j == -1 ? -1 : i + j;
+}
+
+
+// AVX2: sixteen code units at a time, two mask bits per code unit.
+
+__attribute__((target("avx2")))
+static int kernelCommonPrefixAvx2(const CoreChar *text1,
+                                  const CoreChar *text2, int n) {
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const unsigned int equal = _mm256_movemask_epi8(_mm256_cmpeq_epi16(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text1 + i)),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text2 + i))));
+    if (equal != 0xFFFFFFFFu) {
+      return i + __builtin_ctz(~equal) / 2;
+    }
+  }
+  return i + kernelCommonPrefixScalar(text1 + i, text2 + i, n - i);
+}
+
+
+__attribute__((target("avx2")))
+static int kernelCommonSuffixAvx2(const CoreChar *end1,
+                                  const CoreChar *end2, int n) {
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const unsigned int equal = _mm256_movemask_epi8(_mm256_cmpeq_epi16(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(end1 - i - 16)),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(end2 - i - 16))));
+    if (equal != 0xFFFFFFFFu) {
+      return i + __builtin_clz(~equal) / 2;
+    }
+  }
+  return i + kernelCommonSuffixScalar(end1 - i, end2 - i, n - i);
+}
+
+
+__attribute__((target("avx2")))
+static int kernelIndexOfAvx2(const CoreChar *text, int n, CoreChar c) {
+  const __m256i needle = _mm256_set1_epi16(static_cast<short>(c));
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const unsigned int found = _mm256_movemask_epi8(_mm256_cmpeq_epi16(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i)),
+        needle));
+    if (found != 0) {
+      return i + __builtin_ctz(found) / 2;
+    }
+  }
+  const int j = kernelIndexOfScalar(text + i, n - i, c);
+  return j == -1 ? -1 : i + j;
+}
+
+
+// AVX-512BW: thirty-two code units at a time, one mask bit per code unit.
+
+__attribute__((target("avx512f,avx512bw")))
+static int kernelCommonPrefixAvx512(const CoreChar *text1,
+                                    const CoreChar *text2, int n) {
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    const unsigned int differ = _mm512_cmpneq_epi16_mask(
+        _mm512_loadu_si512(text1 + i), _mm512_loadu_si512(text2 + i));
+    if (differ != 0) {
+      return i + __builtin_ctz(differ);
+    }
+  }
+  return i + kernelCommonPrefixScalar(text1 + i, text2 + i, n - i);
+}
+
+
+__attribute__((target("avx512f,avx512bw")))
+static int kernelCommonSuffixAvx512(const CoreChar *end1,
+                                    const CoreChar *end2, int n) {
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    const unsigned int differ = _mm512_cmpneq_epi16_mask(
+        _mm512_loadu_si512(end1 - i - 32), _mm512_loadu_si512(end2 - i - 32));
+    if (differ != 0) {
+      return i + __builtin_clz(differ);
+    }
+  }
+  return i + kernelCommonSuffixScalar(end1 - i, end2 - i, n - i);
+}
+
+
+__attribute__((target("avx512f,avx512bw")))
+static int kernelIndexOfAvx512(const CoreChar *text, int n, CoreChar c) {
+  const __m512i needle = _mm512_set1_epi16(static_cast<short>(c));
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    const unsigned int found = _mm512_cmpeq_epi16_mask(
+        _mm512_loadu_si512(text + i), needle);
+    if (found != 0) {
+      return i + __builtin_ctz(found);
+    }
+  }
+  const int j = kernelIndexOfScalar(text + i, n - i, c);
+  return j == -1 ? -1 : i + j;
+}
+
+#endif  // DMP_X86_KERNELS
+
+
+// One implementation of each kernel.
+struct CpuKernels {
+  const char *name;
+  int (*commonPrefix)(const CoreChar *text1, const CoreChar *text2, int n);
+  int (*commonSuffix)(const CoreChar *end1, const CoreChar *end2, int n);
+  int (*indexOf)(const CoreChar *text, int n, CoreChar c);
+};
+
+
+// All the variants compiled in, from the plainest to the widest.
+static const CpuKernels CPU_KERNELS[] = {
+  {"scalar", kernelCommonPrefixScalar, kernelCommonSuffixScalar,
+   kernelIndexOfScalar},
+#ifdef DMP_X86_KERNELS
+  {"sse4.2", kernelCommonPrefixSse42, kernelCommonSuffixSse42,
+   kernelIndexOfSse42},
+  {"avx2", kernelCommonPrefixAvx2, kernelCommonSuffixAvx2,
+   kernelIndexOfAvx2},
+  {"avx512", kernelCommonPrefixAvx512, kernelCommonSuffixAvx512,
+   kernelIndexOfAvx512},
+#endif
+};
+static const int CPU_KERNEL_COUNT =
+    sizeof(CPU_KERNELS) / sizeof(CPU_KERNELS[0]);
+
+
+// Whether this CPU (and OS) can run a variant.
+static bool cpuSupports(const CpuKernels &variant) {
+  const char *name = variant.name;
+#ifdef DMP_X86_KERNELS
+  __builtin_cpu_init();
+  if (strcmp(name, "sse4.2") == 0) {
+    return __builtin_cpu_supports("sse4.2");
+  } else if (strcmp(name, "avx2") == 0) {
+    return __builtin_cpu_supports("avx2");
+  } else if (strcmp(name, "avx512") == 0) {
+    return __builtin_cpu_supports("avx512f")
+        && __builtin_cpu_supports("avx512bw");
+  }
+#endif
+  return strcmp(name, "scalar") == 0;
+}
+
+
+static const CpuKernels *cpuDetect() {
+  const CpuKernels *best = &CPU_KERNELS[0];
+  for (int i = 1; i < CPU_KERNEL_COUNT; i++) {
+    if (cpuSupports(CPU_KERNELS[i])) {
+      best = &CPU_KERNELS[i];
+    }
+  }
+  return best;
+}
+
+
+// The variant in use.
+static const CpuKernels *kernels = cpuDetect();
+
+
+/////////////////////////////////////////////
+//
+// DiffCore Class
+//
+/////////////////////////////////////////////
+
+
+const char *DiffCore::kernelVariant() {
+  return kernels->name;
+}
+
+
+int DiffCore::kernelCount() {
+  return CPU_KERNEL_COUNT;
+}
+
+
+const char *DiffCore::kernelName(int i) {
+  return CPU_KERNELS[i].name;
+}
+
+
+bool DiffCore::kernelSupported(int i) {
+  return cpuSupports(CPU_KERNELS[i]);
+}
+
+
+bool DiffCore::kernelSelect(const char *variant) {
+  for (int i = 0; i < CPU_KERNEL_COUNT; i++) {
+    if (strcmp(variant, CPU_KERNELS[i].name) == 0
+        && cpuSupports(CPU_KERNELS[i])) {
+      kernels = &CPU_KERNELS[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+
+int DiffCore::commonPrefix(const CoreChar *text1, const CoreChar *text2,
+                           int n) {
+  return kernels->commonPrefix(text1, text2, n);
+}
+
+
+int DiffCore::commonSuffix(const CoreChar *end1, const CoreChar *end2,
+                           int n) {
+  return kernels->commonSuffix(end1, end2, n);
+}
+
+
+int DiffCore::indexOf(const CoreChar *text, int n, CoreChar c) {
+  return kernels->indexOf(text, n, c);
+}
+
+
+int DiffCore::indexOf(const CoreChar *text, int n, const CoreChar *pattern,
+                      int m) {
+  if (m == 0) {
+    return 0;
+  }
+  if (m > n) {
+    return -1;
+  }
+  if (m == 1) {
+    return kernels->indexOf(text, n, pattern[0]);
+  }
+  // Hash the last bits of each character of a window; the oldest shifts
+  // out of the top as the window moves on.
+  const int shift = m - 1;
+  const bool shiftsOut = shift < static_cast<int>(sizeof(unsigned) * CHAR_BIT);
+  unsigned patternHash = 0;
+  unsigned textHash = 0;
+  for (int i = 0; i < m; i++) {
+    patternHash = (patternHash << 1) + pattern[i];
+    textHash = (textHash << 1) + text[i];
+  }
+  const int last = n - m;
+  for (int i = 0; ; i++) {
+    if (textHash == patternHash
+        && kernels->commonPrefix(text + i, pattern, m) == m) {
+      return i;
+    }
+    if (i == last) {
+      return -1;
+    }
+    if (shiftsOut) {
+      textHash -= static_cast<unsigned>(text[i]) << shift;
+    }
+    textHash = (textHash << 1) + text[i + m];
+  }
+}
+
+
+int DiffCore::commonOverlap(const CoreChar *text1, int length1,
+                            const CoreChar *text2, int length2,
+                            long long &scanned) {
+  // Eliminate the null case.
+  if (length1 == 0 || length2 == 0) {
+    return 0;
+  }
+  // Truncate the longer string.
+  const int text_length = std::min(length1, length2);
+  text1 += length1 - text_length;
+  // Quick check for the worst case.
+  if (kernels->commonPrefix(text1, text2, text_length) == text_length) {
+    return text_length;
+  }
+
+  // Start by looking for a single character match
+  // and increase length until no match is found.
+  // Performance analysis: http://neil.fraser.name/news/2010/11/04/
+  int best = 0;
+  int length = 1;
+  while (true) {
+    const int found = indexOf(text2, text_length, text1 + text_length - length,
+                              length);
+    scanned += (found == -1 ? text_length : found) + length;
+    if (found == -1) {
+      return best;
+    }
+    length += found;
+    if (found == 0 || kernels->commonPrefix(text1 + text_length - length,
+                                            text2, length) == length) {
+      best = length;
+      length++;
+    }
+  }
+}
+
+
+int DiffCore::bisectSnake(const CoreChar *text1, int text1_length,
+                          const CoreChar *text2, int text2_length,
+                          int maxSteps, clock_t deadline, int &x, int &y,
+                          int &steps) {
+  const int max_d = maxSteps;
+  const int v_offset = max_d;
+  const int v_length = 2 * max_d + 2;
+  CoreArray<int> v1(v_length, -1);
+  CoreArray<int> v2(v_length, -1);
+  v1[v_offset + 1] = 0;
+  v2[v_offset + 1] = 0;
+  const int delta = text1_length - text2_length;
+  // If the total number of characters is odd, then the front path will
+  // collide with the reverse path.
+  const bool front = (delta % 2 != 0);
+  // Offsets for start and end of k loop.
+  // Prevents mapping of space beyond the grid.
+  int k1start = 0;
+  int k1end = 0;
+  int k2start = 0;
+  int k2end = 0;
+  steps = 0;
+  for (int d = 0; d < max_d; d++) {
+    // Bail out if deadline is reached.
+    if (clock() > deadline) {
+      break;
+    }
+    steps++;
+
+    // Walk the front path one step.
+    for (int k1 = -d + k1start; k1 <= d - k1end; k1 += 2) {
+      const int k1_offset = v_offset + k1;
+      int x1;
+      if (k1 == -d || (k1 != d && v1[k1_offset - 1] < v1[k1_offset + 1])) {
+        x1 = v1[k1_offset + 1];
+      } else {
+        x1 = v1[k1_offset - 1] + 1;
+      }
+      int y1 = x1 - k1;
+      if (x1 < text1_length && y1 < text2_length
+          && text1[x1] == text2[y1]) {
+        // Follow the snake; the kernel pays off on the long ones.
+        const int snake = 1 + kernels->commonPrefix(
+            text1 + x1 + 1, text2 + y1 + 1,
+            std::min(text1_length - x1, text2_length - y1) - 1);
+        x1 += snake;
+        y1 += snake;
+      }
+      v1[k1_offset] = x1;
+      if (x1 > text1_length) {
+        // Ran off the right of the graph.
+        k1end += 2;
+      } else if (y1 > text2_length) {
+        // Ran off the bottom of the graph.
+        k1start += 2;
+      } else if (front) {
+        int k2_offset = v_offset + delta - k1;
+        if (k2_offset >= 0 && k2_offset < v_length && v2[k2_offset] != -1) {
+          // Mirror x2 onto top-left coordinate system.
+          int x2 = text1_length - v2[k2_offset];
+          if (x1 >= x2) {
+            // Overlap detected.
+            x = x1;
+            y = y1;
+            return 2 * d - 1;
+          }
+        }
+      }
+    }
+
+    // Walk the reverse path one step.
+    for (int k2 = -d + k2start; k2 <= d - k2end; k2 += 2) {
+      const int k2_offset = v_offset + k2;
+      int x2;
+      if (k2 == -d || (k2 != d && v2[k2_offset - 1] < v2[k2_offset + 1])) {
+        x2 = v2[k2_offset + 1];
+      } else {
+        x2 = v2[k2_offset - 1] + 1;
+      }
+      int y2 = x2 - k2;
+      if (x2 < text1_length && y2 < text2_length
+          && text1[text1_length - x2 - 1] == text2[text2_length - y2 - 1]) {
+        const int snake = 1 + kernels->commonSuffix(
+            text1 + text1_length - x2 - 1, text2 + text2_length - y2 - 1,
+            std::min(text1_length - x2, text2_length - y2) - 1);
+        x2 += snake;
+        y2 += snake;
+      }
+      v2[k2_offset] = x2;
+      if (x2 > text1_length) {
+        // Ran off the left of the graph.
+        k2end += 2;
+      } else if (y2 > text2_length) {
+        // Ran off the top of the graph.
+        k2start += 2;
+      } else if (!front) {
+        int k1_offset = v_offset + delta - k2;
+        if (k1_offset >= 0 && k1_offset < v_length && v1[k1_offset] != -1) {
+          int x1 = v1[k1_offset];
+          int y1 = v_offset + x1 - k1_offset;
+          // Mirror x2 onto top-left coordinate system.
+          x2 = text1_length - x2;
+          if (x1 >= x2) {
+            // Overlap detected.
+            x = x1;
+            y = y1;
+            return 2 * d;
+          }
+        }
+      }
+    }
+  }
+  return -1;
+}
+
+
+int DiffCore::textLength(const CoreDiff *diffs, int count, Operation skip) {
+  int length = 0;
+  for (int i = 0; i < count; i++) {
+    if (diffs[i].operation != skip) {
+      length += diffs[i].length;
+    }
+  }
+  return length;
+}
+
+
+void DiffCore::text(const CoreDiff *diffs, int count, Operation skip,
+                    CoreChar *text) {
+  for (int i = 0; i < count; i++) {
+    if (diffs[i].operation != skip) {
+      memcpy(text, diffs[i].text, diffs[i].length * sizeof(CoreChar));
+      text += diffs[i].length;
+    }
+  }
+}
+
+
+int DiffCore::xIndex(const CoreDiff *diffs, int count, int loc) {
+  int chars1 = 0;
+  int chars2 = 0;
+  int last_chars1 = 0;
+  int last_chars2 = 0;
+  for (int i = 0; i < count; i++) {
+    if (diffs[i].operation != INSERT) {
+      // Equality or deletion.
+      chars1 += diffs[i].length;
+    }
+    if (diffs[i].operation != DELETE) {
+      // Equality or insertion.
+      chars2 += diffs[i].length;
+    }
+    if (chars1 > loc) {
+      // Overshot the location.
+      if (diffs[i].operation == DELETE) {
+        // The location was deleted.
+        return last_chars2;
+      }
+      break;
+    }
+    last_chars1 = chars1;
+    last_chars2 = chars2;
+  }
+  // Add the remaining character length.
+  return last_chars2 + (loc - last_chars1);
+}
+
+
+int DiffCore::levenshtein(const CoreDiff *diffs, int count) {
+  int levenshtein = 0;
+  int insertions = 0;
+  int deletions = 0;
+  for (int i = 0; i < count; i++) {
+    switch (diffs[i].operation) {
+      case INSERT:
+        insertions += diffs[i].length;
+        break;
+      case DELETE:
+        deletions += diffs[i].length;
+        break;
+      case EQUAL:
+        // A deletion and an insertion is one substitution.
+        levenshtein += std::max(insertions, deletions);
+        insertions = 0;
+        deletions = 0;
+        break;
+    }
+  }
+  levenshtein += std::max(insertions, deletions);
+  return levenshtein;
+}
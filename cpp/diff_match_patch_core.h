@@ -0,0 +1,312 @@
+/*
+ * Diff Match and Patch
+ * Copyright 2018 The diff-match-patch Authors.
+ * https://github.com/google/diff-match-patch
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DIFF_MATCH_PATCH_CORE_H
+#define DIFF_MATCH_PATCH_CORE_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <time.h>
+#include <new>
+
+/*
+ * The innermost loops of diff_match_patch, on plain buffers of UTF-16 code
+ * units.  Nothing in here depends on Qt.  There are no implicitly shared
+ * types, so no atomic reference counts are touched, and every buffer has
+ * exactly one owner.  The classes of diff_match_patch.h are adapters that
+ * hand the data of their QStrings to these functions.  The cleanups, match
+ * and patch still work on the Qt types; only their character-level walks
+ * come through here.
+ */
+
+
+/**-
+* The data structure representing a diff is a Linked list of Diff objects:
+* {Diff(Operation.DELETE, "Hello"), Diff(Operation.INSERT, "Goodbye"),
+*  Diff(Operation.EQUAL, " world.")}
+* which means: delete "Hello", add "Goodbye" and keep " world."
+*/
+enum Operation {
+  DELETE, INSERT, EQUAL
+};
+
+
+// A UTF-16 code unit, as returned by QChar::unicode().
+typedef unsigned short CoreChar;
+
+
+/**
+ * One diff operation on text owned by someone else, such as the QString of
+ * a Diff.
+ */
+struct CoreDiff {
+  Operation operation;
+  const CoreChar *text;
+  int length;
+};
+
+
+/**
+ * A growable array with a single owner.  It cannot be copied; ownership is
+ * passed on with swap.  Items are moved with realloc, so T must be a plain
+ * data type.
+ */
+template <class T>
+class CoreArray {
+ public:
+  CoreArray() : items(NULL), count(0), capacity(0) {
+  }
+
+  /**
+   * Constructor.  Fills the array.
+   * @param size Number of items.
+   * @param value Value of each item.
+   */
+  CoreArray(int size, const T &value) : items(NULL), count(0), capacity(0) {
+    reserve(size);
+    for (count = 0; count < size; count++) {
+      items[count] = value;
+    }
+  }
+
+  ~CoreArray() {
+    free(items);
+  }
+
+  int size() const {
+    return count;
+  }
+
+  T *data() {
+    return items;
+  }
+
+  const T *data() const {
+    return items;
+  }
+
+  T &operator[](int i) {
+    return items[i];
+  }
+
+  const T &operator[](int i) const {
+    return items[i];
+  }
+
+  void append(const T &item) {
+    if (count == capacity) {
+      reserve(capacity == 0 ? 16 : 2 * capacity);
+    }
+    items[count++] = item;
+  }
+
+  /**
+   * Make room for a number of items without growing again.
+   * @param size Number of items.
+   * @throws std::bad_alloc If out of memory.
+   */
+  void reserve(int size) {
+    if (size <= capacity) {
+      return;
+    }
+    T *grown = static_cast<T *>(realloc(items, size * sizeof(T)));
+    if (grown == NULL) {
+      throw std::bad_alloc();
+    }
+    items = grown;
+    capacity = size;
+  }
+
+  void clear() {
+    count = 0;
+  }
+
+  void swap(CoreArray &other) {
+    T *otherItems = other.items;
+    const int otherCount = other.count;
+    const int otherCapacity = other.capacity;
+    other.items = items;
+    other.count = count;
+    other.capacity = capacity;
+    items = otherItems;
+    count = otherCount;
+    capacity = otherCapacity;
+  }
+
+ private:
+  CoreArray(const CoreArray &);
+  CoreArray &operator=(const CoreArray &);
+
+  T *items;
+  int count;
+  int capacity;
+};
+
+
+/**
+ * The Qt-independent core: scans and the diff graph search on plain
+ * buffers.  Texts are passed as a pointer and a length.
+ */
+class DiffCore {
+ public:
+  /**
+   * Name the CPU kernels in use for commonPrefix, commonSuffix and indexOf.
+   * @return "scalar", "sse4.2", "avx2" or "avx512".
+   */
+  static const char *kernelVariant();
+
+  /**
+   * Count the kernel variants compiled in, whether this CPU can run them or
+   * not.
+   * @return Number of variants, plainest first.
+   */
+  static int kernelCount();
+
+  /**
+   * Name a kernel variant.
+   * @param i Index of the variant.
+   * @return Name as for kernelVariant.
+   */
+  static const char *kernelName(int i);
+
+  /**
+   * Can this CPU (and OS) run a kernel variant?
+   * @param i Index of the variant.
+   * @return True if it can.
+   */
+  static bool kernelSupported(int i);
+
+  /**
+   * Switch over to another kernel variant.
+   * @param variant Name as for kernelVariant.
+   * @return False if the variant is unknown or unsupported.
+   */
+  static bool kernelSelect(const char *variant);
+
+  /**
+   * Determine the common prefix of two texts.
+   * @param text1 First text.
+   * @param text2 Second text.
+   * @param n Length of the shorter text.
+   * @return The number of characters common to the start of each text.
+   */
+  static int commonPrefix(const CoreChar *text1, const CoreChar *text2,
+                          int n);
+
+  /**
+   * Determine the common suffix of two texts.
+   * @param end1 One past the end of the first text.
+   * @param end2 One past the end of the second text.
+   * @param n Length of the shorter text.
+   * @return The number of characters common to the end of each text.
+   */
+  static int commonSuffix(const CoreChar *end1, const CoreChar *end2, int n);
+
+  /**
+   * Find a character.
+   * @param text Text to search.
+   * @param n Length of text.
+   * @param c Character to find.
+   * @return Index of the first occurrence, or -1.
+   */
+  static int indexOf(const CoreChar *text, int n, CoreChar c);
+
+  /**
+   * Find a pattern, with the rolling hash of QString::indexOf.
+   * @param text Text to search.
+   * @param n Length of text.
+   * @param pattern Pattern to find.
+   * @param m Length of pattern.
+   * @return Index of the first occurrence, or -1.
+   */
+  static int indexOf(const CoreChar *text, int n, const CoreChar *pattern,
+                     int m);
+
+  /**
+   * Determine if the suffix of one text is the prefix of another.
+   * @param text1 First text.
+   * @param length1 Length of text1.
+   * @param text2 Second text.
+   * @param length2 Length of text2.
+   * @param scanned Incremented by the characters searched.
+   * @return The number of characters common to the end of the first
+   *     text and the start of the second text.
+   */
+  static int commonOverlap(const CoreChar *text1, int length1,
+                           const CoreChar *text2, int length2,
+                           long long &scanned);
+
+  /**
+   * Find the 'middle snake' of a diff, as diff_match_patch::diff_bisectSnake.
+   * @param text1 Old text.
+   * @param length1 Length of text1.
+   * @param text2 New text.
+   * @param length2 Length of text2.
+   * @param maxSteps Steps of the front and the reverse path to try.
+   * @param deadline Time at which to bail if not yet complete.
+   * @param x Set to the index of the split point in text1.
+   * @param y Set to the index of the split point in text2.
+   * @param steps Set to the number of steps walked.
+   * @return Edit distance, or -1 if the paths did not meet.
+   * @throws std::bad_alloc If out of memory.
+   */
+  static int bisectSnake(const CoreChar *text1, int length1,
+                         const CoreChar *text2, int length2, int maxSteps,
+                         clock_t deadline, int &x, int &y, int &steps);
+
+  /**
+   * Count the characters of the text left by one side of a diff.
+   * @param diffs Array of diffs.
+   * @param count Number of diffs.
+   * @param skip INSERT to count the source text, DELETE for the
+   *     destination text.
+   * @return Length of the text.
+   */
+  static int textLength(const CoreDiff *diffs, int count, Operation skip);
+
+  /**
+   * Copy out the text of one side of a diff.
+   * @param diffs Array of diffs.
+   * @param count Number of diffs.
+   * @param skip INSERT for the source text, DELETE for the destination text.
+   * @param text Buffer of textLength(diffs, count, skip) characters.
+   */
+  static void text(const CoreDiff *diffs, int count, Operation skip,
+                   CoreChar *text);
+
+  /**
+   * loc is a location in text1, compute and return the equivalent location
+   * in text2, as diff_match_patch::diff_xIndex.
+   * @param diffs Array of diffs.
+   * @param count Number of diffs.
+   * @param loc Location within text1.
+   * @return Location within text2.
+   */
+  static int xIndex(const CoreDiff *diffs, int count, int loc);
+
+  /**
+   * Compute the Levenshtein distance; the number of inserted, deleted or
+   * substituted characters.
+   * @param diffs Array of diffs.
+   * @param count Number of diffs.
+   * @return Number of changes.
+   */
+  static int levenshtein(const CoreDiff *diffs, int count);
+};
+
+#endif // DIFF_MATCH_PATCH_CORE_H
@@ -0,0 +1,10 @@
+# The Qt-independent core, as a static library for non-Qt callers.
+TEMPLATE = lib
+CONFIG += staticlib release
+CONFIG -= qt
+
+TARGET = diff_match_patch_core
+
+HEADERS = diff_match_patch_core.h
+
+SOURCES = diff_match_patch_core.cpp
@@ -42,33 +42,54 @@ void diff_match_patch_test::run_all_tests() {
     testDiffCommonPrefix();
     testDiffCommonSuffix();
     testDiffCommonOverlap();
+    testDiffKernels();
+    testDiffCore();
     testDiffHalfmatch();
+    testDiffFeatures();
+    testDiffEstimate();
+    testDiffSketch();
     testDiffLinesToChars();
     testDiffCharsToLines();
     testDiffCleanupMerge();
     testDiffCleanupSemanticLossless();
     testDiffCleanupSemantic();
+    testDiffCleanupSemanticTokens();
     testDiffCleanupEfficiency();
     testDiffPrettyHtml();
+    testDiffPrettyHtmlWindow();
     testDiffText();
     testDiffDelta();
+    testDiffCompressedDelta();
     testDiffXIndex();
     testDiffLevenshtein();
     testDiffBisect();
+    testDiffBounded();
+    testDiffChunked();
+    testDiffPipeline();
+    testStreamingDiff();
+    testDiffSession();
+    testDiffAlign();
     testDiffMain();
+    testDiffRecords();
 
     testMatchAlphabet();
     testMatchBitap();
     testMatchMain();
+    testMatchCorpus();
 
     testPatchObj();
     testPatchFromText();
+    testPatchFromUnifiedDiff();
     testPatchToText();
     testPatchAddContext();
     testPatchMake();
     testPatchSplitMax();
+    testPatchNormalize();
     testPatchAddPadding();
     testPatchApply();
+    testPatchApplyStream();
+    testPatchEstimate();
+    testCaptureReplay();
     qDebug("All tests passed.");
   } catch (QString strCase) {
     qDebug("Test failed: %s", qPrintable(strCase));
@@ -111,6 +132,119 @@ void diff_match_patch_test::testDiffCommonOverlap() {
   assertEquals("diff_commonOverlap: Unicode.", 0, dmp.diff_commonOverlap("fi", QString::fromWCharArray((const wchar_t*) L"\ufb01i", 2)));
 }
 
+void diff_match_patch_test::testDiffKernels() {
+  // Every kernel variant this CPU can run agrees with the scalar one.
+  const QString initial = diff_match_patch::kernel_variant();
+  assertTrue("kernel_variants: Scalar first.", diff_match_patch::kernel_variants().first() == "scalar");
+  assertTrue("kernel_variants: Current.", diff_match_patch::kernel_variants().contains(initial));
+  assertFalse("kernel_select: Unknown.", diff_match_patch::kernel_select("mmx"));
+
+  // Strings of every length up to a few vectors, differing at each place,
+  // with characters above 0xFF to catch any byte-wise comparison.
+  QList<QPair<QString, QString> > pairs;
+  for (int n = 0; n < 80; n++) {
+    QString base;
+    for (int i = 0; i < n; i++) {
+      base += QChar((ushort)(0x100 + (i * 37) % 500));
+    }
+    pairs.append(qMakePair(base, base));
+    pairs.append(qMakePair(base, base + "x"));
+    for (int i = 0; i < n; i++) {
+      QString other = base;
+      other[i] = QChar((ushort)(other[i].unicode() ^ 0x101));
+      pairs.append(qMakePair(base, other));
+      pairs.append(qMakePair(base.mid(i), base));
+    }
+  }
+  QString lines;
+  for (int i = 0; i < 200; i++) {
+    lines += QString(i % 7, QChar((ushort)0x263A)) + "\n";
+  }
+  const QString text1 = "The quick brown fox jumps over the lazy dog, " + lines + "and again the quick brown fox.";
+  const QString text2 = "A quick brown dog leaps over the lazy fox, " + lines + "and so does the quick brown cat.";
+
+  assertTrue("kernel_select: Scalar.", diff_match_patch::kernel_select("scalar"));
+  QList<int> prefixes;
+  QList<int> suffixes;
+  for (int i = 0; i < pairs.size(); i++) {
+    prefixes.append(dmp.diff_commonPrefix(pairs[i].first, pairs[i].second));
+    suffixes.append(dmp.diff_commonSuffix(pairs[i].first, pairs[i].second));
+  }
+  const QList<QVariant> tokens = dmp.diff_linesToChars(text1, lines + text2);
+  const QList<Diff> diffs = dmp.diff_bisect(text1, text2, std::numeric_limits<clock_t>::max());
+
+  foreach(QString variant, diff_match_patch::kernel_variants()) {
+    assertTrue("kernel_select: " + variant + ".", diff_match_patch::kernel_select(variant));
+    assertEquals("kernel_variant: " + variant + ".", variant, diff_match_patch::kernel_variant());
+    bool prefixOk = true;
+    bool suffixOk = true;
+    for (int i = 0; i < pairs.size(); i++) {
+      prefixOk = prefixOk && prefixes[i] == dmp.diff_commonPrefix(pairs[i].first, pairs[i].second);
+      suffixOk = suffixOk && suffixes[i] == dmp.diff_commonSuffix(pairs[i].first, pairs[i].second);
+    }
+    assertTrue("diff_commonPrefix: " + variant + " kernel.", prefixOk);
+    assertTrue("diff_commonSuffix: " + variant + " kernel.", suffixOk);
+    assertEquals("diff_linesToChars: " + variant + " kernel.", tokens, dmp.diff_linesToChars(text1, lines + text2));
+    assertEquals("diff_bisect: " + variant + " kernel.", diffs, dmp.diff_bisect(text1, text2, std::numeric_limits<clock_t>::max()));
+  }
+  diff_match_patch::kernel_select(initial);
+}
+
+void diff_match_patch_test::testDiffCore() {
+  // Single owner arrays.
+  CoreArray<int> filled(3, 7);
+  assertEquals("CoreArray: Filled.", 21, filled[0] + filled[1] + filled[2]);
+  CoreArray<int> grown;
+  for (int i = 0; i < 100; i++) {
+    grown.append(i);
+  }
+  assertEquals("CoreArray: Grown.", 99, grown[99]);
+  grown.swap(filled);
+  assertEquals("CoreArray: Swap.", 3, grown.size());
+  assertEquals("CoreArray: Swap other.", 100, filled.size());
+
+  // Pattern search agrees with QString::indexOf, for patterns both shorter
+  // and longer than the bits of the rolling hash.
+  QString text;
+  for (int i = 0; i < 300; i++) {
+    text += (i * i) % 7 < 3 ? "a" : "b";
+  }
+  text += QChar((ushort)0x2603);
+  const CoreChar *chars = reinterpret_cast<const CoreChar *>(text.constData());
+  bool searchOk = true;
+  for (int start = 0; start < text.length(); start += 13) {
+    for (int length = 0; length <= 40 && start + length <= text.length(); length += 3) {
+      searchOk = searchOk && text.indexOf(text.mid(start, length))
+          == DiffCore::indexOf(chars, text.length(), chars + start, length);
+    }
+  }
+  assertTrue("DiffCore::indexOf: Same as QString.", searchOk);
+  assertEquals("DiffCore::indexOf: Longer than text.", -1, DiffCore::indexOf(chars, 3, chars, 4));
+
+  const QString overlap1 = "123456xxx";
+  const QString overlap2 = "xxxabcd";
+  long long scanned = 0;
+  assertEquals("DiffCore::commonOverlap: Overlap.", 3, DiffCore::commonOverlap(
+      reinterpret_cast<const CoreChar *>(overlap1.constData()), overlap1.length(),
+      reinterpret_cast<const CoreChar *>(overlap2.constData()), overlap2.length(), scanned));
+  assertTrue("DiffCore::commonOverlap: Scanned.", scanned > 0);
+
+  // Diffs over text held elsewhere.
+  const QString equal = "abc";
+  const QString inserted = "12";
+  const CoreDiff diffs[] = {
+    {EQUAL, reinterpret_cast<const CoreChar *>(equal.constData()), 3},
+    {INSERT, reinterpret_cast<const CoreChar *>(inserted.constData()), 2}
+  };
+  assertEquals("DiffCore::textLength: Source.", 3, DiffCore::textLength(diffs, 2, INSERT));
+  assertEquals("DiffCore::textLength: Destination.", 5, DiffCore::textLength(diffs, 2, DELETE));
+  CoreChar destination[5];
+  DiffCore::text(diffs, 2, DELETE, destination);
+  assertEquals("DiffCore::text: Destination.", QString("abc12"), QString::fromUtf16(destination, 5));
+  // Past the end of text1, the rest of text1 maps onto text2 one to one.
+  assertEquals("DiffCore::xIndex: Past the end.", 7, DiffCore::xIndex(diffs, 2, 5));
+}
+
 void diff_match_patch_test::testDiffHalfmatch() {
   // Detect a halfmatch.
   dmp.Diff_Timeout = 1;
@@ -135,10 +269,176 @@ void diff_match_patch_test::testDiffHalfmatch() {
   // Optimal diff would be -q+x=H-i+e=lloHe+Hu=llo-Hew+y not -qHillo+x=HelloHe-w+Hulloy
   assertEquals("diff_halfMatch: Non-optimal halfmatch.", QString("qHillo,w,x,Hulloy,HelloHe").split(","), dmp.diff_halfMatch("qHilloHelloHew", "xHelloHeHulloy"));
 
+  dmp.Diff_HalfMatchSeeds = 4;
+  assertEquals("diff_halfMatch: Four seeds.", QString("12,90,a,z,345678").split(","), dmp.diff_halfMatch("1234567890", "a345678z"));
+
+  dmp.Diff_HalfMatchSeeds = 0;
+  assertEmpty("diff_halfMatch: No seeds.", dmp.diff_halfMatch("1234567890", "a345678z"));
+  dmp.Diff_HalfMatchSeeds = 2;
+
   dmp.Diff_Timeout = 0;
   assertEmpty("diff_halfMatch: Optimal no halfmatch.", dmp.diff_halfMatch("qHilloHelloHew", "xHelloHeHulloy"));
 }
 
+void diff_match_patch_test::testDiffFeatures() {
+  // Measure the inputs of the strategy cost model.
+  DiffFeatures features = dmp.diff_features("", "");
+  assertEquals("diff_features: Null case.", 0, features.lines1 + features.lines2);
+
+  features = dmp.diff_features("alpha\nbeta\nalpha\n", "beta\ngamma\n");
+  assertEquals("diff_features: Lines #1.", 3, features.lines1);
+  assertEquals("diff_features: Lines #2.", 2, features.lines2);
+  // 28 characters over 5 lines.
+  assertTrue("diff_features: Average line length.", qAbs(features.avgLineLength - 5.6) < 1e-9);
+  // Both alphas and the gamma occur on one side only.
+  assertTrue("diff_features: Unique lines.", qAbs(features.uniqueLineRatio - 0.6) < 1e-9);
+
+  // Choose the strategy.
+  QString text1;
+  QString text2;
+  for (int x = 0; x < 3; x++) {
+    text1 += QString(50, 'a') + "\n";
+    text2 += QString(50, 'b') + "\n";
+  }
+  assertTrue("diff_useLineMode: Over threshold.", dmp.diff_useLineMode(text1, text2));
+
+  dmp.Diff_LineModeThreshold = 200;
+  assertFalse("diff_useLineMode: Under threshold.", dmp.diff_useLineMode(text1, text2));
+  dmp.Diff_LineModeThreshold = 100;
+
+  dmp.Diff_TokenCost = 1e-8;
+  dmp.Diff_BisectCost = 1e-9;
+  assertTrue("diff_useLineMode: Cheap tokenizer.", dmp.diff_useLineMode(text1, text2));
+
+  dmp.Diff_TokenCost = 1e-6;
+  assertFalse("diff_useLineMode: Expensive tokenizer.", dmp.diff_useLineMode(text1, text2));
+  dmp.Diff_TokenCost = 0;
+  dmp.Diff_BisectCost = 0;
+}
+
+void diff_match_patch_test::testDiffEstimate() {
+  // Estimate similarity from sampled q-grams.
+  assertTrue("diff_similarity: Equality.", dmp.diff_similarity("abc", "abc") == 1.0);
+  assertTrue("diff_similarity: Null case.", dmp.diff_similarity("", "abc") == 0.0);
+  assertTrue("diff_similarity: No overlap.", dmp.diff_similarity("abcdefghijkl", "mnopqrstuvwx") == 0.0);
+  QString text1;
+  QString text2;
+  for (int x = 0; x < 100; x++) {
+    text1 += QString("Line %1 of the first text.\n").arg(x);
+    text2 += QString("Line %1 of the %2 text.\n").arg(x).arg(x % 10 == 0 ? "second" : "first");
+  }
+  double similarity = dmp.diff_similarity(text1, text2);
+  assertTrue("diff_similarity: Mostly similar.", similarity > 0.5 && similarity < 1.0);
+
+  // Predict the strategy of diff_main.
+  CostEstimate estimate = dmp.diff_estimate("abc", "abc");
+  assertEquals("diff_estimate: Equality.", CostEstimate::strStrategy(STRATEGY_NONE), CostEstimate::strStrategy(estimate.strategy));
+  assertEquals("diff_estimate: Equality edits.", 0, estimate.edits);
+
+  estimate = dmp.diff_estimate("abcxyz", "abc123xyz");
+  assertEquals("diff_estimate: Trivial.", CostEstimate::strStrategy(STRATEGY_TRIVIAL), CostEstimate::strStrategy(estimate.strategy));
+  assertEquals("diff_estimate: Trivial prefix.", 3, estimate.commonPrefix);
+  assertEquals("diff_estimate: Trivial suffix.", 3, estimate.commonSuffix);
+  assertEquals("diff_estimate: Trivial edits.", 3, estimate.edits);
+
+  estimate = dmp.diff_estimate("The cat sat.", "The dog ran.");
+  assertEquals("diff_estimate: Bisect.", CostEstimate::strStrategy(STRATEGY_BISECT), CostEstimate::strStrategy(estimate.strategy));
+
+  estimate = dmp.diff_estimate(text1, text2);
+  assertEquals("diff_estimate: Line mode.", CostEstimate::strStrategy(STRATEGY_LINEMODE), CostEstimate::strStrategy(estimate.strategy));
+  estimate = dmp.diff_estimate(text1, text2, false);
+  assertEquals("diff_estimate: No line mode.", CostEstimate::strStrategy(STRATEGY_BISECT), CostEstimate::strStrategy(estimate.strategy));
+  assertTrue("diff_estimate: Positive cost.", estimate.seconds > 0 && estimate.bytes > 0);
+
+  // Bigger jobs cost more.
+  CostEstimate bigger = dmp.diff_estimate(text1 + text1, text2 + text2, false);
+  assertTrue("diff_estimate: Monotonic time.", bigger.seconds > estimate.seconds);
+  assertTrue("diff_estimate: Monotonic memory.", bigger.bytes > estimate.bytes);
+
+  // The timeout caps the predicted time.
+  dmp.Diff_Timeout = 1e-6f;
+  estimate = dmp.diff_estimate(text1, text2, false);
+  assertTrue("diff_estimate: Timeout.", estimate.seconds < 0.001);
+  dmp.Diff_Timeout = 1.0f;
+
+  // Null inputs.
+  try {
+    dmp.diff_estimate(NULL, NULL);
+    assertFalse("diff_estimate: Null inputs.", true);
+  } catch (const char *ex) {
+    // Exception expected.
+  }
+}
+
+void diff_match_patch_test::testDiffSketch() {
+  // Sketch the lines or words of a text.
+  QString base;
+  for (int x = 0; x < 200; x++) {
+    base += QString("Line %1 of the base text.\n").arg(x);
+  }
+  QString edited = base;
+  edited.replace("Line 7 of", "Row 7 of");
+  QString unrelated;
+  for (int x = 0; x < 200; x++) {
+    unrelated += QString("Something else entirely, number %1.\n").arg(x);
+  }
+  QVector<uint> baseSketch = dmp.diff_sketch(base);
+  assertEquals("diff_sketch: Size.", 64, baseSketch.size());
+  assertTrue("diff_sketch: Deterministic.", baseSketch == dmp.diff_sketch(base));
+  assertTrue("diff_sketch: Line order is ignored.", dmp.diff_sketch("a\nb\n") == dmp.diff_sketch("b\na\n"));
+  assertTrue("diff_sketch: Words.", dmp.diff_sketch("the cat  sat", false) == dmp.diff_sketch("sat\nthe cat", false));
+  assertTrue("diff_sketch: Similar.", SketchIndex::similarity(baseSketch, dmp.diff_sketch(edited)) > 0.7);
+  assertTrue("diff_sketch: Dissimilar.", SketchIndex::similarity(baseSketch, dmp.diff_sketch(unrelated)) < 0.1);
+
+  // Find the nearest stored texts.
+  SketchIndex index;
+  index.insert("base", baseSketch);
+  index.insert("unrelated", dmp.diff_sketch(unrelated));
+  assertEquals("SketchIndex: Size.", 2, index.size());
+  QList<QPair<QString, double> > nearest = index.nearest(dmp.diff_sketch(edited), 2);
+  assertEquals("SketchIndex: Candidates.", 1, nearest.size());
+  assertEquals("SketchIndex: Nearest.", "base", nearest[0].first);
+
+  index.insert("edited", dmp.diff_sketch(edited));
+  nearest = index.nearest(baseSketch, 1);
+  assertEquals("SketchIndex: Count.", 1, nearest.size());
+  assertEquals("SketchIndex: Exact.", "base", nearest[0].first);
+  assertTrue("SketchIndex: Exact similarity.", nearest[0].second == 1.0);
+
+  assertTrue("SketchIndex: Remove.", index.remove("base"));
+  assertFalse("SketchIndex: Remove missing.", index.remove("base"));
+  nearest = index.nearest(baseSketch, 2);
+  assertEquals("SketchIndex: After remove.", "edited", nearest[0].first);
+
+  // Replace a sketch.
+  index.insert("edited", dmp.diff_sketch(unrelated));
+  assertEquals("SketchIndex: Replace.", 0, index.nearest(baseSketch, 2).size());
+
+  dmp.Sketch_Size = 16;
+  try {
+    index.insert("short", dmp.diff_sketch(base));
+    assertFalse("SketchIndex: Size mismatch.", true);
+  } catch (const char *ex) {
+    // Exception expected.
+  }
+  dmp.Sketch_Size = 2;
+  try {
+    SketchIndex(4).insert("tiny", dmp.diff_sketch(base));
+    assertFalse("SketchIndex: Sketch smaller than a band.", true);
+  } catch (const char *ex) {
+    // Exception expected.
+  }
+  dmp.Sketch_Size = 64;
+
+  // Texts without tokens are similar to nothing.
+  assertTrue("diff_sketch: Empty.", SketchIndex::similarity(dmp.diff_sketch(""), dmp.diff_sketch("")) == 0.0);
+  assertTrue("diff_sketch: No words.", SketchIndex::similarity(dmp.diff_sketch(" \n ", false), dmp.diff_sketch("", false)) == 0.0);
+  index = SketchIndex();
+  index.insert("empty", dmp.diff_sketch(""));
+  index.insert("blank", dmp.diff_sketch("", false));
+  assertEquals("SketchIndex: Empty text.", 0, index.nearest(dmp.diff_sketch(""), 2).size());
+}
+
 void diff_match_patch_test::testDiffLinesToChars() {
   // Convert lines down to characters.
   QStringList tmpVector;
@@ -190,6 +490,24 @@ void diff_match_patch_test::testDiffLinesToChars() {
   tmpVarList << QVariant::fromValue(QString(""));
   tmpVarList << QVariant::fromValue(tmpVector);
   assertEquals("diff_linesToChars: More than 256.", tmpVarList, dmp.diff_linesToChars(lines, ""));
+
+  // Several chunks on several threads give the same tokens as one thread.
+  QString text1;
+  QString text2;
+  for (int x = 0; x < 40000; x++) {
+    text1 += QString("Line %1\n").arg(x % 7000);
+    text2 += QString("Line %1\n").arg((x * 7) % 9000);
+  }
+  text1 += "Unended";
+  text2 += "Unended";
+  dmp.Diff_Threads = 1;
+  tmpVarList = dmp.diff_linesToChars(text1, text2);
+  QList<QVariant> tmpVarList2 = dmp.diff_linesToChars("", text2);
+  dmp.Diff_Threads = 4;
+  assertEquals("diff_linesToChars: Parallel.", tmpVarList, dmp.diff_linesToChars(text1, text2));
+  dmp.Diff_Threads = 3;
+  assertEquals("diff_linesToChars: Parallel, empty text1.", tmpVarList2, dmp.diff_linesToChars("", text2));
+  dmp.Diff_Threads = 1;
 }
 
 void diff_match_patch_test::testDiffCharsToLines() {
@@ -361,6 +679,37 @@ void diff_match_patch_test::testDiffCleanupSemantic() {
   assertEquals("diff_cleanupSemantic: Two overlap eliminations.", diffList(Diff(DELETE, "abcd"), Diff(EQUAL, "1212"), Diff(INSERT, "efghi"), Diff(EQUAL, "----"), Diff(DELETE, "A"), Diff(EQUAL, "3"), Diff(INSERT, "BC")), diffs);
 }
 
+void diff_match_patch_test::testDiffCleanupSemanticTokens() {
+  // Cleanup a diff of line tokens before converting it back to lines.
+  QStringList lineArray;
+  lineArray << "" << "alpha\n" << "beta\n" << "\n" << "gamma\n" << "delta\n"
+      << "this line is longer than the edits\n" << "x\n" << "y\n";
+  QString tokens[9];
+  for (int i = 0; i < 9; i++) {
+    tokens[i] = QString(QChar((ushort)i));
+  }
+  QList<Diff> diffs;
+  dmp.diff_cleanupSemanticTokens(diffs, lineArray);
+  assertEquals("diff_cleanupSemanticTokens: Null case.", QList<Diff>(), diffs);
+
+  diffs = diffList(Diff(DELETE, tokens[1]), Diff(INSERT, tokens[2]), Diff(EQUAL, tokens[3]), Diff(DELETE, tokens[4]), Diff(INSERT, tokens[5]));
+  dmp.diff_cleanupSemanticTokens(diffs, lineArray);
+  dmp.diff_charsToLines(diffs, lineArray);
+  assertEquals("diff_cleanupSemanticTokens: Blank line elimination.", diffList(Diff(DELETE, "alpha\n\ngamma\n"), Diff(INSERT, "beta\n\ndelta\n")), diffs);
+
+  diffs = diffList(Diff(DELETE, tokens[7]), Diff(EQUAL, tokens[6]), Diff(INSERT, tokens[8]));
+  dmp.diff_cleanupSemanticTokens(diffs, lineArray);
+  dmp.diff_charsToLines(diffs, lineArray);
+  assertEquals("diff_cleanupSemanticTokens: Weighted by line length.", diffList(Diff(DELETE, "x\n"), Diff(EQUAL, "this line is longer than the edits\n"), Diff(INSERT, "y\n")), diffs);
+
+  diffs = diffList(Diff(EQUAL, tokens[3] + tokens[1]), Diff(INSERT, tokens[4] + tokens[3] + tokens[1]), Diff(EQUAL, tokens[2]));
+  dmp.diff_cleanupSemanticTokens(diffs, lineArray);
+  dmp.diff_charsToLines(diffs, lineArray);
+  QList<Diff> lines = diffList(Diff(EQUAL, "\nalpha\n"), Diff(INSERT, "gamma\n\nalpha\n"), Diff(EQUAL, "beta\n"));
+  dmp.diff_cleanupSemantic(lines);
+  assertEquals("diff_cleanupSemanticTokens: Shift by lines.", lines, diffs);
+}
+
 void diff_match_patch_test::testDiffCleanupEfficiency() {
   // Cleanup operationally trivial equalities.
   dmp.Diff_EditCost = 4;
@@ -397,11 +746,75 @@ void diff_match_patch_test::testDiffPrettyHtml() {
   assertEquals("diff_prettyHtml:", "<span>a&para;<br></span><del style=\"background:#ffe6e6;\">&lt;B&gt;b&lt;/B&gt;</del><ins style=\"background:#e6ffe6;\">c&amp;d</ins>", dmp.diff_prettyHtml(diffs));
 }
 
+void diff_match_patch_test::testDiffPrettyHtmlWindow() {
+  // Pretty print a window of the diff.
+  QList<Diff> diffs = diffList(Diff(EQUAL, "a\n"), Diff(DELETE, "<B>b</B>"), Diff(INSERT, "c&d"));
+  DiffIndex index(diffs);
+  assertEquals("diff_prettyHtml: Whole window.", dmp.diff_prettyHtml(diffs), dmp.diff_prettyHtml(index, 0, 5));
+
+  assertEquals("diff_prettyHtml: Clipped window.", "<span>&para;<br></span><del style=\"background:#ffe6e6;\">&lt;B&gt;b&lt;/B&gt;</del><ins style=\"background:#e6ffe6;\">c</ins>", dmp.diff_prettyHtml(index, 1, 3));
+
+  assertEquals("diff_prettyHtml: Escaping at the edge.", "<ins style=\"background:#e6ffe6;\">&amp;d</ins>", dmp.diff_prettyHtml(index, 3, 10));
+
+  assertEquals("diff_prettyHtml: Empty window.", "", dmp.diff_prettyHtml(index, 4, 3));
+
+  diffs = diffList(Diff(EQUAL, "x"), Diff(INSERT, QString("y") + QChar(0xd83d) + QChar(0xde00)), Diff(DELETE, "z"));
+  index = DiffIndex(diffs);
+  assertEquals("diff_prettyHtml: Surrogate pair.", QString("<ins style=\"background:#e6ffe6;\">y") + QChar(0xd83d) + QChar(0xde00) + "</ins>", dmp.diff_prettyHtml(index, 1, 3));
+  assertEquals("diff_prettyHtml: Surrogate pair after the edge.", "<del style=\"background:#ffe6e6;\">z</del>", dmp.diff_prettyHtml(index, 3, 4));
+  // Two adjacent windows split at the pair render it once.
+  QString tiles = dmp.diff_prettyHtml(index, 0, 3) + dmp.diff_prettyHtml(index, 3, 4);
+  tiles.replace(QRegExp("</(span|ins|del)><\\1[^>]*>"), "");
+  assertEquals("diff_prettyHtml: Surrogate pair tiles.", dmp.diff_prettyHtml(diffs), tiles);
+
+  // Hunk navigation.
+  diffs = diffList(Diff(EQUAL, "The "), Diff(DELETE, "cat"), Diff(INSERT, "dog"), Diff(EQUAL, " sat on the "), Diff(INSERT, "red "), Diff(EQUAL, "mat."), Diff(DELETE, "!"));
+  index = DiffIndex(diffs);
+  assertEquals("DiffIndex: Lengths.", 24, index.length1());
+  assertEquals("DiffIndex: Lengths.", 27, index.length2());
+  QStringList strHunks;
+  foreach(DiffHunk hunk, index.hunks()) {
+    strHunks.append(hunk.toString());
+  }
+  assertEquals("DiffIndex: Hunks.", QStringList() << "DiffHunk(1+2,-4,3,+4,3)" << "DiffHunk(4+1,-19,0,+19,4)" << "DiffHunk(6+1,-23,1,+27,0)", strHunks);
+  assertEquals("DiffIndex: Hunk at start.", 0, index.hunkAt(0));
+  assertEquals("DiffIndex: Hunk in equality.", 1, index.hunkAt(8));
+  assertEquals("DiffIndex: Hunk at end.", 2, index.hunkAt(27));
+  assertEquals("DiffIndex: Diff at location.", 3, index.diffAt(7));
+  assertEquals("DiffIndex: Diff at deletion.", 1, index.diffAt(4));
+
+  assertEquals("diff_prettyHtmlHunks: One hunk.", "<ins style=\"background:#e6ffe6;\">red </ins>", dmp.diff_prettyHtmlHunks(index, 1, 1));
+  assertEquals("diff_prettyHtmlHunks: Range.", "<ins style=\"background:#e6ffe6;\">red </ins><span>mat.</span><del style=\"background:#ffe6e6;\">!</del>", dmp.diff_prettyHtmlHunks(index, 1, 5));
+  assertEquals("diff_prettyHtml: Trailing deletion.", "<span>mat.</span><del style=\"background:#ffe6e6;\">!</del>", dmp.diff_prettyHtml(index, 23, 27));
+  assertEquals("diff_prettyHtml: Empty window at the end.", "", dmp.diff_prettyHtml(index, 27, 27));
+  diffs = diffList(Diff(DELETE, "gone"));
+  index = DiffIndex(diffs);
+  assertEquals("diff_prettyHtml: Empty text2.", dmp.diff_prettyHtml(diffs), dmp.diff_prettyHtml(index, 0, 0));
+
+  // Pages cover the diff exactly once.
+  QString text1, text2;
+  for (int x = 0; x < 300; x++) {
+    text1 += QString("Line %1 <of> text1 & more\n").arg(x);
+    text2 += QString("Line %1 <of> %2 & more\n").arg(x).arg(x % 7 == 0 ? "text2" : "text1");
+  }
+  text1 += "Trailing line\n";
+  diffs = dmp.diff_main(text1, text2, false);
+  index = DiffIndex(diffs);
+  QString pages;
+  for (int start = 0; start < index.length2(); start += 97) {
+    pages += dmp.diff_prettyHtml(index, start, start + 97);
+  }
+  pages.replace(QRegExp("</(span|ins|del)><\\1[^>]*>"), "");
+  QString html = dmp.diff_prettyHtml(diffs);
+  assertEquals("diff_prettyHtml: Pages.", html, pages);
+}
+
 void diff_match_patch_test::testDiffText() {
   // Compute the source and destination texts.
   QList<Diff> diffs = diffList(Diff(EQUAL, "jump"), Diff(DELETE, "s"), Diff(INSERT, "ed"), Diff(EQUAL, " over "), Diff(DELETE, "the"), Diff(INSERT, "a"), Diff(EQUAL, " lazy"));
   assertEquals("diff_text1:", "jumps over the lazy", dmp.diff_text1(diffs));
   assertEquals("diff_text2:", "jumped over a lazy", dmp.diff_text2(diffs));
+  assertFalse("diff_text1: Empty, not null.", dmp.diff_text1(diffList(Diff(EQUAL, ""), Diff(INSERT, "a"))).isNull());
 }
 
 void diff_match_patch_test::testDiffDelta() {
@@ -464,6 +877,73 @@ void diff_match_patch_test::testDiffDelta() {
   assertEquals("diff_fromDelta: Unchanged characters.", diffs, dmp.diff_fromDelta("", delta));
 }
 
+void diff_match_patch_test::testDiffCompressedDelta() {
+  // Round trip through the compressed delta.
+  QList<Diff> diffs = diffList(Diff(EQUAL, "jump"), Diff(DELETE, "s"), Diff(INSERT, "ed"), Diff(EQUAL, " over "), Diff(DELETE, "the"), Diff(INSERT, "a"), Diff(EQUAL, " lazy"), Diff(INSERT, "old dog"));
+  QString text1 = dmp.diff_text1(diffs);
+  QByteArray delta = dmp.diff_toCompressedDelta(diffs);
+  assertEquals("diff_toCompressedDelta: Header.", "DMPZ", QString(delta.left(4)));
+  assertEquals("diff_fromCompressedDelta: Normal.", diffs, dmp.diff_fromCompressedDelta(text1, delta));
+
+  assertEquals("diff_fromCompressedDelta: Null case.", QList<Diff>(), dmp.diff_fromCompressedDelta("", dmp.diff_toCompressedDelta(QList<Diff>())));
+
+  diffs = diffList(Diff(EQUAL, QString::fromWCharArray((const wchar_t*) L"\u0680 \000 \t %", 7)), Diff(DELETE, QString::fromWCharArray((const wchar_t*) L"\u0681 \001 \n ^", 7)), Diff(INSERT, QString::fromWCharArray((const wchar_t*) L"\u0682 \002 \\ |\uffff", 8)), Diff(EQUAL, ""));
+  text1 = dmp.diff_text1(diffs);
+  assertEquals("diff_fromCompressedDelta: Unicode.", diffs, dmp.diff_fromCompressedDelta(text1, dmp.diff_toCompressedDelta(diffs)));
+
+  // Larger diffs compress well below the text delta.
+  QString text2;
+  text1.clear();
+  for (int x = 0; x < 2000; x++) {
+    const QString line = QString("Line %1 of the document.\n").arg(x * 7 % 300);
+    text1 += line;
+    text2 += x % 50 == 0 ? QString("Changed line %1.\n").arg(x) : line;
+  }
+  diffs = dmp.diff_main(text1, text2, false);
+  delta = dmp.diff_toCompressedDelta(diffs);
+  assertEquals("diff_fromCompressedDelta: Large.", diffs, dmp.diff_fromCompressedDelta(text1, delta));
+  assertTrue("diff_toCompressedDelta: Smaller than text.", delta.size() < dmp.diff_toDelta(diffs).toUtf8().size() / 2);
+
+  // Deltas read from a stream are applied as they are decoded, and leave
+  // what follows them unread.
+  QByteArray stream = delta + dmp.diff_toCompressedDelta(dmp.diff_main(text2, text1, false));
+  QBuffer buffer(&stream);
+  buffer.open(QIODevice::ReadOnly);
+  assertEquals("diff_applyCompressedDelta: Forward.", text2, dmp.diff_applyCompressedDelta(text1, buffer));
+  assertEquals("diff_applyCompressedDelta: Back.", text1, dmp.diff_applyCompressedDelta(text2, buffer));
+  assertTrue("diff_applyCompressedDelta: At end.", buffer.atEnd());
+
+  // Generates error (wrong source length).
+  try {
+    dmp.diff_fromCompressedDelta(text1 + "x", delta);
+    assertFalse("diff_fromCompressedDelta: Too long.", true);
+  } catch (QString ex) {
+    // Exception expected.
+  }
+  try {
+    dmp.diff_fromCompressedDelta(text1.mid(1), delta);
+    assertFalse("diff_fromCompressedDelta: Too short.", true);
+  } catch (QString ex) {
+    // Exception expected.
+  }
+
+  // Generates error (truncated).
+  try {
+    dmp.diff_fromCompressedDelta(text1, delta.left(delta.size() - 1));
+    assertFalse("diff_fromCompressedDelta: Truncated.", true);
+  } catch (QString ex) {
+    // Exception expected.
+  }
+
+  // Generates error (not a compressed delta).
+  try {
+    dmp.diff_fromCompressedDelta(text1, dmp.diff_toDelta(diffs).toUtf8());
+    assertFalse("diff_fromCompressedDelta: Bad header.", true);
+  } catch (QString ex) {
+    // Exception expected.
+  }
+}
+
 void diff_match_patch_test::testDiffXIndex() {
   // Translate a location in text1 to text2.
   QList<Diff> diffs = diffList(Diff(DELETE, "a"), Diff(INSERT, "1234"), Diff(EQUAL, "xyz"));
@@ -499,6 +979,456 @@ void diff_match_patch_test::testDiffBisect() {
   assertEquals("diff_bisect: Timeout.", diffs, dmp.diff_bisect(a, b, 0));
 }
 
+void diff_match_patch_test::testDiffBounded() {
+  // Diff only if the texts are close.
+  QList<Diff> diffs;
+  assertTrue("diff_bounded: Equality.", dmp.diff_bounded("abc", "abc", 0, diffs));
+  assertEquals("diff_bounded: Equality.", diffList(Diff(EQUAL, "abc")), diffs);
+
+  assertTrue("diff_bounded: Null case.", dmp.diff_bounded("", "", 0, diffs));
+  assertEquals("diff_bounded: Null case.", diffList(), diffs);
+
+  assertTrue("diff_bounded: Within budget.", dmp.diff_bounded("The cat sat.", "The hat sat.", 2, diffs));
+  assertEquals("diff_bounded: Within budget.", diffList(Diff(EQUAL, "The "), Diff(DELETE, "c"), Diff(INSERT, "h"), Diff(EQUAL, "at sat.")), diffs);
+
+  assertFalse("diff_bounded: Over budget.", dmp.diff_bounded("The cat sat.", "The hat sat.", 1, diffs));
+  assertEquals("diff_bounded: Over budget.", diffList(), diffs);
+
+  assertFalse("diff_bounded: Length difference.", dmp.diff_bounded("abc", "abcdefg", 3, diffs));
+
+  assertTrue("diff_bounded: Everything replaced.", dmp.diff_bounded("abc", "xyz", 6, diffs));
+  assertEquals("diff_bounded: Everything replaced.", diffList(Diff(DELETE, "abc"), Diff(INSERT, "xyz")), diffs);
+
+  // Still minimal when the budget would cover replacing everything, where
+  // diff_main takes a half match costing 14 edits.
+  QList<Diff> minimal;
+  assertTrue("diff_bounded: Minimal budget.", dmp.diff_bounded("qHilloHelloHew", "xHelloHeHulloy", 10, minimal));
+  assertTrue("diff_bounded: Ample budget.", dmp.diff_bounded("qHilloHelloHew", "xHelloHeHulloy", 28, diffs));
+  assertEquals("diff_bounded: Ample budget.", minimal, diffs);
+
+  // Agrees with the minimal diff, which needs no timeout and no half match.
+  dmp.Diff_Timeout = 0;
+  uint seed = 1;
+  for (int test = 0; test < 200; test++) {
+    QString text1, text2;
+    for (int x = 0; x < 40; x++) {
+      seed = seed * 1103515245 + 12345;
+      const QChar c = QChar('a' + (seed >> 16) % 4);
+      text1 += c;
+      seed = seed * 1103515245 + 12345;
+      if ((seed >> 16) % 5 != 0) {
+        text2 += c;
+      } else {
+        text2 += QChar('a' + (seed >> 8) % 4);
+      }
+    }
+    int edits = 0;
+    foreach(Diff aDiff, dmp.diff_main(text1, text2, false)) {
+      if (aDiff.operation != EQUAL) {
+        edits += aDiff.text.length();
+      }
+    }
+    if (!dmp.diff_bounded(text1, text2, edits, diffs)) {
+      assertTrue("diff_bounded: Exact budget.", false);
+    }
+    QStringList texts = diff_rebuildtexts(diffs);
+    int boundedEdits = 0;
+    foreach(Diff aDiff, diffs) {
+      if (aDiff.operation != EQUAL) {
+        boundedEdits += aDiff.text.length();
+      }
+    }
+    if (texts[0] != text1 || texts[1] != text2 || boundedEdits != edits) {
+      assertEquals("diff_bounded: Minimal diff.", text1 + "," + text2 + "," + QString::number(edits), texts[0] + "," + texts[1] + "," + QString::number(boundedEdits));
+    }
+    if (dmp.diff_bounded(text1, text2, edits - 1, diffs)) {
+      assertFalse("diff_bounded: Budget too small.", true);
+    }
+  }
+  dmp.Diff_Timeout = 1.0f;
+
+  // Test null inputs.
+  try {
+    dmp.diff_bounded(NULL, NULL, 0, diffs);
+    assertFalse("diff_bounded: Null inputs.", true);
+  } catch (const char* ex) {
+    // Exception expected.
+  }
+}
+
+void diff_match_patch_test::testDiffChunked() {
+  // Diff only the regions where the chunk trees disagree.
+  QString text1;
+  for (int x = 0; x < 2000; x++) {
+    text1 += QString("Line %1 of a long document.\n").arg(x);
+  }
+  QString text2 = text1;
+  text2.replace("Line 150 of", "Line 150, edited, of");
+  text2.replace("Line 1700 of a long document.\n", "");
+  ChunkTree tree1(text1, 256);
+  ChunkTree tree2(text2, 256);
+  assertTrue("ChunkTree: Chunks.", tree1.chunkCount() > 100);
+
+  QList<DiffHunk> regions = tree1.changes(tree2);
+  assertEquals("ChunkTree: Changed regions.", 2, regions.size());
+  int changed = 0;
+  foreach(DiffHunk region, regions) {
+    changed += region.length1;
+  }
+  assertTrue("ChunkTree: Regions are small.", changed < text1.length() / 20);
+
+  QList<Diff> diffs = dmp.diff_chunked(tree1, tree2);
+  QStringList texts = diff_rebuildtexts(diffs);
+  assertEquals("diff_chunked: Text1.", text1, texts[0]);
+  assertEquals("diff_chunked: Text2.", text2, texts[1]);
+  assertEquals("diff_chunked: Minimal.", dmp.diff_levenshtein(dmp.diff_main(text1, text2)), dmp.diff_levenshtein(diffs));
+
+  assertEquals("ChunkTree: Identical.", 0, tree1.changes(ChunkTree(text1, 256)).size());
+  assertTrue("ChunkTree: Identical hash.", tree1.hash() == ChunkTree(text1, 256).hash());
+  assertFalse("ChunkTree: Different hash.", tree1.hash() == tree2.hash());
+  diffs = dmp.diff_chunked(tree1, tree1);
+  assertEquals("diff_chunked: Identical.", diffList(Diff(EQUAL, text1)), diffs);
+
+  diffs = dmp.diff_chunked(ChunkTree("", 256), tree2);
+  assertEquals("diff_chunked: From empty.", diffList(Diff(INSERT, text2)), diffs);
+
+  // Save and restore.
+  ChunkTree restored = ChunkTree::fromText(tree1.toText(), text1);
+  assertEquals("ChunkTree: toText.", tree1.toText(), restored.toText());
+  assertEquals("ChunkTree: fromText.", 2, restored.changes(tree2).size());
+  try {
+    ChunkTree::fromText(tree1.toText(), text2);
+    assertFalse("ChunkTree: fromText wrong text.", true);
+  } catch (QString ex) {
+    // Exception expected.
+  }
+
+  // Update in place matches a fresh scan.
+  ChunkTree updated = tree1;
+  updated.update(dmp.diff_main(text1, text2));
+  assertEquals("ChunkTree: Update.", tree2.toText(), updated.toText());
+  assertEquals("ChunkTree: Updated text.", text2, updated.text());
+  QString text3 = text2 + "Appended.\n";
+  text3.prepend("Prepended.\n");
+  updated.update(dmp.diff_main(text2, text3));
+  assertEquals("ChunkTree: Update ends.", ChunkTree(text3, 256).toText(), updated.toText());
+
+  try {
+    tree1.changes(ChunkTree(text2, 512));
+    assertFalse("ChunkTree: Chunk size mismatch.", true);
+  } catch (const char* ex) {
+    // Exception expected.
+  }
+}
+
+void diff_match_patch_test::testDiffPipeline() {
+  // Diff two inputs with the stages running concurrently.
+  QByteArray bytes1 = "";
+  QByteArray bytes2 = "";
+  QBuffer input1(&bytes1);
+  QBuffer input2(&bytes2);
+  input1.open(QIODevice::ReadOnly);
+  input2.open(QIODevice::ReadOnly);
+  QString delta;
+  QTextStream deltaStream(&delta);
+  QList<Diff> diffs = dmp.diff_pipeline(input1, input2, deltaStream);
+  deltaStream.flush();
+  assertEquals("diff_pipeline: Null case.", QList<Diff>(), diffs);
+  assertEquals("diff_pipeline: Null delta.", QString(""), delta);
+
+  bytes1 = "alpha\nbeta\ngamma\ndelta\n";
+  bytes2 = "alpha\nbeta\ngamma-ray\ndelta\nepsilon";
+  QBuffer input3(&bytes1);
+  QBuffer input4(&bytes2);
+  input3.open(QIODevice::ReadOnly);
+  input4.open(QIODevice::ReadOnly);
+  QTextStream deltaStream2(&delta);
+  diffs = dmp.diff_pipeline(input3, input4, deltaStream2);
+  deltaStream2.flush();
+  assertEquals("diff_pipeline: Simple case.", diffList(Diff(EQUAL, "alpha\nbeta\ngamma"), Diff(INSERT, "-ray"), Diff(EQUAL, "\ndelta\n"), Diff(INSERT, "epsilon")), diffs);
+  assertEquals("diff_pipeline: Simple delta.", dmp.diff_toDelta(diffs), delta);
+
+  // Several read blocks, with multi-byte characters across their edges.
+  QString text1;
+  QString text2;
+  for (int x = 0; x < 20000; x++) {
+    const QString line = QString::fromUtf8("l\xc3\xadnea %1 \xe2\x82\xac\n").arg(x);
+    text1 += line;
+    text2 += (x % 1000 == 0) ? QString("changed %1\n").arg(x) : line;
+    if (x % 3000 == 0) {
+      text2 += QString::fromUtf8("inserted \xf0\x9f\x98\x80\n");
+    }
+  }
+  bytes1 = text1.toUtf8();
+  bytes2 = text2.toUtf8();
+  QBuffer input5(&bytes1);
+  QBuffer input6(&bytes2);
+  input5.open(QIODevice::ReadOnly);
+  input6.open(QIODevice::ReadOnly);
+  delta = "";
+  QTextStream deltaStream3(&delta);
+  diffs = dmp.diff_pipeline(input5, input6, deltaStream3);
+  deltaStream3.flush();
+  assertEquals("diff_pipeline: Text1.", text1, dmp.diff_text1(diffs));
+  assertEquals("diff_pipeline: Text2.", text2, dmp.diff_text2(diffs));
+  assertEquals("diff_pipeline: Delta.", diffs, dmp.diff_fromDelta(text1, delta));
+  assertEquals("diff_pipeline: Same as line mode.", dmp.diff_main(text1, text2, true), diffs);
+
+  // Many blocks, with repeated lines for edits to shift across their edges.
+  dmp.Diff_Timeout = 0;
+  text1 = "";
+  text2 = "";
+  for (int x = 0; x < 3000; x++) {
+    const QString line = (x % 4 == 0) ? QString("}\n") : QString("row %1\n").arg(x % 50);
+    text1 += line;
+    if (x % 97 == 0) {
+      text2 += "}\nrow 1\n";
+    }
+    text2 += (x % 131 == 0) ? QString("edited %1\n").arg(x) : line;
+  }
+  bytes1 = text1.toUtf8();
+  bytes2 = text2.toUtf8();
+  QBuffer input9(&bytes1);
+  QBuffer input10(&bytes2);
+  input9.open(QIODevice::ReadOnly);
+  input10.open(QIODevice::ReadOnly);
+  delta = "";
+  QTextStream deltaStream5(&delta);
+  diffs = dmp.diff_pipeline(input9, input10, deltaStream5);
+  deltaStream5.flush();
+  assertEquals("diff_pipeline: Blocks text1.", text1, dmp.diff_text1(diffs));
+  assertEquals("diff_pipeline: Blocks text2.", text2, dmp.diff_text2(diffs));
+  QList<Diff> merged = diffs;
+  dmp.diff_cleanupMerge(merged);
+  assertEquals("diff_pipeline: Blocks merged.", merged, diffs);
+  assertEquals("diff_pipeline: Blocks as short as line mode.", dmp.diff_levenshtein(dmp.diff_main(text1, text2, true)), dmp.diff_levenshtein(diffs));
+  assertEquals("diff_pipeline: Blocks delta.", diffs, dmp.diff_fromDelta(text1, delta));
+  dmp.Diff_Timeout = 1.0f;
+
+  // More unique lines than there are tokens.
+  text1 = "";
+  for (int x = 0; x < 70000; x++) {
+    text1 += QString("%1\n").arg(x);
+  }
+  text2 = text1;
+  text2.insert(text2.length() / 2, "middle\n");
+  bytes1 = text1.toUtf8();
+  bytes2 = text2.toUtf8();
+  QBuffer input7(&bytes1);
+  QBuffer input8(&bytes2);
+  input7.open(QIODevice::ReadOnly);
+  input8.open(QIODevice::ReadOnly);
+  delta = "";
+  QTextStream deltaStream4(&delta);
+  diffs = dmp.diff_pipeline(input7, input8, deltaStream4);
+  deltaStream4.flush();
+  assertEquals("diff_pipeline: Untokenized text1.", text1, dmp.diff_text1(diffs));
+  assertEquals("diff_pipeline: Untokenized text2.", text2, dmp.diff_text2(diffs));
+  assertEquals("diff_pipeline: Untokenized delta.", diffs, dmp.diff_fromDelta(text1, delta));
+}
+
+void diff_match_patch_test::testStreamingDiff() {
+  // Diff texts as they arrive.
+  StreamingDiff stream(dmp, "alpha\nbeta\ngamma\n");
+  stream.append2("alpha\nbe");
+  assertEquals("StreamingDiff: Common prefix.", 6, stream.committed2());
+  assertEquals("StreamingDiff: Prefix diffs.", diffList(Diff(EQUAL, "alpha\n")), stream.takeDiffs());
+  stream.append2("ta\ndelta\n");
+  stream.finish2();
+  assertTrue("StreamingDiff: Finished.", stream.isFinished());
+  assertEquals("StreamingDiff: Rest.", diffList(Diff(EQUAL, "beta\n"), Diff(DELETE, "gamm"), Diff(INSERT, "delt"), Diff(EQUAL, "a\n")), stream.takeDiffs());
+
+  StreamingDiff empty(dmp);
+  empty.finish1();
+  empty.finish2();
+  assertEquals("StreamingDiff: Null case.", QList<Diff>(), empty.takeDiffs());
+  assertTrue("StreamingDiff: Null case finished.", empty.isFinished());
+
+  // Most of a long text is committed before its end arrives.
+  QString text1;
+  QString text2;
+  for (int x = 0; x < 2000; x++) {
+    text1 += QString("Line %1 of the old text.\n").arg(x);
+    if (x % 100 == 7) {
+      text2 += QString("Line %1 of the new text.\n").arg(x);
+    } else if (x % 300 != 42) {
+      text2 += QString("Line %1 of the old text.\n").arg(x);
+    }
+  }
+  StreamingDiff upload(dmp, text1);
+  QList<Diff> diffs;
+  for (int x = 0; x < text2.length(); x += 1000) {
+    upload.append2(text2.mid(x, 1000));
+    diffs += upload.takeDiffs();
+  }
+  assertTrue("StreamingDiff: Committed early.", upload.committed2() > text2.length() - 1000);
+  upload.finish2();
+  diffs += upload.takeDiffs();
+  assertEquals("StreamingDiff: Text1.", text1, dmp.diff_text1(diffs));
+  assertEquals("StreamingDiff: Text2.", text2, dmp.diff_text2(diffs));
+  assertEquals("StreamingDiff: Minimal.", dmp.diff_levenshtein(dmp.diff_main(text1, text2, false)), dmp.diff_levenshtein(diffs));
+
+  // Both texts arrive at once.
+  StreamingDiff both(dmp);
+  diffs.clear();
+  for (int x = 0; x < text1.length() || x < text2.length(); x += 777) {
+    if (x < text1.length()) {
+      both.append1(text1.mid(x, 777));
+    }
+    if (x < text2.length()) {
+      both.append2(text2.mid(x, 777));
+    }
+    diffs += both.takeDiffs();
+  }
+  both.finish1();
+  both.finish2();
+  diffs += both.takeDiffs();
+  assertEquals("StreamingDiff: Both text1.", text1, dmp.diff_text1(diffs));
+  assertEquals("StreamingDiff: Both text2.", text2, dmp.diff_text2(diffs));
+
+  // Text2 runs ahead of text1; its lines are matched once text1 catches up.
+  StreamingDiff behind(dmp);
+  diffs.clear();
+  behind.append2(text2);
+  for (int x = 0; x < text1.length(); x += 1000) {
+    behind.append1(text1.mid(x, 1000));
+    diffs += behind.takeDiffs();
+  }
+  assertTrue("StreamingDiff: Text2 ahead.", behind.committed1() > text1.length() - 1000);
+  behind.finish1();
+  behind.finish2();
+  diffs += behind.takeDiffs();
+  assertEquals("StreamingDiff: Text2 ahead text1.", text1, dmp.diff_text1(diffs));
+  assertEquals("StreamingDiff: Text2 ahead text2.", text2, dmp.diff_text2(diffs));
+
+  try {
+    both.append2("more");
+    assertFalse("StreamingDiff: Append after end.", true);
+  } catch (const char *ex) {
+    // Exception expected.
+  }
+}
+
+void diff_match_patch_test::testDiffSession() {
+  // Diff successive versions, tokenizing each one once.
+  QStringList versions;
+  QString text;
+  for (int x = 0; x < 200; x++) {
+    text += QString("Line %1 of the document.\n").arg(x);
+  }
+  versions << text;
+  for (int v = 1; v < 4; v++) {
+    QStringList lines = versions.last().split("\n");
+    lines[v * 40] = QString("Line %1 changed in version %2.").arg(v * 40).arg(v);
+    lines.removeAt(v * 30);
+    lines.insert(v * 20, QString("Inserted in version %1.").arg(v));
+    versions << lines.join("\n");
+  }
+  DiffSession session(dmp, versions[0]);
+  assertEquals("DiffSession: Lines.", 200, session.lineCount());
+  for (int v = 1; v < versions.size(); v++) {
+    QList<Diff> diffs = session.next(versions[v]);
+    assertEquals("DiffSession: Text1.", versions[v - 1], dmp.diff_text1(diffs));
+    assertEquals("DiffSession: Text2.", versions[v], dmp.diff_text2(diffs));
+    assertEquals("DiffSession: Same as diff_main.", dmp.diff_main(versions[v - 1], versions[v], true), diffs);
+  }
+  assertEquals("DiffSession: Latest.", versions.last(), session.text());
+  // Each version brings two new lines.
+  assertEquals("DiffSession: New lines only.", 206, session.lineCount());
+
+  assertEquals("DiffSession: Equality.", diffList(Diff(EQUAL, versions.last())), session.next(versions.last()));
+  assertEquals("DiffSession: To empty.", diffList(Diff(DELETE, versions.last())), session.next(""));
+  assertEquals("DiffSession: From empty.", diffList(Diff(INSERT, "a\nb")), session.next("a\nb"));
+
+  // Two versions with more distinct lines than there are tokens.
+  QString text1;
+  for (int x = 0; x < 40000; x++) {
+    text1 += QString("a%1\n").arg(x);
+  }
+  QString text2 = text1;
+  for (int x = 0; x < 30000; x++) {
+    text2 += QString("b%1\n").arg(x);
+  }
+  DiffSession large(dmp, text1);
+  QList<Diff> diffs = large.next(text2);
+  assertEquals("DiffSession: Untokenized.", diffList(Diff(EQUAL, text1), Diff(INSERT, text2.mid(text1.length()))), diffs);
+  assertEquals("DiffSession: Untokenized latest.", text2, large.text());
+}
+
+void diff_match_patch_test::testDiffAlign() {
+  // Align one base against several variants.
+  QStringList variants;
+  variants << "abXdef" << "abcdefg" << "acdef" << "abcdef";
+  QList<AlignedRow> rows = dmp.diff_align("abcdef", variants);
+  QStringList strRows;
+  foreach(AlignedRow row, rows) {
+    strRows.append(row.toString());
+  }
+  assertEquals("diff_align: Rows.", QStringList()
+      << "AlignedRow(0,\"a\",[\"a\",\"a\",\"a\",\"a\"])"
+      << "AlignedRow(1,\"b\",[\"b\",\"b\",*\"\",\"b\"])"
+      << "AlignedRow(2,\"c\",[*\"X\",\"c\",\"c\",\"c\"])"
+      << "AlignedRow(3,\"def\",[\"def\",\"def\",\"def\",\"def\"])"
+      << "AlignedRow(6,\"\",[\"\",*\"g\",\"\",\"\"])", strRows);
+
+  // Insertions at the same point of the base share a row.
+  rows = dmp.diff_align("ac", QStringList() << "abc" << "axc" << "ac");
+  strRows.clear();
+  foreach(AlignedRow row, rows) {
+    strRows.append(row.toString());
+  }
+  assertEquals("diff_align: Shared insertion.", QStringList()
+      << "AlignedRow(0,\"a\",[\"a\",\"a\",\"a\"])"
+      << "AlignedRow(1,\"\",[*\"b\",*\"x\",\"\"])"
+      << "AlignedRow(1,\"c\",[\"c\",\"c\",\"c\"])", strRows);
+
+  assertEquals("diff_align: Empty base.", 1, dmp.diff_align("", QStringList() << "" << "a").size());
+  assertEquals("diff_align: No variants.", 1, dmp.diff_align("abc", QStringList()).size());
+
+  // Larger texts go through line mode against a shared table; each column
+  // still spells out its variant.
+  QString base;
+  for (int x = 0; x < 300; x++) {
+    base += QString("Line %1 of the document.\n").arg(x);
+  }
+  variants.clear();
+  for (int v = 0; v < 4; v++) {
+    QStringList lines = base.split("\n");
+    lines[40 + v * 50] = QString("Line %1 changed in variant %2.").arg(40 + v * 50).arg(v);
+    lines.removeAt(30 + v * 20);
+    lines.insert(100, QString("Inserted in variant %1.").arg(v));
+    variants << lines.join("\n");
+  }
+  rows = dmp.diff_align(base, variants);
+  QString text1;
+  QStringList texts;
+  for (int v = 0; v < variants.size(); v++) {
+    texts.append("");
+  }
+  int changedRows = 0;
+  foreach(AlignedRow row, rows) {
+    assertEquals("diff_align: Row start.", text1.length(), row.start);
+    text1 += row.base;
+    for (int v = 0; v < variants.size(); v++) {
+      texts[v] += row.variants[v];
+    }
+    if (row.isChanged()) {
+      changedRows++;
+    }
+  }
+  assertEquals("diff_align: Base.", base, text1);
+  assertEquals("diff_align: Variants.", variants, texts);
+  assertTrue("diff_align: Changes.", changedRows >= 3 && changedRows < rows.size());
+
+  // Generates error (null input).
+  try {
+    dmp.diff_align("abc", QStringList() << QString());
+    assertFalse("diff_align: Null inputs.", true);
+  } catch (const char *ex) {
+    // Exception expected.
+  }
+}
+
 void diff_match_patch_test::testDiffMain() {
   // Perform a trivial diff.
   QList<Diff> diffs = diffList();
@@ -590,6 +1520,69 @@ void diff_match_patch_test::testDiffMain() {
   }
 }
 
+void diff_match_patch_test::testDiffRecords() {
+  // Diff keyed records.
+  QList<Diff> diffs = diffList();
+  assertEquals("diff_records: Null case.", diffs, dmp.diff_records("", ""));
+
+  diffs = diffList(Diff(EQUAL, "a,1\nb,2\n"));
+  assertEquals("diff_records: Equality.", diffs, dmp.diff_records("a,1\nb,2\n", "a,1\nb,2\n"));
+
+  // Moved records are deleted and inserted, so that both texts are kept.
+  diffs = diffList(Diff(INSERT, "b,2\n"), Diff(EQUAL, "a,1\n"), Diff(DELETE, "b,2\n"));
+  assertEquals("diff_records: Reordered.", diffs, dmp.diff_records("a,1\nb,2\n", "b,2\na,1\n"));
+
+  diffs = diffList(Diff(INSERT, "a,1\n"), Diff(EQUAL, "b,2"), Diff(DELETE, "\na,1"));
+  assertEquals("diff_records: Reordered last record.", diffs, dmp.diff_records("b,2\na,1", "a,1\nb,2"));
+
+  diffs = diffList(Diff(EQUAL, "a,1,x\nb,"), Diff(DELETE, "2"), Diff(INSERT, "3"), Diff(EQUAL, ",y\n"));
+  assertEquals("diff_records: Changed field.", diffs, dmp.diff_records("a,1,x\nb,2,y\n", "a,1,x\nb,3,y\n"));
+
+  diffs = diffList(Diff(EQUAL, "a,1\n"), Diff(DELETE, "b,2"), Diff(INSERT, "c,3"), Diff(EQUAL, "\nd,4\n"), Diff(INSERT, "e,5\n"));
+  assertEquals("diff_records: Deleted and inserted.", diffs, dmp.diff_records("a,1\nb,2\nd,4\n", "a,1\nc,3\nd,4\ne,5\n"));
+
+  diffs = diffList(Diff(INSERT, "z,0\n"), Diff(EQUAL, "a,1"), Diff(INSERT, "\nc,3"));
+  assertEquals("diff_records: Unended records.", diffs, dmp.diff_records("a,1", "z,0\na,1\nc,3"));
+
+  diffs = diffList(Diff(INSERT, "k=2;"), Diff(EQUAL, "k=1;k="), Diff(DELETE, "2"), Diff(INSERT, "3"), Diff(EQUAL, ";"));
+  assertEquals("diff_records: Duplicate keys.", diffs, dmp.diff_records("k=1;k=2;", "k=2;k=1;k=3;", ";", QRegExp("^([^=]*)="), ""));
+
+  diffs = diffList(Diff(EQUAL, "a 1"), Diff(DELETE, ","), Diff(INSERT, " "), Diff(EQUAL, "2\n"));
+  assertEquals("diff_records: Field count changed.", diffs, dmp.diff_records("a 1,2\n", "a 1 2\n", "\n", QRegExp("^(\\S*)"), ","));
+
+  // The diffs plug into the patch functions.
+  QString text1 = "id,name\n1,apple\n2,banana\n3,cherry\n";
+  QString text2 = "id,name\n3,cherry\n2,blueberry\n1,apple\n";
+  diffs = dmp.diff_records(text1, text2);
+  assertEquals("diff_records: Text1.", text1, dmp.diff_text1(diffs));
+  assertEquals("diff_records: Text2.", text2, dmp.diff_text2(diffs));
+  QList<Patch> patches = dmp.patch_make(text1, diffs);
+  assertEquals("diff_records: Patch.", text2, dmp.patch_apply(patches, text1).first);
+
+  // Rows shuffled, changed, dropped and added.
+  text1 = "";
+  text2 = "";
+  for (int x = 0; x < 50; x++) {
+    text1 += QString("%1,row %2\n").arg(x).arg(x);
+    const int y = (x * 7) % 50;
+    if (y % 9 != 0) {
+      text2 += QString("%1,row %2\n").arg(y).arg(y % 5 == 0 ? -y : y);
+    }
+  }
+  text2 += "50,row 50";
+  diffs = dmp.diff_records(text1, text2);
+  assertEquals("diff_records: Shuffled text1.", text1, dmp.diff_text1(diffs));
+  assertEquals("diff_records: Shuffled text2.", text2, dmp.diff_text2(diffs));
+
+  // Null inputs.
+  try {
+    dmp.diff_records(NULL, NULL);
+    assertFalse("diff_records: Null inputs.", true);
+  } catch (const char *ex) {
+    // Exception expected.
+  }
+}
+
 
 //  MATCH TEST FUNCTIONS
 
@@ -652,6 +1645,30 @@ void diff_match_patch_test::testMatchBitap() {
 
   dmp.Match_Distance = 1000;  // Loose location.
   assertEquals("match_bitap: Distance test #3.", 0, dmp.match_bitap("abcdefghijklmnopqrstuvwxyz", "abcdefg", 24));
+
+  // Parallel search over a wide window gives the serial result.
+  QString text;
+  uint seed = 1;
+  for (int x = 0; x < 200000; x++) {
+    seed = seed * 1103515245 + 12345;
+    text += QChar('a' + (seed >> 16) % 8);
+  }
+  dmp.Match_Distance = 100000;
+  dmp.Match_Threshold = 0.6f;
+  QStringList serial;
+  QStringList parallel;
+  for (int x = 0; x < 12; x++) {
+    seed = seed * 1103515245 + 12345;
+    const int loc = (seed >> 8) % text.length();
+    QString pattern = text.mid((x * 16411) % (text.length() - 32), 12 + x);
+    pattern[x % pattern.length()] = QChar('z');
+    dmp.Match_Threads = 1;
+    serial.append(QString::number(dmp.match_bitap(text, pattern, loc)));
+    dmp.Match_Threads = 4;
+    parallel.append(QString::number(dmp.match_bitap(text, pattern, loc)));
+  }
+  assertEquals("match_bitap: Parallel.", serial, parallel);
+  dmp.Match_Threads = 1;
 }
 
 void diff_match_patch_test::testMatchMain() {
@@ -677,6 +1694,103 @@ void diff_match_patch_test::testMatchMain() {
   }
 }
 
+void diff_match_patch_test::testMatchCorpus() {
+  CorpusIndex index;
+  index.insert("fox", "The quick brown fox jumps over the lazy dog.");
+  index.insert("dog", "A quick brown dog naps in the sun.");
+  index.insert("none", "Nothing to see here.");
+  assertEquals("CorpusIndex: Size.", 3, index.size());
+
+  QList<CorpusMatch> matches = dmp.match_corpus(index, "quick brown fox");
+  QStringList strMatches;
+  foreach(CorpusMatch match, matches) {
+    strMatches.append(match.document + ":" + QString::number(match.location));
+  }
+  assertEquals("match_corpus: Ranked.", QString("fox:4,dog:2"), strMatches.join(","));
+  assertTrue("match_corpus: Exact score.", matches[0].score == 0.0);
+  assertTrue("match_corpus: Fuzzy score.", matches[1].score > 0.0 && matches[1].score <= dmp.Match_Threshold);
+
+  dmp.Match_Threshold = 0.1f;
+  matches = dmp.match_corpus(index, "quick brown fox");
+  assertEquals("match_corpus: Strict threshold.", 1, matches.size());
+  assertEquals("match_corpus: Pigeonhole segments.", 4, matches[0].location);
+  matches = dmp.match_corpus(index, "in the sum");
+  assertEquals("match_corpus: Typo.", QString("dog"), matches.isEmpty() ? QString() : matches[0].document);
+  matches = dmp.match_corpus(index, "to");
+  assertEquals("match_corpus: Short pattern.", 1, matches.size());
+  assertEquals("match_corpus: Short pattern location.", 8, matches[0].location);
+  dmp.Match_Threshold = 0.5f;
+
+  // Only the few documents which may match are verified.
+  CorpusIndex large;
+  const QString filler = "lorem ipsum dolor sit amet, consectetur adipiscing elit ";
+  for (int x = 0; x < 200; x++) {
+    large.insert(QString::number(x), filler.mid(x % 20) + filler + QString::number(x));
+  }
+  large.insert("near", filler + "the quick brown fax " + filler);
+  large.insert("far", filler + "the quick brawn dog " + filler);
+  // Strict enough for the index to rule out documents.
+  dmp.Match_Threshold = 0.25f;
+  const int errors = static_cast<int>(dmp.Match_Threshold * 15);
+  QList<QPair<QString, int> > candidates = large.candidates("quick brown fox", errors);
+  assertTrue("CorpusIndex: Few candidates.", candidates.size() <= 4);
+  matches = dmp.match_corpus(large, "quick brown fox");
+  strMatches.clear();
+  foreach(CorpusMatch match, matches) {
+    strMatches.append(match.document);
+  }
+  assertEquals("match_corpus: Large corpus.", QString("near,far"), strMatches.join(","));
+  dmp.Match_Threshold = 0.5f;
+  // Neighbouring locations are verified once.
+  CorpusIndex repeats;
+  repeats.insert("a", "aaaaaaaaaa");
+  assertEquals("CorpusIndex: Every location.", 7, repeats.candidates("aaaa", 0).size());
+  assertEquals("CorpusIndex: One location per run.", 2, repeats.candidates("aaaa", 3).size());
+
+  // Incremental updates.
+  assertTrue("CorpusIndex: Remove.", index.remove("fox"));
+  assertFalse("CorpusIndex: Remove missing.", index.remove("fox"));
+  dmp.Match_Threshold = 0.1f;
+  assertEquals("match_corpus: Removed document.", 0, dmp.match_corpus(index, "quick brown fox").size());
+  index.insert("none", "The quick brown fox is back.");
+  matches = dmp.match_corpus(index, "quick brown fox");
+  assertEquals("match_corpus: Replaced document.", QString("none:4"), matches.isEmpty() ? QString() : matches[0].document + ":" + QString::number(matches[0].location));
+  assertFalse("CorpusIndex: Replaced text.", index.text("none").contains("Nothing"));
+  dmp.Match_Threshold = 0.5f;
+
+  // Agrees with match_main on each document.
+  index = CorpusIndex();
+  QStringList texts;
+  texts << "abcdefghijklmnopqrstuvwxyz" << "I am the very model of a modern major general." << "xxxxxxxxxxabcdeXghijxxxx";
+  for (int x = 0; x < texts.size(); x++) {
+    index.insert(QString::number(x), texts[x]);
+  }
+  matches = dmp.match_corpus(index, "abcdefghij");
+  strMatches.clear();
+  foreach(CorpusMatch match, matches) {
+    strMatches.append(match.document + ":" + QString::number(match.location));
+  }
+  assertEquals("match_corpus: Across documents.", QString("0:0,2:10"), strMatches.join(","));
+
+  // Matches near the threshold have more errors than there are q-grams to
+  // cut the pattern into.
+  const QString fox = "The quick brown fox jumps over the lazy dog.";
+  index = CorpusIndex();
+  index.insert("fox", fox);
+  matches = dmp.match_corpus(index, "qXiXk bXoXn fXx");
+  assertEquals("match_corpus: Near threshold.", QString::number(dmp.match_main(fox, "qXiXk bXoXn fXx", 4)), matches.isEmpty() ? QString() : QString::number(matches[0].location));
+  matches = dmp.match_corpus(index, "lazy cat");
+  assertEquals("match_corpus: Near threshold short.", QString::number(dmp.match_main(fox, "lazy cat", 35)), matches.isEmpty() ? QString() : QString::number(matches[0].location));
+
+  // Test null inputs.
+  try {
+    dmp.match_corpus(index, NULL);
+    assertFalse("match_corpus: Null inputs.", true);
+  } catch (const char* ex) {
+    // Exception expected.
+  }
+}
+
 
 //  PATCH TEST FUNCTIONS
 
@@ -714,6 +1828,80 @@ void diff_match_patch_test::testPatchFromText() {
   }
 }
 
+void diff_match_patch_test::testPatchFromUnifiedDiff() {
+  QString text1;
+  for (int x = 1; x <= 20; x++) {
+    text1 += QString("line %1\n").arg(x);
+  }
+  QString text2 = text1;
+  text2.replace("line 3\n", "line three\n").replace("line 10\n", "line 10\nnew line\n").replace("line 18\n", "");
+  QString diff = "--- a/file.txt\t2020-01-01 00:00:00\n+++ b/file.txt\t2020-01-02 00:00:00\n"
+      "@@ -1,5 +1,5 @@\n line 1\n line 2\n-line 3\n+line three\n line 4\n line 5\n"
+      "@@ -8,6 +8,7 @@ section heading\n line 8\n line 9\n line 10\n+new line\n line 11\n line 12\n line 13\n"
+      "@@ -16,5 +17,4 @@\n line 16\n line 17\n-line 18\n line 19\n line 20\n";
+  QList<Patch> patches = dmp.patch_fromUnifiedDiff(diff, text1);
+  assertEquals("patch_fromUnifiedDiff: Hunks.", 3, patches.size());
+  assertEquals("patch_fromUnifiedDiff: Offsets.", "@@ -50,46 +54,55 @@\n line 8%0Aline 9%0Aline 10%0A\n+new line%0A\n line 11%0Aline 12%0Aline 13%0A\n", patches[1].toString());
+  QPair<QString, QVector<bool> > results = dmp.patch_apply(patches, text1);
+  assertEquals("patch_fromUnifiedDiff: Apply.", text2, results.first);
+  assertTrue("patch_fromUnifiedDiff: All applied.", results.second.count(true) == 3);
+
+  // The old text has moved on since the diff was made.
+  results = dmp.patch_apply(patches, "Preamble.\n" + text1);
+  assertEquals("patch_fromUnifiedDiff: Fuzzy apply.", "Preamble.\n" + text2, results.first);
+
+  diff = "@@ -1,2 +1,2 @@\n a\n-b\n\\ No newline at end of file\n+c\n\\ No newline at end of file\n";
+  patches = dmp.patch_fromUnifiedDiff(diff, "a\nb");
+  results = dmp.patch_apply(patches, "a\nb");
+  assertEquals("patch_fromUnifiedDiff: No newline at end of file.", "a\nc", results.first);
+
+  // Several files, read one at a time.
+  diff = "diff --git a/x b/x\nindex 1234567..89abcde 100644\n--- a/x\n+++ b/x\n@@ -1 +1 @@\n-old\n+new\n"
+      "--- z\t2020-01-01\n+++ z\t2020-01-02\n@@ -0,0 +1,2 @@\n+created\n+file\n"
+      "diff --git a/y.bin b/y.bin\nBinary files a/y.bin and b/y.bin differ\n";
+  QTextStream stream(&diff, QIODevice::ReadOnly);
+  UnifiedDiffReader reader(stream);
+  QStringList files;
+  while (reader.next()) {
+    files.append(QString("%1 %2 %3").arg(reader.oldPath(), reader.newPath()).arg(reader.hunkCount()));
+    if (reader.oldPath() == "z") {
+      patches = reader.patches("");
+      assertEquals("UnifiedDiffReader: New file.", "created\nfile\n", dmp.patch_apply(patches, "").first);
+    } else if (reader.oldPath() == "a/x") {
+      patches = reader.patches("old\n");
+      assertEquals("UnifiedDiffReader: Replace.", "new\n", dmp.patch_apply(patches, "old\n").first);
+    }
+  }
+  assertEquals("UnifiedDiffReader: Files.", QStringList() << "a/x b/x 1" << "z z 1" << "a/y.bin b/y.bin 0", files);
+
+  // Paths with spaces, from a header with no ---/+++ lines.
+  diff = "diff --git a/my file.bin b/my file.bin\nBinary files differ\n";
+  QTextStream spaced(&diff, QIODevice::ReadOnly);
+  UnifiedDiffReader spacedReader(spaced);
+  assertTrue("UnifiedDiffReader: Spaced header.", spacedReader.next());
+  assertEquals("UnifiedDiffReader: Spaced old path.", "a/my file.bin", spacedReader.oldPath());
+  assertEquals("UnifiedDiffReader: Spaced new path.", "b/my file.bin", spacedReader.newPath());
+
+  // Line endings of the patched file are kept.
+  diff = "--- a/dos.txt\r\n+++ b/dos.txt\r\n@@ -1,3 +1,3 @@\r\n one\r\n-two\r\n+2\r\n\r\n";
+  patches = dmp.patch_fromUnifiedDiff(diff, "one\r\ntwo\r\n\r\n");
+  assertEquals("patch_fromUnifiedDiff: CRLF.", "one\r\n2\r\n\r\n", dmp.patch_apply(patches, "one\r\ntwo\r\n\r\n").first);
+
+  try {
+    dmp.patch_fromUnifiedDiff("@@ -1 +1 @@\n?bad\n", "bad\n");
+    assertFalse("patch_fromUnifiedDiff: Invalid line.", true);
+  } catch (QString ex) {
+    // Exception expected.
+  }
+
+  try {
+    dmp.patch_fromUnifiedDiff("@@ -1,3 +1,3 @@\n a\n", "a\n");
+    assertFalse("patch_fromUnifiedDiff: Truncated hunk.", true);
+  } catch (QString ex) {
+    // Exception expected.
+  }
+}
+
 void diff_match_patch_test::testPatchToText() {
   QString strp = "@@ -21,18 +22,17 @@\n jump\n-s\n+ed\n  over \n-the\n+a\n  laz\n";
   QList<Patch> patches;
@@ -816,6 +2004,72 @@ void diff_match_patch_test::testPatchSplitMax() {
   assertEquals("patch_splitMax: #4.", "@@ -2,32 +2,32 @@\n bcdefghij , h : \n-0\n+1\n  , t : 1 abcdef\n@@ -29,32 +29,32 @@\n bcdefghij , h : \n-0\n+1\n  , t : 1 abcdef\n", dmp.patch_toText(patches));
 }
 
+void diff_match_patch_test::testPatchNormalize() {
+  // Assumes that Match_MaxBits is 32.
+  QList<Patch> patches;
+  dmp.patch_normalize(patches);
+  assertEquals("patch_normalize: Null case.", "", dmp.patch_toText(patches));
+
+  // Concatenated patch lists with touching hunks.
+  QString text1 = "The quick brown fox jumps over the lazy dog.";
+  QString text2 = "The slow brown fox jumps over the lazy dog.";
+  QString text3 = "The slow red fox jumps over the lazy dog.";
+  patches = dmp.patch_make(text1, text2) + dmp.patch_make(text2, text3);
+  dmp.patch_normalize(patches);
+  assertEquals("patch_normalize: Touching hunks.", "@@ -1,19 +1,16 @@\n The \n-quick\n+slow\n  \n-brown\n+red\n  fox\n", dmp.patch_toText(patches));
+  assertEquals("patch_normalize: Touching hunks apply.", text3, dmp.patch_apply(patches, text1).first);
+
+  // Empty diffs are skipped when merging.
+  patches = dmp.patch_make(text1, text2) + dmp.patch_make(text2, text3);
+  patches[0].diffs.append(Diff(EQUAL, ""));
+  patches[1].diffs.prepend(Diff(INSERT, ""));
+  patches[1].diffs.append(Diff(DELETE, ""));
+  dmp.patch_normalize(patches);
+  assertEquals("patch_normalize: Empty diffs.", "@@ -1,19 +1,16 @@\n The \n-quick\n+slow\n  \n-brown\n+red\n  fox\n", dmp.patch_toText(patches));
+
+  // The second patch starts before the first one.
+  text2 = "The quick brown fox jumps over the lazy dog!";
+  text3 = "The quick brown fox jumps over the lazy cow!";
+  patches = dmp.patch_make(text1, text2) + dmp.patch_make(text2, text3);
+  dmp.patch_normalize(patches);
+  assertEquals("patch_normalize: Overlapping hunks.", 1, patches.size());
+  assertEquals("patch_normalize: Overlapping hunks apply.", text3, dmp.patch_apply(patches, text1).first);
+
+  // Later hunks before earlier ones are sorted.
+  text2 = "The quick brown fox jumps over the lazy cat.";
+  text3 = "A quick brown fox jumps over the lazy cat.";
+  patches = dmp.patch_make(text1, text2) + dmp.patch_make(text2, text3);
+  dmp.patch_normalize(patches);
+  assertEquals("patch_normalize: Reordered hunks.", "@@ -1,7 +1,5 @@\n-The\n+A\n  qui\n@@ -35,8 +35,8 @@\n azy \n-dog\n+cat\n .\n", dmp.patch_toText(patches));
+  assertEquals("patch_normalize: Reordered hunks apply.", text3, dmp.patch_apply(patches, text1).first);
+
+  // An insertion which is deleted again cancels out.
+  text2 = "The quick brown fox jumps over the lazy cat and dog.";
+  patches = dmp.patch_make(text1, text2) + dmp.patch_make(text2, text1);
+  dmp.patch_normalize(patches);
+  assertEquals("patch_normalize: Cancelled hunks.", "", dmp.patch_toText(patches));
+
+  // Distant hunks stay apart.
+  patches = dmp.patch_make("abcdefghijklmnopqrstuvwxyz", "abXcdefghijklmnopqrstuvwXxyz");
+  QString oldToText = dmp.patch_toText(patches);
+  dmp.patch_normalize(patches);
+  assertEquals("patch_normalize: Distant hunks.", oldToText, dmp.patch_toText(patches));
+
+  // Hunks which patch_splitMax broke up are not merged back.
+  patches = dmp.patch_make("1234567890123456789012345678901234567890123456789012345678901234567890", "abc");
+  dmp.patch_splitMax(patches);
+  oldToText = dmp.patch_toText(patches);
+  dmp.patch_normalize(patches);
+  assertEquals("patch_normalize: Split hunks.", oldToText, dmp.patch_toText(patches));
+
+  // Oversized patches are split.
+  patches = dmp.patch_make("abcdefghijklmnopqrstuvwxyz01234567890", "XabXcdXefXghXijXklXmnXopXqrXstXuvXwxXyzX01X23X45X67X89X0");
+  QList<Patch> splitPatches = patches;
+  dmp.patch_splitMax(splitPatches);
+  dmp.patch_normalize(patches);
+  assertEquals("patch_normalize: Oversized hunks.", dmp.patch_toText(splitPatches), dmp.patch_toText(patches));
+}
+
 void diff_match_patch_test::testPatchAddPadding() {
   QList<Patch> patches;
   patches = dmp.patch_make("", "test");
@@ -874,6 +2128,40 @@ void diff_match_patch_test::testPatchApply() {
   resultStr = results.first + "\t" + (boolArray[0] ? "true" : "false") + "\t" + (boolArray[1] ? "true" : "false");
   assertEquals("patch_apply: Big delete, large change 1.", "xabc12345678901234567890---------------++++++++++---------------12345678901234567890y\tfalse\ttrue", resultStr);
 
+  // A monster delete whose content has drifted is rejected by the bounded
+  // check, while a close one gets the same framework as diff_main.
+  QString pattern, drifted, close;
+  for (int i = 0; i < 2000; i++) {
+    pattern += QChar('a' + (i * 7) % 26);
+    drifted += QChar('a' + (i * 11) % 26);
+    close += QChar(i % 100 == 50 ? '-' : 'a' + (i * 7) % 26);
+  }
+  QList<Diff> diffs;
+  assertFalse("patch_apply: Big delete, drifted content.",
+              dmp.patch_fuzzyDiff(pattern, drifted, diffs));
+  assertTrue("patch_apply: Big delete, close content.",
+             dmp.patch_fuzzyDiff(pattern, close, diffs));
+  assertEquals("patch_apply: Big delete, close framework.",
+               dmp.diff_main(pattern, close, false), diffs);
+  // Near the threshold the decision is the one diff_main would give, as
+  // long as diff_main finds a minimal diff.
+  pattern = pattern.left(100);
+  for (int n = 45; n <= 55; n++) {
+    close = pattern;
+    for (int i = 0; i < n; i++) {
+      close[i * 100 / n] = '-';
+    }
+    const QList<Diff> full = dmp.diff_main(pattern, close, false);
+    const bool accepted = dmp.diff_levenshtein(full) / 100.0f
+        <= dmp.Patch_DeleteThreshold;
+    assertEquals(QString("patch_apply: Big delete, threshold %1.").arg(n),
+                 QString(accepted ? "true" : "false"),
+                 QString(dmp.patch_fuzzyDiff(pattern, close, diffs) ? "true" : "false"));
+    if (accepted) {
+      assertEquals(QString("patch_apply: Big delete, threshold %1 framework.").arg(n), full, diffs);
+    }
+  }
+
   dmp.Patch_DeleteThreshold = 0.6f;
   patches = dmp.patch_make("x1234567890123456789012345678901234567890123456789012345678901234567890y", "xabcy");
   results = dmp.patch_apply(patches, "x12345678901234567890---------------++++++++++---------------12345678901234567890y");
@@ -921,6 +2209,144 @@ void diff_match_patch_test::testPatchApply() {
   assertEquals("patch_apply: Edge partial match.", "x123\ttrue", resultStr);
 }
 
+void diff_match_patch_test::testPatchApplyStream() {
+  // Streaming must give the same results as patch_apply.
+  dmp.Match_Distance = 1000;
+  dmp.Match_Threshold = 0.5f;
+  dmp.Patch_DeleteThreshold = 0.5f;
+  QStringList cases;
+  cases << "" << "" << "Hello world.";
+  cases << "The quick brown fox jumps over the lazy dog." << "That quick brown fox jumped over a lazy dog." << "The quick brown fox jumps over the lazy dog.";
+  cases << "The quick brown fox jumps over the lazy dog." << "That quick brown fox jumped over a lazy dog." << "The quick red rabbit jumps over the tired tiger.";
+  cases << "The quick brown fox jumps over the lazy dog." << "That quick brown fox jumped over a lazy dog." << "I am the very model of a modern major general.";
+  cases << "x1234567890123456789012345678901234567890123456789012345678901234567890y" << "xabcy" << "x123456789012345678901234567890-----++++++++++-----123456789012345678901234567890y";
+  cases << "x1234567890123456789012345678901234567890123456789012345678901234567890y" << "xabcy" << "x12345678901234567890---------------++++++++++---------------12345678901234567890y";
+  cases << "" << "test" << "";
+  cases << "XY" << "XtestY" << "XY";
+  cases << "y" << "y123" << "x";
+
+  // A long text with edits throughout, so that text is written out as the
+  // patches go.
+  QString text1;
+  for (int x = 0; x < 3000; x++) {
+    text1 += QString("Line %1 of a long text.\n").arg(x);
+  }
+  QString text2 = text1;
+  text2.replace("7 of a", "7 of the");
+  QString source = text1;
+  source.replace("5 of a", "5 of one");
+  cases << text1 << text2 << text1;
+  cases << text1 << text2 << source;
+
+  for (int x = 0; x < cases.size(); x += 3) {
+    QList<Patch> patches = dmp.patch_make(cases[x], cases[x + 1]);
+    QPair<QString, QVector<bool> > expected = dmp.patch_apply(patches, cases[x + 2]);
+    QString input = cases[x + 2];
+    QString output;
+    QTextStream inputStream(&input);
+    QTextStream outputStream(&output);
+    QVector<bool> results = dmp.patch_applyStream(patches, inputStream, outputStream);
+    outputStream.flush();
+    assertEquals(QString("patch_applyStream: Text #%1.").arg(x / 3 + 1), expected.first, output);
+    assertTrue(QString("patch_applyStream: Results #%1.").arg(x / 3 + 1), expected.second == results);
+  }
+
+  // Out of order patches fall back to patch_apply.
+  QList<Patch> patches = dmp.patch_make(text1, text2);
+  patches.swap(0, patches.size() - 1);
+  QString input = text1;
+  QString output;
+  QTextStream inputStream(&input);
+  QTextStream outputStream(&output);
+  dmp.patch_applyStream(patches, inputStream, outputStream);
+  outputStream.flush();
+  assertEquals("patch_applyStream: Out of order.", dmp.patch_apply(patches, text1).first, output);
+}
+
+void diff_match_patch_test::testPatchEstimate() {
+  CostEstimate estimate = dmp.patch_estimateMake("", "");
+  assertEquals("patch_estimateMake: Null case.", CostEstimate::strStrategy(STRATEGY_NONE), CostEstimate::strStrategy(estimate.strategy));
+
+  estimate = dmp.patch_estimateMake("The quick brown fox jumps over the lazy dog.", "That quick brown fox jumped over a lazy dog.");
+  CostEstimate diffEstimate = dmp.diff_estimate("The quick brown fox jumps over the lazy dog.", "That quick brown fox jumped over a lazy dog.");
+  assertTrue("patch_estimateMake: Costs more than the diff.", estimate.seconds > diffEstimate.seconds && estimate.bytes > diffEstimate.bytes);
+
+  QList<Patch> patches;
+  estimate = dmp.patch_estimateApply(patches, "Hello world.");
+  assertEquals("patch_estimateApply: Null case.", CostEstimate::strStrategy(STRATEGY_NONE), CostEstimate::strStrategy(estimate.strategy));
+
+  patches = dmp.patch_make("The quick brown fox jumps over the lazy dog.", "That quick brown fox jumped over a lazy dog.");
+  estimate = dmp.patch_estimateApply(patches, "The quick brown fox jumps over the lazy dog.");
+  assertEquals("patch_estimateApply: Exact match.", CostEstimate::strStrategy(STRATEGY_EXACT), CostEstimate::strStrategy(estimate.strategy));
+  assertTrue("patch_estimateApply: Exact similarity.", estimate.similarity == 1.0);
+  assertEquals("patch_estimateApply: Output length.", 44, estimate.features.length2);
+
+  CostEstimate fuzzy = dmp.patch_estimateApply(patches, "The quick red rabbit jumps over the tired tiger.");
+  assertEquals("patch_estimateApply: Partial match.", CostEstimate::strStrategy(STRATEGY_FUZZY), CostEstimate::strStrategy(fuzzy.strategy));
+  assertTrue("patch_estimateApply: Partial similarity.", fuzzy.similarity < 1.0);
+  assertTrue("patch_estimateApply: Fuzzy costs more.", fuzzy.seconds > estimate.seconds);
+
+  // Patches after an insertion are found in original coordinates.
+  patches = dmp.patch_make("abcdefghijklmnopqrstuvwxyz--------------------1234567890", "abcXXXXXXXXXXdefghijklmnopqrstuvwxyz--------------------1234567YYYYYYYYYY890");
+  estimate = dmp.patch_estimateApply(patches, "abcdefghijklmnopqrstuvwxyz--------------------1234567890");
+  assertEquals("patch_estimateApply: Shifted exact match.", CostEstimate::strStrategy(STRATEGY_EXACT), CostEstimate::strStrategy(estimate.strategy));
+}
+
+void diff_match_patch_test::testCaptureReplay() {
+  // Encoding of a captured call.
+  CapturedCall call;
+  call.function = "patch_apply";
+  call.seconds = 0.25;
+  call.resultHash = 0xdeadbeef;
+  call.settings = "Match_Distance=500&Patch_Margin=4";
+  call.inputs << "tab\tand newline\n" << QString("100% caf") + QChar(0xe9);
+  CapturedCall decoded = CapturedCall::fromString(call.toString());
+  assertEquals("CapturedCall: Single line.", -1, call.toString().indexOf("\n"));
+  assertEquals("CapturedCall: Round trip.", call.toString(), decoded.toString());
+  assertEquals("CapturedCall: Inputs.", call.inputs, decoded.inputs);
+
+  try {
+    CapturedCall::fromString("diff_main\tslow");
+    assertFalse("CapturedCall: Invalid line.", true);
+  } catch (QString ex) {
+    // Exception expected.
+  }
+
+  // Capture every call, then replay them on a fresh instance.
+  const QString fileName = "diff_match_patch_capture.tmp";
+  QFile::remove(fileName);
+  diff_match_patch capturing;
+  capturing.Capture_File = fileName;
+  capturing.Capture_Threshold = 0;
+  capturing.Match_Distance = 500;
+  capturing.diff_main("The quick brown fox.", "The quick red fox.");
+  QList<Patch> patches = capturing.patch_make("The quick brown fox.", "The quick red fox.");
+  capturing.patch_apply(patches, "The slow brown fox.");
+
+  QList<CapturedCall> calls = dmp.capture_load(fileName);
+  QStringList functions;
+  foreach(CapturedCall captured, calls) {
+    functions.append(captured.function);
+  }
+  // The diffs inside patch_make and patch_apply are nested and are not
+  // recorded.
+  assertEquals("capture_load: Calls.", QStringList() << "diff_main" << "patch_make" << "patch_apply", functions);
+  assertTrue("capture_load: Settings.", calls[0].settings.contains("Match_Distance=500"));
+
+  diff_match_patch replaying;
+  double seconds;
+  assertTrue("capture_replay: diff_main.", replaying.capture_replay(calls[0], seconds));
+  assertEquals("capture_replay: Settings.", 500, replaying.Match_Distance);
+  assertTrue("capture_replay: patch_make.", replaying.capture_replay(calls[1], seconds));
+  assertTrue("capture_replay: patch_apply.", replaying.capture_replay(calls[2], seconds));
+  calls[2].resultHash++;
+  assertFalse("capture_replay: Different result.", replaying.capture_replay(calls[2], seconds));
+  assertEquals("capture_replay: Nothing captured.", 3, dmp.capture_load(fileName).size());
+  QFile::remove(fileName);
+
+  assertEquals("capture_load: Missing file.", 0, dmp.capture_load(fileName).size());
+}
+
 
 void diff_match_patch_test::assertEquals(const QString &strCase, int n1, int n2) {
   if (n1 != n2) {
@@ -28,35 +28,56 @@ class diff_match_patch_test {
   void testDiffCommonPrefix();
   void testDiffCommonSuffix();
   void testDiffCommonOverlap();
+  void testDiffKernels();
+  void testDiffCore();
   void testDiffHalfmatch();
+  void testDiffFeatures();
+  void testDiffEstimate();
+  void testDiffSketch();
   void testDiffLinesToChars();
   void testDiffCharsToLines();
   void testDiffCleanupMerge();
   void testDiffCleanupSemanticLossless();
   void testDiffCleanupSemantic();
+  void testDiffCleanupSemanticTokens();
   void testDiffCleanupEfficiency();
   void testDiffPrettyHtml();
+  void testDiffPrettyHtmlWindow();
   void testDiffText();
   void testDiffDelta();
+  void testDiffCompressedDelta();
   void testDiffXIndex();
   void testDiffLevenshtein();
   void testDiffBisect();
+  void testDiffBounded();
+  void testDiffChunked();
+  void testDiffPipeline();
+  void testStreamingDiff();
+  void testDiffSession();
+  void testDiffAlign();
   void testDiffMain();
+  void testDiffRecords();
 
   //  MATCH TEST FUNCTIONS
   void testMatchAlphabet();
   void testMatchBitap();
   void testMatchMain();
+  void testMatchCorpus();
 
   //  PATCH TEST FUNCTIONS
   void testPatchObj();
   void testPatchFromText();
+  void testPatchFromUnifiedDiff();
   void testPatchToText();
   void testPatchAddContext();
   void testPatchMake();
   void testPatchSplitMax();
+  void testPatchNormalize();
   void testPatchAddPadding();
   void testPatchApply();
+  void testPatchApplyStream();
+  void testPatchEstimate();
+  void testCaptureReplay();
 
  private:
   diff_match_patch dmp;
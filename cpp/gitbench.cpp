@@ -0,0 +1,386 @@
+/*
+ * Diff Match and Patch -- Comparison with git diff
+ * Copyright 2018 The diff-match-patch Authors.
+ * https://github.com/google/diff-match-patch
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Code known to compile and run with Qt 4.3 through Qt 4.7.
+#include <QtCore>
+#ifndef Q_OS_WIN
+#include <sys/resource.h>
+#endif
+#include "diff_match_patch.h"
+
+/*
+ * Build and run from diff-match-patch/cpp with:
+ * qmake gitbench.pro && make
+ * ./gitbench [directory ...]
+ *
+ * Diffs each corpus pair with every mode of this library and with
+ * git diff --no-index under each of its algorithms, and reports wall time,
+ * peak memory, the number of hunks and the number of changed characters.
+ * The corpora are the speed test texts, synthetic edits of a generated
+ * text, and synthetic edits of the source files under each directory given.
+ *
+ * Every measurement runs in a fresh child process (./gitbench --run MODE
+ * old new), so that peak memory belongs to that one diff.  git's time
+ * includes starting the process.  Both outputs go through
+ * diff_cleanupSemantic before the hunks and changed characters are
+ * counted, and git's hunks are read with -U0 so that a hunk is one run of
+ * changes on either side.  git never gives up on a diff, so neither does
+ * this library here: Diff_Timeout is 0 for the dmp modes, and their sizes
+ * are those of complete diffs.
+ */
+
+
+static const char *ENGINE_MODES[] = {"dmp-char", "dmp-line", "dmp-chunked"};
+static const char *GIT_MODES[] = {"git-myers", "git-histogram",
+                                  "git-patience"};
+static const int MAX_FILES_PER_DIRECTORY = 50;
+
+
+// One pair of texts to diff.
+struct Sample {
+  QString name;
+  QString text1;
+  QString text2;
+};
+
+
+// Measurements of one mode on one sample.
+struct Result {
+  int milliseconds;
+  long peakKilobytes;
+  int hunks;
+  int changed;
+};
+
+
+// Read a file from disk and return the text contents.
+static QString readFile(const QString &filename) {
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly)) {
+    qFatal("Could not read %s", qPrintable(filename));
+  }
+  return QString::fromUtf8(file.readAll());
+}
+
+
+static void writeFile(const QString &filename, const QString &text) {
+  QFile file(filename);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qFatal("Could not write %s", qPrintable(filename));
+  }
+  file.write(text.toUtf8());
+}
+
+
+// Peak resident memory of this process (self) or of its finished children.
+static long peakKilobytes(bool children) {
+#ifdef Q_OS_WIN
+  Q_UNUSED(children);
+  return -1;
+#else
+  struct rusage usage;
+  getrusage(children ? RUSAGE_CHILDREN : RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+#endif
+}
+
+
+// Make a copy of text with one character changed on every nth line.
+static QString editLines(const QString &text, int n) {
+  QStringList lines = text.split("\n");
+  for (int x = 0; x < lines.size(); x += n) {
+    if (!lines[x].isEmpty()) {
+      lines[x][lines[x].length() / 2] = QChar('#');
+    }
+  }
+  return lines.join("\n");
+}
+
+
+// Make a copy of text with a block of lines moved to the end, and another
+// block deleted.
+static QString moveBlock(const QString &text, int length) {
+  QStringList lines = text.split("\n");
+  const int from = lines.size() / 3;
+  QStringList block;
+  for (int x = 0; x < length && from < lines.size(); x++) {
+    block.append(lines.takeAt(from));
+  }
+  const int deleted = 2 * lines.size() / 3;
+  for (int x = 0; x < length / 2 && deleted < lines.size(); x++) {
+    lines.removeAt(deleted);
+  }
+  return (lines + block).join("\n");
+}
+
+
+// A text of pseudo-random words, one sentence per line.
+static QString generateText(int lineCount) {
+  const char *words[] = {"alpha", "bravo", "charlie", "delta", "echo",
+                         "foxtrot", "golf", "hotel", "india", "juliet",
+                         "kilo", "lima", "mike", "november", "oscar"};
+  uint seed = 1;
+  QString text;
+  for (int x = 0; x < lineCount; x++) {
+    QStringList line;
+    for (int y = 0; y < 8; y++) {
+      seed = seed * 1103515245 + 12345;
+      line.append(words[(seed >> 16) % 15]);
+    }
+    text += line.join(" ") + ".\n";
+  }
+  return text;
+}
+
+
+static QList<Sample> buildCorpora(const QStringList &directories) {
+  QList<Sample> samples;
+  Sample sample;
+  sample.name = "speedtest";
+  sample.text1 = readFile("speedtest1.txt");
+  sample.text2 = readFile("speedtest2.txt");
+  samples.append(sample);
+
+  const QString generated = generateText(20000);
+  sample.name = "synthetic-scattered";
+  sample.text1 = generated;
+  sample.text2 = editLines(generated, 97);
+  samples.append(sample);
+  sample.name = "synthetic-moved";
+  sample.text2 = moveBlock(generated, 400);
+  samples.append(sample);
+
+  QStringList filters;
+  filters << "*.c" << "*.cc" << "*.cpp" << "*.h" << "*.java" << "*.js"
+      << "*.py" << "*.go" << "*.rs";
+  foreach(QString directory, directories) {
+    QDirIterator files(directory, filters, QDir::Files,
+                       QDirIterator::Subdirectories);
+    QStringList paths;
+    while (files.hasNext()) {
+      paths.append(files.next());
+    }
+    paths.sort();
+    for (int x = 0; x < paths.size() && x < MAX_FILES_PER_DIRECTORY; x++) {
+      sample.name = paths[x];
+      sample.text1 = readFile(paths[x]);
+      // Alternate between scattered edits and a moved block.
+      sample.text2 = (x % 2 == 0) ? editLines(sample.text1, 15)
+          : moveBlock(sample.text1, 20);
+      if (sample.text1 != sample.text2) {
+        samples.append(sample);
+      }
+    }
+  }
+  return samples;
+}
+
+
+// Count the hunks and changed characters of a diff after semantic cleanup.
+static void measureDiffs(diff_match_patch &dmp, QList<Diff> diffs,
+                         Result &result) {
+  dmp.diff_cleanupSemantic(diffs);
+  const DiffIndex index(diffs);
+  result.hunks = index.hunks().size();
+  result.changed = 0;
+  foreach(DiffHunk hunk, index.hunks()) {
+    result.changed += hunk.length1 + hunk.length2;
+  }
+}
+
+
+// Run one mode on two files in this process and print the measurements.
+static int runMode(const QString &mode, const QString &file1,
+                   const QString &file2) {
+  const QString text1 = readFile(file1);
+  const QString text2 = readFile(file2);
+  diff_match_patch dmp;
+  // Compare complete diffs with git's, not ones cut short by the timeout.
+  dmp.Diff_Timeout = 0;
+  Result result;
+  QList<Diff> diffs;
+  QTime timer;
+  timer.start();
+  if (mode == "dmp-char") {
+    diffs = dmp.diff_main(text1, text2, false);
+  } else if (mode == "dmp-line") {
+    diffs = dmp.diff_main(text1, text2, true);
+  } else if (mode == "dmp-chunked") {
+    diffs = dmp.diff_chunked(ChunkTree(text1), ChunkTree(text2));
+  } else if (mode.startsWith("git-")) {
+    QProcess git;
+    git.start("git", QStringList() << "diff" << "--no-index" << "--no-color"
+              << "--no-ext-diff" << "-U0"
+              << QString("--diff-algorithm=%1").arg(mode.mid(4))
+              << file1 << file2);
+    if (!git.waitForStarted() || !git.waitForFinished(-1)) {
+      qFatal("Could not run git");
+    }
+    QString output = QString::fromUtf8(git.readAllStandardOutput());
+    result.milliseconds = timer.elapsed();
+    // Rebuild the whole diff from the hunks.
+    QTextStream stream(&output, QIODevice::ReadOnly);
+    UnifiedDiffReader reader(stream);
+    QList<Patch> patches;
+    if (reader.next()) {
+      patches = reader.patches(text1);
+    }
+    int pointer = 0;
+    foreach(Patch patch, patches) {
+      if (patch.start1 > pointer) {
+        diffs.append(Diff(EQUAL, text1.mid(pointer, patch.start1 - pointer)));
+      }
+      diffs += patch.diffs;
+      pointer = patch.start1 + patch.length1;
+    }
+    if (pointer < text1.length()) {
+      diffs.append(Diff(EQUAL, text1.mid(pointer)));
+    }
+    dmp.diff_cleanupMerge(diffs);
+    if (dmp.diff_text2(diffs) != text2) {
+      qFatal("Could not rebuild git's diff of %s", qPrintable(file1));
+    }
+    measureDiffs(dmp, diffs, result);
+    result.peakKilobytes = peakKilobytes(true);
+    printf("%d %ld %d %d\n", result.milliseconds, result.peakKilobytes,
+           result.hunks, result.changed);
+    return 0;
+  } else {
+    qFatal("Unknown mode %s", qPrintable(mode));
+  }
+  result.milliseconds = timer.elapsed();
+  measureDiffs(dmp, diffs, result);
+  result.peakKilobytes = peakKilobytes(false);
+  printf("%d %ld %d %d\n", result.milliseconds, result.peakKilobytes,
+         result.hunks, result.changed);
+  return 0;
+}
+
+
+// Run one mode in a child process.
+static Result measure(const QString &program, const QString &mode,
+                      const QString &file1, const QString &file2) {
+  QProcess child;
+  child.start(program, QStringList() << "--run" << mode << file1 << file2);
+  if (!child.waitForStarted() || !child.waitForFinished(-1)
+      || child.exitCode() != 0) {
+    qFatal("Mode %s failed on %s", qPrintable(mode), qPrintable(file1));
+  }
+  const QStringList fields = QString::fromUtf8(child.readAllStandardOutput())
+      .trimmed().split(" ");
+  if (fields.size() != 4) {
+    qFatal("Unexpected output from mode %s", qPrintable(mode));
+  }
+  Result result;
+  result.milliseconds = fields[0].toInt();
+  result.peakKilobytes = fields[1].toLong();
+  result.hunks = fields[2].toInt();
+  result.changed = fields[3].toInt();
+  return result;
+}
+
+
+static void runComparison(const QString &program,
+                          const QStringList &directories) {
+  QStringList modes;
+  for (unsigned int x = 0; x < sizeof(ENGINE_MODES) / sizeof(char *); x++) {
+    modes.append(ENGINE_MODES[x]);
+  }
+  for (unsigned int x = 0; x < sizeof(GIT_MODES) / sizeof(char *); x++) {
+    modes.append(GIT_MODES[x]);
+  }
+  const QString file1 = QDir(QDir::tempPath()).filePath("gitbench_old.txt");
+  const QString file2 = QDir(QDir::tempPath()).filePath("gitbench_new.txt");
+
+  // Totals per mode, and how often each mode was the fastest or produced
+  // the fewest changed characters.
+  QMap<QString, Result> totals;
+  QMap<QString, int> fastest;
+  QMap<QString, int> smallest;
+  foreach(QString mode, modes) {
+    Result zero = {0, 0, 0, 0};
+    totals.insert(mode, zero);
+    fastest.insert(mode, 0);
+    smallest.insert(mode, 0);
+  }
+
+  const QList<Sample> samples = buildCorpora(directories);
+  foreach(Sample sample, samples) {
+    writeFile(file1, sample.text1);
+    writeFile(file2, sample.text2);
+    qDebug("%s (%d -> %d chars)", qPrintable(sample.name),
+           sample.text1.length(), sample.text2.length());
+    QMap<QString, Result> results;
+    foreach(QString mode, modes) {
+      const Result result = measure(program, mode, file1, file2);
+      results.insert(mode, result);
+      qDebug("  %-14s %6d ms %8ld KB %6d hunks %8d changed",
+             qPrintable(mode), result.milliseconds, result.peakKilobytes,
+             result.hunks, result.changed);
+      Result &total = totals[mode];
+      total.milliseconds += result.milliseconds;
+      total.peakKilobytes = std::max(total.peakKilobytes,
+                                     result.peakKilobytes);
+      total.hunks += result.hunks;
+      total.changed += result.changed;
+    }
+    // Ties count as a win for every mode involved.
+    int bestTime = results[modes.first()].milliseconds;
+    int bestSize = results[modes.first()].changed;
+    foreach(QString mode, modes) {
+      bestTime = std::min(bestTime, results[mode].milliseconds);
+      bestSize = std::min(bestSize, results[mode].changed);
+    }
+    foreach(QString mode, modes) {
+      if (results[mode].milliseconds == bestTime) {
+        fastest[mode]++;
+      }
+      if (results[mode].changed == bestSize) {
+        smallest[mode]++;
+      }
+    }
+  }
+  QFile::remove(file1);
+  QFile::remove(file2);
+
+  qDebug("Summary over %d samples (Diff_Timeout 0; peak memory is the "
+         "largest of any sample):", samples.size());
+  foreach(QString mode, modes) {
+    const Result &total = totals[mode];
+    qDebug("  %-14s %6d ms %8ld KB %6d hunks %8d changed  "
+           "fastest %d  smallest %d", qPrintable(mode), total.milliseconds,
+           total.peakKilobytes, total.hunks, total.changed, fastest[mode],
+           smallest[mode]);
+  }
+}
+
+
+int main(int argc, char **argv) {
+  if (argc == 5 && QString(argv[1]) == "--run") {
+    return runMode(argv[2], argv[3], argv[4]);
+  }
+  QStringList directories;
+  for (int x = 1; x < argc; x++) {
+    if (QString(argv[x]).startsWith("-")) {
+      qFatal("Usage: %s [directory ...]", argv[0]);
+    }
+    directories.append(argv[x]);
+  }
+  runComparison(argv[0], directories);
+  return 0;
+}
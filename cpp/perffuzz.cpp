@@ -0,0 +1,371 @@
+/*
+ * Diff Match and Patch -- Performance Fuzzer
+ * Copyright 2018 The diff-match-patch Authors.
+ * https://github.com/google/diff-match-patch
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Code known to compile and run with Qt 4.3 through Qt 4.7.
+#include <QtCore>
+#ifdef Q_OS_LINUX
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "diff_match_patch.h"
+
+#ifndef DMP_WORK_COUNTERS
+#error perffuzz needs the work counters: build with DEFINES += DMP_WORK_COUNTERS
+#endif
+
+/*
+ * Build and run from diff-match-patch/cpp with:
+ * qmake perffuzz.pro && make
+ * ./perffuzz [iterations [corpus.log]]
+ *
+ * Searches for pairs of texts on which patch_make and patch_apply do the
+ * most work per input character.  Work is the number of instructions
+ * retired, counted by perf_event_open where the kernel allows it, or else
+ * the sum of diff_match_patch::workCounters.  Each input is a mutation of
+ * one already found; it is kept if it reaches a new order of magnitude on
+ * any work counter (coverage) or does more work per character than any
+ * input so far, in total or on one hot path (cost).
+ *
+ * The worst inputs, in total and on each hot path, are written to the
+ * corpus (perffuzz_corpus.log by default) as captured calls.  Inputs
+ * already in the corpus seed the search, and stay in it unless worse ones
+ * are found.
+ *
+ * The corpus is not replayed by the unit tests.  To check a change against
+ * it, build speedtest and run from diff-match-patch/cpp:
+ * ./speedtest --replay perffuzz_corpus.log
+ * Each call is timed next to its captured time, and any call whose result
+ * has changed is reported as DIFFERENT.
+ */
+
+
+static const int DEFAULT_ITERATIONS = 20000;
+static const int MAX_TEXT_LENGTH = 1500;
+// Counts of each counter are bucketed by powers of two for coverage.
+static const int FEATURE_BUCKETS = 64;
+static const char ALPHABET[] = "aab. \n";
+static const char *COUNTER_NAMES[] = {"bisect", "halfmatch", "cleanup",
+                                      "overlap", "context", "splitmax"};
+
+
+// One pair of texts to patch, with the work it caused.
+struct Input {
+  QString text1;
+  QString text2;
+  quint64 work;
+  double score;
+  // Work counted on each hot path, per input character.
+  double counterScores[WORK_COUNTERS];
+};
+
+
+// Pseudo-random numbers, the same on every run.
+static uint nextRandom(uint range) {
+  static quint64 seed = 1;
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return static_cast<uint>(seed >> 33) % range;
+}
+
+
+/**
+ * Counts the instructions retired by this process in user space.
+ */
+class InstructionCounter {
+ public:
+  InstructionCounter() : fd(-1) {
+#ifdef Q_OS_LINUX
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+  }
+
+  ~InstructionCounter() {
+#ifdef Q_OS_LINUX
+    if (fd != -1) {
+      close(fd);
+    }
+#endif
+  }
+
+  bool isAvailable() const {
+    return fd != -1;
+  }
+
+  void start() {
+#ifdef Q_OS_LINUX
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+  }
+
+  quint64 stop() {
+    quint64 count = 0;
+#ifdef Q_OS_LINUX
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+      count = 0;
+    }
+#endif
+    return count;
+  }
+
+ private:
+  int fd;
+};
+
+
+// Run the target on an input, and note which features it reached.
+static void runInput(diff_match_patch &dmp, InstructionCounter &counter,
+                     Input &input, QList<int> &features) {
+  for (int x = 0; x < WORK_COUNTERS; x++) {
+    diff_match_patch::workCounters[x] = 0;
+  }
+  if (counter.isAvailable()) {
+    counter.start();
+  }
+  QList<Patch> patches = dmp.patch_make(input.text1, input.text2);
+  dmp.patch_apply(patches, input.text1);
+  if (counter.isAvailable()) {
+    input.work = counter.stop();
+  } else {
+    input.work = 0;
+    for (int x = 0; x < WORK_COUNTERS; x++) {
+      input.work += diff_match_patch::workCounters[x];
+    }
+  }
+  const double length = input.text1.length() + input.text2.length() + 1;
+  input.score = input.work / length;
+
+  features.clear();
+  for (int x = 0; x < WORK_COUNTERS; x++) {
+    input.counterScores[x] = diff_match_patch::workCounters[x] / length;
+    int bucket = 0;
+    for (quint64 n = diff_match_patch::workCounters[x]; n != 0; n >>= 1) {
+      bucket++;
+    }
+    features.append(x * FEATURE_BUCKETS + bucket);
+  }
+}
+
+
+// A random range of text, of at most maxLength characters.
+static void randomRange(const QString &text, int maxLength, int &start,
+                        int &length) {
+  start = nextRandom(text.length() + 1);
+  length = nextRandom(std::min(text.length() - start, maxLength) + 1);
+}
+
+
+// Change one of the texts of an input.
+static Input mutate(const Input &parent) {
+  Input child = parent;
+  const bool first = nextRandom(2) == 0;
+  QString &text = first ? child.text1 : child.text2;
+  const QString &other = first ? child.text2 : child.text1;
+  int start, length;
+  switch (nextRandom(6)) {
+    case 0: {
+      // Insert a few characters.
+      QString inserted;
+      for (int n = nextRandom(8) + 1; n > 0; n--) {
+        inserted += QChar(ALPHABET[nextRandom(sizeof(ALPHABET) - 1)]);
+      }
+      text.insert(nextRandom(text.length() + 1), inserted);
+      break;
+    }
+    case 1:
+      // Delete a range.
+      randomRange(text, 64, start, length);
+      text.remove(start, length);
+      break;
+    case 2: {
+      // Repeat a range.
+      randomRange(text, 32, start, length);
+      const QString repeated = text.mid(start, length);
+      for (int n = nextRandom(16) + 1; n > 0; n--) {
+        text.insert(start, repeated);
+      }
+      break;
+    }
+    case 3: {
+      // Copy a range of the other text.
+      randomRange(other, 256, start, length);
+      const QString copied = other.mid(start, length);
+      text.insert(nextRandom(text.length() + 1), copied);
+      break;
+    }
+    case 4:
+      // Replace one character.
+      if (!text.isEmpty()) {
+        text[nextRandom(text.length())] =
+            QChar(ALPHABET[nextRandom(sizeof(ALPHABET) - 1)]);
+      }
+      break;
+    default:
+      // Start again from the other text.
+      text = other;
+      break;
+  }
+  text = text.left(MAX_TEXT_LENGTH);
+  return child;
+}
+
+
+// Keep the worst inputs: the one with the most work per character, then
+// the one with the most per character on each hot path.
+static bool addWorst(QList<Input> &worst, const Input &input) {
+  bool added = false;
+  for (int x = 0; x <= WORK_COUNTERS; x++) {
+    if (x == worst.size()) {
+      worst.append(input);
+      added = true;
+    } else if (x == 0 ? input.score > worst[x].score
+               : input.counterScores[x - 1] > worst[x].counterScores[x - 1]) {
+      worst[x] = input;
+      added = true;
+    }
+  }
+  return added;
+}
+
+
+// Inputs to start from: those of an earlier corpus, and a few small texts.
+static QList<Input> loadSeeds(diff_match_patch &dmp, const QString &fileName) {
+  QList<Input> seeds;
+  foreach(const CapturedCall &call, dmp.capture_load(fileName)) {
+    if (call.function == "patch_make" && call.inputs.size() == 2) {
+      Input input;
+      input.text1 = call.inputs[0];
+      input.text2 = call.inputs[1];
+      seeds.append(input);
+    }
+  }
+  const char *texts[][2] = {
+    {"The quick brown fox jumps over the lazy dog.",
+     "That quick brown fox jumped over a lazy dog."},
+    {"aaaa bbbb aaaa bbbb\n", "bbbb aaaa bbbb aaaa\n"},
+    {"", "a.b.a.b.a.b.a.b."}
+  };
+  for (size_t x = 0; x < sizeof(texts) / sizeof(texts[0]); x++) {
+    Input input;
+    input.text1 = texts[x][0];
+    input.text2 = texts[x][1];
+    seeds.append(input);
+  }
+  return seeds;
+}
+
+
+// Replace the corpus by captured calls on the worst inputs.
+static void writeCorpus(diff_match_patch &dmp, const QString &fileName,
+                        const QList<Input> &worst) {
+  QFile::remove(fileName);
+  dmp.Capture_File = fileName;
+  dmp.Capture_Threshold = 0;
+  foreach(const Input &input, worst) {
+    QList<Patch> patches = dmp.patch_make(input.text1, input.text2);
+    dmp.patch_apply(patches, input.text1);
+  }
+  dmp.Capture_File = "";
+}
+
+
+int main(int argc, char **argv) {
+  const int iterations = argc > 1 ? QString(argv[1]).toInt()
+                                  : DEFAULT_ITERATIONS;
+  const QString fileName = argc > 2 ? QString(argv[2])
+                                    : QString("perffuzz_corpus.log");
+  if (iterations <= 0 || argc > 3) {
+    qFatal("Usage: %s [iterations [corpus.log]]", argv[0]);
+  }
+
+  diff_match_patch dmp;
+  // Count the work of the algorithms, not of threads.  The timeout is long
+  // enough never to cut a diff of these lengths short, yet not zero, which
+  // would turn off the half-match speedup.
+  dmp.Diff_Timeout = 60;
+  dmp.Match_Threads = 1;
+  dmp.Diff_Threads = 1;
+  InstructionCounter counter;
+  qDebug("Measuring work in %s.", counter.isAvailable()
+         ? "instructions retired" : "work counter steps");
+
+  QList<Input> queue;
+  QList<Input> worst;
+  QSet<int> coverage;
+  QList<int> features;
+  foreach(Input input, loadSeeds(dmp, fileName)) {
+    runInput(dmp, counter, input, features);
+    foreach(int feature, features) {
+      coverage.insert(feature);
+    }
+    queue.append(input);
+    addWorst(worst, input);
+  }
+
+  for (int x = 0; x < iterations; x++) {
+    // Prefer the worst inputs as parents, to climb towards worse ones.
+    const Input &parent = nextRandom(2) == 0 && !worst.isEmpty()
+        ? worst[nextRandom(worst.size())] : queue[nextRandom(queue.size())];
+    Input child = mutate(parent);
+    runInput(dmp, counter, child, features);
+    bool interesting = addWorst(worst, child);
+    foreach(int feature, features) {
+      if (!coverage.contains(feature)) {
+        coverage.insert(feature);
+        interesting = true;
+      }
+    }
+    if (interesting) {
+      queue.append(child);
+    }
+    if ((x + 1) % 1000 == 0) {
+      qDebug("%d inputs: queue %d, coverage %d, worst %.1f per character",
+             x + 1, queue.size(), coverage.size(), worst.first().score);
+    }
+  }
+
+  // The same input can be the worst for several counters.
+  QList<Input> corpus;
+  for (int x = 0; x < worst.size(); x++) {
+    bool duplicate = false;
+    foreach(const Input &kept, corpus) {
+      duplicate |= kept.text1 == worst[x].text1 && kept.text2 == worst[x].text2;
+    }
+    if (!duplicate) {
+      corpus.append(worst[x]);
+    }
+    qDebug("%-10s %.1f per character, lengths %d and %d",
+           x == 0 ? "total" : COUNTER_NAMES[x - 1],
+           x == 0 ? worst[x].score : worst[x].counterScores[x - 1],
+           worst[x].text1.length(), worst[x].text2.length());
+  }
+  writeCorpus(dmp, fileName, corpus);
+  qDebug("Wrote %d inputs to %s; replay with ./speedtest --replay %s",
+         corpus.size(), qPrintable(fileName), qPrintable(fileName));
+  return 0;
+}
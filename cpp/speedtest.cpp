@@ -0,0 +1,314 @@
+/*
+ * Diff Match and Patch -- Speed Test
+ * Copyright 2018 The diff-match-patch Authors.
+ * https://github.com/google/diff-match-patch
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Code known to compile and run with Qt 4.3 through Qt 4.7.
+#include <QtCore>
+#include <time.h>
+#include "diff_match_patch.h"
+
+/*
+ * Build and run from diff-match-patch/cpp with:
+ * qmake speedtest.pro && make
+ * ./speedtest                           Time one diff of the speed test texts.
+ * ./speedtest --calibrate profile.ini   Fit the strategy cost model and save
+ *                                       it for diff_match_patch::profile_load.
+ * ./speedtest --profile profile.ini     Time the diff with a saved profile.
+ * ./speedtest --normalize               Time patch_apply on a patch list built
+ *                                       from several versions, before and
+ *                                       after patch_normalize.
+ * ./speedtest --capture capture.log     Time the diff with every call captured.
+ * ./speedtest --replay capture.log      Re-run the calls captured by
+ *                                       diff_match_patch::Capture_File, with
+ *                                       the cost estimates of each.  The
+ *                                       corpus of slow inputs kept by
+ *                                       perffuzz is replayed the same way.
+ * ./speedtest --delta                   Compare the size and speed of the
+ *                                       text delta, the text delta through
+ *                                       qCompress (zlib) and the compressed
+ *                                       delta.
+ */
+
+
+// Read a file from disk and return the text contents.
+static QString readFile(const QString &filename) {
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly)) {
+    qFatal("Could not read %s", qPrintable(filename));
+  }
+  return QString::fromUtf8(file.readAll());
+}
+
+
+// Seconds elapsed since start.
+static double secondsSince(clock_t start) {
+  return (clock() - start) / static_cast<double>(CLOCKS_PER_SEC);
+}
+
+
+// Make a copy of text with one character changed on every nth line.
+static QString editLines(const QString &text, int n) {
+  QStringList lines = text.split("\n");
+  for (int x = 0; x < lines.size(); x += n) {
+    if (!lines[x].isEmpty()) {
+      lines[x][lines[x].length() / 2] = QChar('#');
+    }
+  }
+  return lines.join("\n");
+}
+
+
+static void runSpeedtest(diff_match_patch &dmp, const QString &text1,
+                         const QString &text2) {
+  dmp.Diff_Timeout = 0;
+
+  // Execute one reverse diff as a warmup.
+  dmp.diff_main(text2, text1, false);
+
+  clock_t start = clock();
+  dmp.diff_main(text1, text2, false);
+  qDebug("Elapsed time: %f", secondsSince(start));
+  qDebug("Estimate: %s",
+         qPrintable(dmp.diff_estimate(text1, text2, false).toString()));
+
+  start = clock();
+  dmp.diff_main(text1, text2, true);
+  qDebug("Elapsed time (line mode allowed): %f", secondsSince(start));
+  qDebug("Estimate: %s",
+         qPrintable(dmp.diff_estimate(text1, text2, true).toString()));
+}
+
+
+static void runCalibration(diff_match_patch &dmp, const QString &text1,
+                           const QString &text2, const QString &profile) {
+  // Both directions of the speed test texts, plus scattered small edits on
+  // long and on short lines.
+  QList<QPair<QString, QString> > samples;
+  samples.append(qMakePair(text1, text2));
+  samples.append(qMakePair(text2, text1));
+  samples.append(qMakePair(text1, editLines(text1, 10)));
+  samples.append(qMakePair(text2, editLines(text2, 3)));
+
+  dmp.diff_calibrate(samples);
+  qDebug("Diff_TokenCost: %g", dmp.Diff_TokenCost);
+  qDebug("Diff_BisectCost: %g", dmp.Diff_BisectCost);
+  qDebug("Diff_ScanCost: %g", dmp.Diff_ScanCost);
+  typedef QPair<QString, QString> TextPair;
+  foreach(TextPair sample, samples) {
+    qDebug("%s", qPrintable(dmp.diff_features(sample.first, sample.second)
+        .toString()));
+  }
+
+  if (!dmp.profile_save(profile)) {
+    qFatal("Could not write %s", qPrintable(profile));
+  }
+  qDebug("Saved profile to %s", qPrintable(profile));
+}
+
+
+// Make a copy of text with a suffix appended to every nth line.
+static QString appendLines(const QString &text, int n, const QString &suffix) {
+  QStringList lines = text.split("\n");
+  for (int x = 0; x < lines.size(); x += n) {
+    lines[x] += suffix;
+  }
+  return lines.join("\n");
+}
+
+
+// Seconds taken by one patch_apply, averaged over several runs.
+static double timeApply(diff_match_patch &dmp, QList<Patch> &patches,
+                        const QString &text, QString &result) {
+  const int runs = 10;
+  clock_t start = clock();
+  for (int x = 0; x < runs; x++) {
+    result = dmp.patch_apply(patches, text).first;
+  }
+  return secondsSince(start) / runs;
+}
+
+
+static void runNormalizeBenchmark(diff_match_patch &dmp, const QString &text1,
+                                  const QString &text2) {
+  // Concatenate the patches between successive versions, as a store which
+  // appends every change would.  Later versions keep editing the same lines.
+  QStringList versions;
+  versions << text1 << text2;
+  for (int x = 0; x < 8; x++) {
+    versions << appendLines(versions.last(), 2 + x % 2,
+                            QString(" v%1").arg(x));
+  }
+  QList<Patch> patches;
+  for (int x = 1; x < versions.size(); x++) {
+    patches += dmp.patch_make(versions[x - 1], versions[x]);
+  }
+
+  QString before;
+  QString after;
+  // patch_apply splits oversized patches, so count what it really matches.
+  QList<Patch> splitPatches = patches;
+  dmp.patch_splitMax(splitPatches);
+  qDebug("Patches before normalization: %d", splitPatches.size());
+  qDebug("Apply time before normalization: %f",
+         timeApply(dmp, patches, text1, before));
+  dmp.patch_normalize(patches);
+  qDebug("Patches after normalization: %d", patches.size());
+  qDebug("Apply time after normalization: %f",
+         timeApply(dmp, patches, text1, after));
+  if (before != versions.last() || after != versions.last()) {
+    qFatal("Patches did not reproduce the last version.");
+  }
+}
+
+
+// Encode and decode a diff in one delta format, returning the encoded size.
+static int timeDelta(diff_match_patch &dmp, const QList<Diff> &diffs,
+                     const QString &text1, const QString &format,
+                     double &encodeSeconds, double &decodeSeconds) {
+  const int repeats = 10;
+  QByteArray delta;
+  clock_t start = clock();
+  for (int x = 0; x < repeats; x++) {
+    if (format == "text") {
+      delta = dmp.diff_toDelta(diffs).toUtf8();
+    } else if (format == "zlib") {
+      delta = qCompress(dmp.diff_toDelta(diffs).toUtf8());
+    } else {
+      delta = dmp.diff_toCompressedDelta(diffs);
+    }
+  }
+  encodeSeconds = secondsSince(start) / repeats;
+  QList<Diff> decoded;
+  start = clock();
+  for (int x = 0; x < repeats; x++) {
+    if (format == "text") {
+      decoded = dmp.diff_fromDelta(text1, QString::fromUtf8(delta));
+    } else if (format == "zlib") {
+      decoded = dmp.diff_fromDelta(text1,
+                                   QString::fromUtf8(qUncompress(delta)));
+    } else {
+      decoded = dmp.diff_fromCompressedDelta(text1, delta);
+    }
+  }
+  decodeSeconds = secondsSince(start) / repeats;
+  if (dmp.diff_text2(decoded) != dmp.diff_text2(diffs)) {
+    qFatal("The %s delta did not reproduce text2.", qPrintable(format));
+  }
+  return delta.size();
+}
+
+
+static void runDeltaBenchmark(diff_match_patch &dmp, const QString &text1,
+                              const QString &text2) {
+  dmp.Diff_Timeout = 0;
+  QStringList names;
+  QList<QPair<QString, QString> > samples;
+  // Mostly equalities, mostly small edits, and a whole text inserted.
+  names << "speedtest" << "scattered edits" << "insert all";
+  samples << qMakePair(text1, text2)
+      << qMakePair(text1, editLines(text1, 10))
+      << qMakePair(QString(""), text2);
+  const char *formats[] = {"text", "zlib", "compressed"};
+  for (int x = 0; x < samples.size(); x++) {
+    QList<Diff> diffs = dmp.diff_main(samples[x].first, samples[x].second);
+    dmp.diff_cleanupEfficiency(diffs);
+    qDebug("%s: %d diffs", qPrintable(names[x]), diffs.size());
+    for (int y = 0; y < 3; y++) {
+      double encodeSeconds, decodeSeconds;
+      const int size = timeDelta(dmp, diffs, samples[x].first, formats[y],
+                                 encodeSeconds, decodeSeconds);
+      qDebug("  %-10s %8d bytes, encode %f, decode %f", formats[y], size,
+             encodeSeconds, decodeSeconds);
+    }
+  }
+}
+
+
+static void runReplay(diff_match_patch &dmp, const QString &fileName) {
+  const QList<CapturedCall> calls = dmp.capture_load(fileName);
+  if (calls.isEmpty()) {
+    qFatal("No captured calls in %s", qPrintable(fileName));
+  }
+  int changed = 0;
+  for (int x = 0; x < calls.size(); x++) {
+    const CapturedCall &call = calls[x];
+    double seconds;
+    const bool same = dmp.capture_replay(call, seconds);
+    if (!same) {
+      changed++;
+    }
+    qDebug("#%d %s: captured %f, replayed %f, result %s", x + 1,
+           qPrintable(call.function), call.seconds, seconds,
+           same ? "same" : "DIFFERENT");
+    // The settings of the call are in force now, so the estimates match
+    // the run above.
+    if (call.function == "diff_main") {
+      const QString &text1 = call.inputs[1];
+      const QString text2 = dmp.diff_text2(
+          dmp.diff_fromDelta(text1, call.inputs[2]));
+      qDebug("  %s", qPrintable(dmp.diff_features(text1, text2).toString()));
+      qDebug("  %s", qPrintable(dmp.diff_estimate(text1, text2,
+          call.inputs[0] == "1").toString()));
+    } else if (call.function == "patch_make") {
+      qDebug("  %s", qPrintable(dmp.patch_estimateMake(call.inputs[0],
+          call.inputs[1]).toString()));
+    } else {
+      QList<Patch> patches = dmp.patch_fromText(call.inputs[0]);
+      qDebug("  %s", qPrintable(dmp.patch_estimateApply(patches,
+          call.inputs[1]).toString()));
+    }
+  }
+  qDebug("Replayed %d calls, %d with a different result.", calls.size(),
+         changed);
+}
+
+
+int main(int argc, char **argv) {
+  const QString text1 = readFile("speedtest1.txt");
+  const QString text2 = readFile("speedtest2.txt");
+
+  diff_match_patch dmp;
+  if (argc == 3 && QString(argv[1]) == "--calibrate") {
+    runCalibration(dmp, text1, text2, argv[2]);
+    return 0;
+  }
+  if (argc == 2 && QString(argv[1]) == "--normalize") {
+    runNormalizeBenchmark(dmp, text1, text2);
+    return 0;
+  }
+  if (argc == 2 && QString(argv[1]) == "--delta") {
+    runDeltaBenchmark(dmp, text1, text2);
+    return 0;
+  }
+  if (argc == 3 && QString(argv[1]) == "--replay") {
+    runReplay(dmp, argv[2]);
+    return 0;
+  }
+  if (argc == 3 && QString(argv[1]) == "--profile") {
+    if (!dmp.profile_load(argv[2])) {
+      qFatal("Could not read %s", argv[2]);
+    }
+  } else if (argc == 3 && QString(argv[1]) == "--capture") {
+    dmp.Capture_File = argv[2];
+    dmp.Capture_Threshold = 0;
+  } else if (argc != 1) {
+    qFatal("Usage: %s [--calibrate|--profile profile.ini|--normalize"
+           "|--delta|--capture capture.log|--replay capture.log]", argv[0]);
+  }
+  runSpeedtest(dmp, text1, text2);
+  return 0;
+}
@@ -0,0 +1,9 @@
+TEMPLATE = app
+CONFIG += qt console release
+CONFIG -= app_bundle
+
+TARGET = speedtest
+
+HEADERS = diff_match_patch_core.h diff_match_patch.h
+
+SOURCES = diff_match_patch_core.cpp diff_match_patch.cpp speedtest.cpp